@@ -20,6 +20,7 @@ Block::Block(const BlockDef* definition)
 
 Block::Block(const Block& copyFrom)
 	: m_blockId(copyFrom.m_blockId)
+	, m_blockMeta(copyFrom.m_blockMeta)
 	, m_lightBits(copyFrom.m_lightBits)
 	, m_flagBits(copyFrom.m_flagBits)
 {
@@ -20,6 +20,7 @@ bool BlockDef::LoadFromXmlElement(const XmlElement& element)
 	m_solid = ParseXmlAttribute(element, "solid", m_solid);
 	m_opaque = ParseXmlAttribute(element, "opaque", m_opaque);
 	m_lightLevel = (unsigned char)ParseXmlAttribute(element, "light", (int)m_lightLevel);
+	m_randomTick = ParseXmlAttribute(element, "randomTick", m_randomTick);
 	std::string type = ParseXmlAttribute(element, "materialType", "single");
 
 	if (_stricmp(type.c_str(), "single") == 0)
@@ -31,6 +31,7 @@ public:
 	bool m_solid = false;
 	bool m_opaque = false;
 	LightLevel m_lightLevel = 0;
+	bool m_randomTick = false; // picked by chunk random ticks, e.g. grass spreading
 
 	const BlockMaterialDef* m_matDef[BLOCK_FACE_SIZE] = {};
 };
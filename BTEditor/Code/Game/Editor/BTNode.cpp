@@ -9,6 +9,8 @@
 
 #include "Game/Entity/Actor.hpp"
 #include "Game/World/World.hpp"
+#include "Game/World/EnvQuery.hpp"
+#include "Game/World/AIPerception.hpp"
 
 #include <algorithm>
 #include <typeinfo>
@@ -1881,7 +1883,8 @@ void BTDecoratorWatchValue::CollectProps(FieldList& fields)
 //========================================================================================
 void BTNodeTaskMakeNoise::DoExecute()
 {
-	m_context->m_actor->m_world->AISenseMakeNoise(m_context->m_actor->GetPosition(), m_volume);
+	m_context->m_actor->m_world->AISenseMakeNoise(m_context->m_actor->GetPosition(), m_volume, m_context->m_actor);
+	FinishExecute(true);
 }
 
 
@@ -1949,13 +1952,9 @@ bool BTDecoratorCanSee::CheckCondition()
 
 	bool result = ConvertRadiansToDegrees(forward.Dot((actor->GetEyePosition() - eye).GetNormalized())) < m_angle;
 
+	// line of sight is batched once per frame by the perception system, targets beyond its range are traced directly
 	if (m_raycast && result)
-	{
-		auto ray = owner->m_world->FastRaycastVsTiles(owner->GetEyePosition(), actor->GetEyePosition());
-
-		if (ray.m_hitBlock)
-			result = false;
-	}
+		result = owner->m_world->m_perception->CanSee(owner, actor);
 
 	return m_reverse ? !result : result;
 }
@@ -2274,37 +2273,27 @@ void BTNodeTaskRandomPoint::DoExecute()
 		return;
 	}
 
-	static RandomNumberGenerator RNG;
-
-	Vec3 random = Vec3::ZERO;
+	// any walkable cell in range, picked at random
+	EnvQuery query;
+	query.m_generator = EnvQueryGenerator::NAV_CELLS;
+	query.m_radius = m_range;
+	query.m_spacing = 1.0f;
+	query.m_tests.emplace_back();
+	query.m_tests.back().m_type = EnvQueryTestType::RANDOM;
 
-	int i = 0;
+	EnvQueryContext context;
+	context.m_querier = actor->GetPosition();
 
-    while (true)
-    {
-		if (i++ > 100)
-		{
-			FinishExecute(false);
-			return;
-		}
-
-        do
-        {
-            random.x = (RNG.RollRandomFloatZeroToOne() * 2 - 1) * m_range;
-            random.y = (RNG.RollRandomFloatZeroToOne() * 2 - 1) * m_range;
-        } while (random.GetLengthSquared() > m_range * m_range);
-
-		auto loc = actor->GetPosition() + random;
-
-		if (!actor->m_world->m_navMesh->QueryAccessible(IntVec2((int)loc.x, (int)loc.y), false))
-			continue;
-
-        auto entry = m_context->m_table.SetEntry(m_keyHandle);
-
-        entry->value.Set(actor->GetPosition() + random);
-		break;
+	Vec3 point;
+	if (!actor->m_world->m_envQuery->RunQuery(query, context, point))
+	{
+		FinishExecute(false);
+		return;
 	}
 
+	auto entry = m_context->m_table.SetEntry(m_keyHandle);
+	entry->value.Set(point);
+
     FinishExecute(true);
 }
 
@@ -2438,33 +2427,41 @@ void BTNodeTaskKeepDistance::DoExecute()
 		return;
 	}
 
-	for (float angle = 0; angle < 90; angle += 10)
+	// points at range around the target, walkable and in the open, closest to the preferred direction
+	EnvQuery query;
+	query.m_generator = EnvQueryGenerator::RING;
+	query.m_origin = EnvQueryOrigin::TARGET;
+	query.m_radius = m_range;
+	query.m_count = 18;
+	query.m_tests.resize(4);
+	query.m_tests[0].m_type = EnvQueryTestType::ACCESSIBLE;
+	query.m_tests[0].m_filter = true;
+	query.m_tests[1].m_type = EnvQueryTestType::LINE_OF_SIGHT;
+	query.m_tests[1].m_reference = EnvQueryOrigin::TARGET;
+	query.m_tests[1].m_filter = true;
+	query.m_tests[2].m_type = EnvQueryTestType::DOT;
+	query.m_tests[2].m_reference = EnvQueryOrigin::TARGET;
+	query.m_tests[2].m_min = -1.0f;
+	query.m_tests[2].m_max = 1.0f;
+	query.m_tests[3].m_type = EnvQueryTestType::DISTANCE;
+	query.m_tests[3].m_max = m_range * 2.0f;
+	query.m_tests[3].m_weight = 0.25f;
+	query.m_tests[3].m_inverse = true;
+
+	EnvQueryContext context;
+	context.m_querier = actor->GetPosition();
+	context.m_target = position;
+	context.m_direction = direction;
+
+	Vec3 point;
+	if (!actor->m_world->m_envQuery->RunQuery(query, context, point))
 	{
-		auto target1 = direction.GetRotatedAboutZDegrees(angle) * m_range;
-
-		auto result1 = actor->m_world->FastRaycastVsTiles(position, target1);
-
-		if (!result1.m_hitBlock)
-		{
-			m_context->m_contorller->MoveTo(target1);
-			m_moving = true;
-			return;
-		}
-
-		auto target2 = direction.GetRotatedAboutZDegrees(-angle) * m_range;
-
-        auto result2 = actor->m_world->FastRaycastVsTiles(position, target2);
-
-        if (!result2.m_hitBlock)
-        {
-            m_context->m_contorller->MoveTo(target1);
-            m_moving = true;
-            return;
-        }
+		FinishExecute(false);
+		return;
 	}
 
-	FinishExecute(false);
-	return;
+	m_context->m_contorller->MoveTo(point);
+	m_moving = true;
 }
 
 
@@ -3,6 +3,9 @@
 #include "Game/Framework/GameCommon.hpp"
 #include "Game/Framework/Game.hpp"
 #include "Game/World/World.hpp"
+#include "Game/World/NavCrowd.hpp"
+#include "Game/World/AIPerception.hpp"
+#include "Game/World/NavPathRequest.hpp"
 #include "Game/Entity/Actor.hpp"
 #include "Game/Entity/Player.hpp"
 #include "Game/Entity/ActorDefinition.hpp"
@@ -28,6 +31,10 @@ AI::~AI()
 {
     StopBehaviorTree();
 
+    World* world = g_theGame->GetCurrentMap();
+    if (m_pathRequest != INVALID_PATH_REQUEST && world)
+        world->m_navMesh->GetPathQueue()->Cancel(m_pathRequest);
+
     s_btContexts.erase(s_btContexts.find(m_uuid));
 }
 
@@ -43,6 +50,9 @@ void AI::Update(float deltaSeconds)
 	if (!actor || actor->IsDead())
 		return;
 
+    // sight and hearing are gathered for every thinking agent after the entity update
+    actor->m_world->m_perception->AddObserver(actor);
+
     UpdateBehaviorTree(deltaSeconds);
 
     UpdateMovement(deltaSeconds);
@@ -99,35 +109,31 @@ void AI::SetMoveToRadius(float radius)
 
 void AI::MoveTo(const IntVec2& goal)
 {
-    if (!m_pathfinder || m_goal != goal)
-    {
-        m_goal = goal;
-        delete m_pathfinder;
-        m_pathfinder = g_theGame->GetCurrentMap()->m_navMesh->CreatePathfind(goal, false);
-    }
+    m_goal = goal;
 
+    // keep the agent's own height, the nearest floor in the goal column is used
     Actor* actor = GetActor();
-    m_path.clear();
-    IntVec2 position = {};
-    position.x = (int)actor->GetPosition().x;
-    position.y = (int)actor->GetPosition().y;
-
-    m_pathfinder->GetPath(position, m_path);
+    RequestPath(WorldCoords(goal.x, goal.y, (int)floorf(actor->GetPosition().z)));
 }
 
 void AI::MoveTo(const Vec3& goal)
 {
-    MoveTo(IntVec2(static_cast<int>(goal.x), static_cast<int>(goal.y)));
+    m_goal = IntVec2((int)floorf(goal.x), (int)floorf(goal.y));
+    RequestPath(Chunk::GetWorldCoords(goal));
 }
 
 void AI::StopMoving()
 {
     m_path.clear();
+
+    g_theGame->GetCurrentMap()->m_navMesh->GetPathQueue()->Cancel(m_pathRequest);
+    m_pathRequest = INVALID_PATH_REQUEST;
 }
 
 bool AI::IsMoving()
 {
-    return !m_path.empty();
+    // still moving while the path is being computed
+    return !m_path.empty() || m_pathRequest != INVALID_PATH_REQUEST;
 }
 
 AIContext* AI::FindContext(const AIIdentifier& id)
@@ -164,6 +170,19 @@ void AI::UpdateBehaviorTree(float deltaSeconds)
             auto entry = m_btContext->m_table.SetEntry(m_btRegistry->GetHandle("Player"));
             entry->value.Set(g_theGame->GetCurrentMap()->m_player[0]->GetActor()->GetUID());
         }
+        {
+            // optional keys, trees that do not declare them never hear anything
+            Vec3 noiseLocation;
+            float noiseLoudness = 0.0f;
+            bool heardNoise = GetActor()->m_world->m_perception->GetHeardNoise(GetActor(), noiseLocation, noiseLoudness);
+
+            if (auto entry = m_btContext->m_table.SetEntry(m_btRegistry->GetHandle("HeardNoise")))
+                entry->value.Set(heardNoise);
+            if (auto entry = heardNoise ? m_btContext->m_table.SetEntry(m_btRegistry->GetHandle("NoiseLocation")) : nullptr)
+                entry->value.Set(noiseLocation);
+            if (auto entry = heardNoise ? m_btContext->m_table.SetEntry(m_btRegistry->GetHandle("NoiseLoudness")) : nullptr)
+                entry->value.Set(noiseLoudness);
+        }
 
         m_btContext->m_root->Execute();
     }
@@ -172,9 +191,21 @@ void AI::UpdateBehaviorTree(float deltaSeconds)
 void AI::UpdateMovement(float deltaSeconds)
 {
     Actor* actor = GetActor();
+    World* world = g_theGame->GetCurrentMap();
 
+    if (m_pathRequest != INVALID_PATH_REQUEST)
+    {
+        bool success = false;
+        if (world->m_navMesh->GetPathQueue()->Poll(m_pathRequest, m_path, success))
+            m_pathRequest = INVALID_PATH_REQUEST;
+    }
+
+    // idle agents still block the crowd
     if (m_path.empty())
+    {
+        world->m_crowd->AddObstacle(actor);
         return;
+    }
 
     Vec2 goal = Vec2(m_path.back().x + 0.5f, m_path.back().y + 0.5f);
     Vec2 toGoal = goal - Vec2(actor->GetPosition().x, actor->GetPosition().y);
@@ -184,6 +215,7 @@ void AI::UpdateMovement(float deltaSeconds)
     {
         actor->RotateToFace(Vec3(toGoal.GetNormalized(), actor->GetPosition().z));
         m_path.clear();
+        world->m_crowd->AddObstacle(actor);
         return;
     }
 
@@ -194,19 +226,53 @@ void AI::UpdateMovement(float deltaSeconds)
     actor->RotateToFace(direction);
     DebugAddMessage(Stringf("Adjust facing: %.2f, %.2f, %.2f", actor->m_transform.m_orientation.m_yawDegrees, actor->m_transform.m_orientation.m_pitchDegrees, 0.f), 0, Rgba8::WHITE, Rgba8::WHITE);
 
+    float walkSpeed = actor->m_definition->m_walkSpeed;
+    Vec2 preferredVelocity = Vec2::ZERO;
+
     if (limit < 0.25f)
     {
         m_path.erase(m_path.begin());
     }
     else
     {
-        Vec3 offset = direction * deltaSeconds * actor->m_definition->m_walkSpeed;
-
-        if (offset.GetLengthSquared() > limit * limit)
-            offset = offset.GetNormalized() * limit;
+        // step up onto the next span through the block sweep, at most one step and only from the ground
+        // gravity handles stepping down
+        float rise = (float)m_path.front().z - actor->m_transform.m_position.z;
+        if (rise > 0.0f && actor->m_physics && actor->m_physics->IsOnGround())
+        {
+            if (rise > (float)NAV_MAX_STEP)
+                rise = (float)NAV_MAX_STEP;
+            actor->m_physics->MoveTo(actor->m_transform.m_position + Vec3(0.0f, 0.0f, rise));
+        }
 
-        actor->m_transform.m_position += offset;
+        float speed = walkSpeed;
+        if (speed * deltaSeconds > limit)
+            speed = limit / deltaSeconds;
+        preferredVelocity = Vec2(direction.x, direction.y) * speed;
     }
+
+    // the crowd moves the actor once every agent picked a velocity
+    world->m_crowd->AddAgent(actor, preferredVelocity, walkSpeed);
+}
+
+void AI::RequestPath(const WorldCoords& goal)
+{
+    World* world = g_theGame->GetCurrentMap();
+    NavMesh2D* navMesh = world->m_navMesh;
+    Actor* actor = GetActor();
+
+    m_path.clear();
+    navMesh->GetPathQueue()->Cancel(m_pathRequest);
+    m_pathRequest = INVALID_PATH_REQUEST;
+
+    // agents close to the player get their paths first
+    float priority = 0.0f;
+    Actor* player = world->m_player[0] ? world->m_player[0]->GetActor() : nullptr;
+    if (player)
+        priority = -(player->GetPosition() - actor->GetPosition()).GetLengthSquared();
+
+    WorldCoords from = Chunk::GetWorldCoords(actor->GetPosition());
+    m_pathRequest = navMesh->RequestPath(from, goal, false, priority, m_path);
 }
 
 std::map<UUID, AIContext> AI::s_btContexts;
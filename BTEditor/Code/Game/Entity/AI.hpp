@@ -46,6 +46,7 @@ public:
 private:
 	void UpdateBehaviorTree(float deltaSeconds);
 	void UpdateMovement(float deltaSeconds);
+	void RequestPath(const WorldCoords& goal);
 
 public:
 	Stopwatch m_meleeStopwatch;
@@ -59,8 +60,8 @@ private:
 	DataRegistry*        m_btRegistry = nullptr;
 	BTContext*           m_btContext  = nullptr;
 
-	NavMeshInst*         m_pathfinder = nullptr;
-    std::vector<IntVec2> m_path;
+	PathRequestHandle    m_pathRequest = INVALID_PATH_REQUEST;
+	std::vector<IntVec3> m_path;
 	IntVec2              m_goal;
 	float                m_radius;
 };
@@ -11,6 +11,7 @@
 #include "Engine/Core/DevConsole.hpp"
 #include "Engine/Core/EventSystem.hpp"
 #include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Clock.hpp"
 #include "Engine/Core/StringUtils.hpp"
 #include "Engine/Core/VertexUtils.hpp"
@@ -59,18 +60,17 @@ Actor::Actor(World* map, const SpawnInfo* spawnInfo, const ActorUID& uid)
 
 	m_defaultController->Possess(this);
 
-	Physics* physics = new Physics(*this);
+	Physics* physics = CreateComponent<Physics>();
 	physics->m_physicsHeight = m_definition->m_physicsHeight;
 	physics->m_physicsRadius = m_definition->m_physicsRadius;
 	physics->m_velocity = spawnInfo->m_velocity;
 	physics->m_simulated = m_definition->m_simulated;
 	physics->m_drag = m_definition->m_drag;
 	physics->SetMode(m_definition->m_flying ? PhysicsMode::FLYING : PhysicsMode::WALKING);
-	AddComponent(physics);
 
 	if (RENDER_CYLINDER_MESH && m_definition->m_name == "Player")
 	{
-		StaticMeshComp* mesh = new StaticMeshComp(*this);
+		StaticMeshComp* mesh = CreateComponent<StaticMeshComp>();
 		mesh->m_solidColor = g_factionColors[m_definition->m_faction];
 		VertexBufferBuilder builder;
 		builder.Start(VertexFormat::GetDefaultFormat_Vertex_PNCU(), 0);
@@ -89,11 +89,10 @@ Actor::Actor(World* map, const SpawnInfo* spawnInfo, const ActorUID& uid)
 		}
 		builder.Reset();
 		m_debugMesh = mesh;
-		AddComponent(mesh);
 	}
 	else if (!m_definition->m_mesh.empty())
     {
-        SkeletalMeshComp* mesh = new SkeletalMeshComp(*this);
+        SkeletalMeshComp* mesh = CreateComponent<SkeletalMeshComp>();
         mesh->m_solidColor = g_factionColors[m_definition->m_faction];
         
 		SkeletalMesh* skel = new SkeletalMesh();
@@ -108,13 +107,11 @@ Actor::Actor(World* map, const SpawnInfo* spawnInfo, const ActorUID& uid)
 		if (!m_definition->m_meshTexture.empty())
 			mesh->m_texture = g_theRenderer->CreateOrGetTextureFromFile(m_definition->m_meshTexture.c_str());
 		mesh->m_transform.m_orientation.m_yawDegrees = 180;
-        AddComponent(mesh);
     }
 
 	if (m_definition->m_health > 0)
 	{
-		Health* health = new Health(*this, m_definition->m_health);
-		AddComponent(health);
+		CreateComponent<Health>(m_definition->m_health);
 	}
 
 	if (m_definition->m_visible)
@@ -124,8 +121,7 @@ Actor::Actor(World* map, const SpawnInfo* spawnInfo, const ActorUID& uid)
 
 	if (!m_definition->m_sounds.IsEmpty())
 	{
-		SoundSource* sound = new SoundSource(*this);
-		AddComponent(sound);
+		CreateComponent<SoundSource>();
 	}
 
 	// query components
@@ -136,7 +132,7 @@ Actor::Actor(World* map, const SpawnInfo* spawnInfo, const ActorUID& uid)
 Actor::~Actor()
 {
 	for (auto& comp : m_comps)
-		delete comp;
+		DestroyComponent(comp);
 	m_comps.clear();
 
 	delete m_defaultController;
@@ -253,11 +249,8 @@ void Actor::Update(float deltaSeconds)
 		return;
 	}
 
+	// components tick in the world's component systems
 	m_controller->Update(deltaSeconds);
-	for (auto& comp : m_tickableComps)
-	{
-		comp->Update(deltaSeconds);
-	}
 
 	if (m_definition->m_collidesWithWorld)
 	{
@@ -326,22 +319,17 @@ const ActorUID& Actor::GetUID() const
 	return m_uid;
 }
 
-void Actor::AddComponent(EntityComponent* component)
-{
-	m_comps.push_back(component);
-
-	if (component->m_tickable)
-		m_tickableComps.push_back(component);
-}
-
-EntityComponent* Actor::GetComponent(EntityComponentType type)
+void Actor::DestroyComponent(EntityComponent* component)
 {
-	for (EntityComponent* comp : m_comps)
+	switch (component->m_type)
 	{
-		if (type == comp->m_type)
-			return comp;
+	case EC_TYPE_PHYSICS:       ComponentPool<Physics>::GetInstance().Destroy((Physics*)component); break;
+	case EC_TYPE_STATIC_MESH:   ComponentPool<StaticMeshComp>::GetInstance().Destroy((StaticMeshComp*)component); break;
+	case EC_TYPE_SKELETAL_MESH: ComponentPool<SkeletalMeshComp>::GetInstance().Destroy((SkeletalMeshComp*)component); break;
+	case EC_TYPE_HEALTH:        ComponentPool<Health>::GetInstance().Destroy((Health*)component); break;
+	case EC_TYPE_SOUND_SOURCE:  ComponentPool<SoundSource>::GetInstance().Destroy((SoundSource*)component); break;
+	default:                    ERROR_AND_DIE("Actor component type has no pool");
 	}
-	return nullptr;
 }
 
 void Actor::OnPossessed(Controller* controller)
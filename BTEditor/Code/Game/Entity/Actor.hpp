@@ -2,6 +2,7 @@
 
 #include "Game/Framework/GameCommon.hpp"
 #include "Game/Entity/ActorUID.hpp"
+#include "Game/Entity/ComponentPool.hpp"
 #include "Game/Entity/Components.hpp"
 #include "Game/Entity/Faction.hpp"
 #include "Engine/Core/Stopwatch.hpp"
@@ -46,7 +47,7 @@ public:
 
 	// utilities
 	template<typename T>
-	T*               GetComponent()                                        { return reinterpret_cast<T*>(GetComponent(T::TYPE)); }
+	T*               GetComponent()                                        { return ComponentPool<T>::GetInstance().Get(m_uid); }
 	void             OnPossessed(Controller* controller);
 	void             OnUnpossessed(Controller* controller);
 	void             MoveInDirection(Vec3 direction, float speed);
@@ -61,8 +62,9 @@ private:
 	void             HandleEventEffect(const char* name);
 
 protected:
-	void             AddComponent(EntityComponent* component);
-	EntityComponent* GetComponent(EntityComponentType type);
+	template<typename T, typename... Args>
+	T*               CreateComponent(Args&&... args);
+	void             DestroyComponent(EntityComponent* component);
 	ComponentList    GetComponents(EntityComponentType type) const;
 
 public:
@@ -95,6 +97,14 @@ public:
 private:			                    
 	ActorUID                            m_uid                  = ActorUID::INVALID();
 	ComponentList                       m_comps;
-	ComponentList                       m_tickableComps;
 };
 
+
+template<typename T, typename... Args>
+T* Actor::CreateComponent(Args&&... args)
+{
+	T* component = ComponentPool<T>::GetInstance().Create(m_uid, *this, std::forward<Args>(args)...);
+	m_comps.push_back(component);
+	return component;
+}
+
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Game/Entity/ActorUID.hpp"
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+constexpr int COMPONENT_POOL_SLAB_SIZE = 64;
+
+// components of one type packed in fixed slabs, found through the owner's salted uid, slots are recycled through a
+// free list and a component never moves while it lives, the update systems walk the live slots in memory order
+template<typename T>
+class ComponentPool
+{
+public:
+	static ComponentPool& GetInstance();
+
+	ComponentPool(const ComponentPool&) = delete;
+	~ComponentPool();
+
+	template<typename... Args>
+	T*   Create(const ActorUID& owner, Args&&... args);
+	void Destroy(T* component);
+	T*   Get(const ActorUID& owner) const;
+	int  GetCount() const { return (int)m_live.size(); }
+
+	template<typename Func>
+	void ForEach(Func func);
+
+private:
+	ComponentPool() = default;
+
+	struct Slab
+	{
+		alignas(T) unsigned char m_storage[sizeof(T) * COMPONENT_POOL_SLAB_SIZE];
+		ActorUID                 m_owners[COMPONENT_POOL_SLAB_SIZE]; // invalid for free slots
+	};
+
+	T* GetSlot(int slot) const;
+
+private:
+	std::vector<Slab*> m_slabs;
+	std::vector<int>   m_freeSlots;
+	std::vector<int>   m_slotByActor; // by actor uid index, -1 when the actor has none
+	std::vector<int>   m_live;        // live slots, swap-removed on destroy and sorted again before the next walk
+	std::vector<int>   m_liveBySlot;  // position in m_live by slot
+	bool               m_liveSorted = true;
+};
+
+
+template<typename T>
+ComponentPool<T>& ComponentPool<T>::GetInstance()
+{
+	static ComponentPool s_instance;
+	return s_instance;
+}
+
+template<typename T>
+ComponentPool<T>::~ComponentPool()
+{
+	// actors destroy their components, only the storage is left
+	for (Slab* slab : m_slabs)
+		delete slab;
+}
+
+template<typename T>
+template<typename... Args>
+T* ComponentPool<T>::Create(const ActorUID& owner, Args&&... args)
+{
+	if (m_freeSlots.empty())
+	{
+		int first = (int)m_slabs.size() * COMPONENT_POOL_SLAB_SIZE;
+		m_slabs.push_back(new Slab());
+		m_liveBySlot.resize(m_slabs.size() * COMPONENT_POOL_SLAB_SIZE, -1);
+		for (int slot = first + COMPONENT_POOL_SLAB_SIZE - 1; slot >= first; slot--)
+			m_freeSlots.push_back(slot);
+	}
+
+	int slot = m_freeSlots.back();
+	m_freeSlots.pop_back();
+	m_slabs[slot / COMPONENT_POOL_SLAB_SIZE]->m_owners[slot % COMPONENT_POOL_SLAB_SIZE] = owner;
+
+	int index = owner.GetIndex();
+	if (index >= (int)m_slotByActor.size())
+		m_slotByActor.resize((size_t)index + 1, -1);
+	m_slotByActor[index] = slot;
+
+	// recycled slots may sit below the last live one
+	if (!m_live.empty() && slot < m_live.back())
+		m_liveSorted = false;
+	m_liveBySlot[slot] = (int)m_live.size();
+	m_live.push_back(slot);
+
+	return new (GetSlot(slot)) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+void ComponentPool<T>::Destroy(T* component)
+{
+	if (!component)
+		return;
+
+	const ActorUID& owner = component->m_actor.GetUID();
+	int index = owner.GetIndex();
+	int slot = index < (int)m_slotByActor.size() ? m_slotByActor[index] : -1;
+	if (slot < 0 || GetSlot(slot) != component || m_slabs[slot / COMPONENT_POOL_SLAB_SIZE]->m_owners[slot % COMPONENT_POOL_SLAB_SIZE] != owner)
+		ERROR_AND_DIE("Destroying a component its owner does not hold");
+
+	// the last live slot takes over the freed position, which breaks the order until the next walk
+	int live = m_liveBySlot[slot];
+	int last = m_live.back();
+	m_live[live] = last;
+	m_liveBySlot[last] = live;
+	m_live.pop_back();
+	m_liveBySlot[slot] = -1;
+	if (live < (int)m_live.size())
+		m_liveSorted = false;
+	m_slotByActor[index] = -1;
+
+	component->~T();
+	m_slabs[slot / COMPONENT_POOL_SLAB_SIZE]->m_owners[slot % COMPONENT_POOL_SLAB_SIZE] = ActorUID::INVALID();
+	m_freeSlots.push_back(slot);
+}
+
+template<typename T>
+T* ComponentPool<T>::Get(const ActorUID& owner) const
+{
+	int index = owner.GetIndex();
+	if (index >= (int)m_slotByActor.size() || m_slotByActor[index] < 0)
+		return nullptr;
+
+	// the salt tells a recycled uid index apart from the actor that owns the slot now
+	int slot = m_slotByActor[index];
+	if (m_slabs[slot / COMPONENT_POOL_SLAB_SIZE]->m_owners[slot % COMPONENT_POOL_SLAB_SIZE] != owner)
+		return nullptr;
+	return GetSlot(slot);
+}
+
+template<typename T>
+template<typename Func>
+void ComponentPool<T>::ForEach(Func func)
+{
+	// slot order is memory order, slab by slab
+	if (!m_liveSorted)
+	{
+		std::sort(m_live.begin(), m_live.end());
+		for (int live = 0; live < (int)m_live.size(); live++)
+			m_liveBySlot[m_live[live]] = live;
+		m_liveSorted = true;
+	}
+
+	// indexed loop, components created by the callback are appended and visited too
+	for (int live = 0; live < (int)m_live.size(); live++)
+		func(*GetSlot(m_live[live]));
+}
+
+template<typename T>
+T* ComponentPool<T>::GetSlot(int slot) const
+{
+	return (T*)m_slabs[slot / COMPONENT_POOL_SLAB_SIZE]->m_storage + slot % COMPONENT_POOL_SLAB_SIZE;
+}
+
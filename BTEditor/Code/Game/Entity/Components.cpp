@@ -77,10 +77,7 @@ void Physics::Update(float deltaSeconds)
 		m_velocity += m_acceleration * deltaSeconds;
 		if (!m_flying)
 			m_velocity.z -= m_gravity * deltaSeconds;
-		// MoveTo(m_actor.m_transform.m_position + Vec3(m_velocity.x, m_velocity.y, 0) * deltaSeconds);
-		MoveTo(m_actor.m_transform.m_position + Vec3(m_velocity.x, 0, 0) * deltaSeconds);
-		MoveTo(m_actor.m_transform.m_position + Vec3(0, m_velocity.y, 0) * deltaSeconds);
- 		MoveTo(m_actor.m_transform.m_position + Vec3(0, 0, m_velocity.z) * deltaSeconds);
+		MoveTo(m_actor.m_transform.m_position + m_velocity * deltaSeconds);
 		m_acceleration = Vec3::ZERO;
 
 		m_actor.m_transform.m_orientation.m_yawDegrees   += m_angluerVelocity.m_yawDegrees * deltaSeconds;
@@ -92,55 +89,34 @@ void Physics::Update(float deltaSeconds)
 
 void Physics::MoveTo(Vec3 position)
 {
+	Vec3& currentPosition = m_actor.m_transform.m_position;
 	if (m_noclip || !PREVENTATIVE_PHYSICS_ON)
 	{
-		m_actor.m_transform.m_position = position;
+		currentPosition = position;
+		m_resolvedPosition = position;
+		m_onGround = false;
 		return;
 	}
 
-	Vec3 prevPosition = m_actor.m_transform.m_position;
-	float sizeHalfXY = m_physicsRadius;
-	float sizeZ = m_physicsHeight;
-	AABB3 prevBox = AABB3(Vec3(prevPosition.x - sizeHalfXY, prevPosition.y - sizeHalfXY, prevPosition.z), Vec3(prevPosition.x + sizeHalfXY, prevPosition.y + sizeHalfXY, prevPosition.z + sizeZ));
+	// a single block gather pushes the actor out of whatever it ended up in and clips the whole move
+	bool collidesWithWorld = m_actor.m_definition->m_collidesWithWorld;
+	Vec3 movement = position - currentPosition;
+	WorldSweepResult result = m_actor.m_world->SweepBoxVsTiles(currentPosition, m_physicsRadius, m_physicsHeight, movement, collidesWithWorld);
 
-	Vec3 movement = position - prevPosition;
-	float moveLen = movement.GetLength();
-	float impact = moveLen;
-	Vec3 normal;
+	if (result.m_blocked[0])
+		m_velocity.x = 0;
+	if (result.m_blocked[1])
+		m_velocity.y = 0;
+	if (result.m_blocked[2])
+		m_velocity.z = 0;
+	if (movement.z != 0.0f)
+		m_onGround = result.m_blocked[2] && movement.z < 0.0f;
 
-	for (Vec3 offsetV : { Vec3(0, 0, 0), Vec3(0, 0, sizeZ * 0.5f), Vec3(0, 0, sizeZ) })
-	{
-		for (Vec3 offsetH : { Vec3(+sizeHalfXY, +sizeHalfXY, 0), Vec3(-sizeHalfXY, -sizeHalfXY, 0), Vec3(+sizeHalfXY, -sizeHalfXY, 0), Vec3(-sizeHalfXY, +sizeHalfXY, 0) })
-		{
-			Vec3 rayStart = prevPosition + offsetV + offsetH;
-			Vec3 rayEnd = rayStart + movement;
-			if (prevBox.IsPointInside(rayEnd))
-				continue;
-
-			auto result = m_actor.m_world->FastRaycastVsTiles(rayStart, rayEnd).m_result;
-			if (result.DidImpact())
-			{
-				impact = Min(impact, result.GetImpactDistance());
-				normal = result.GetImpactNormal();
-			}
-		}
-	}
+	currentPosition = result.m_position;
+	m_resolvedPosition = result.m_position;
 
-	if (impact != moveLen)
-	{
-		movement *= (impact - 0.00001f) / moveLen;
-		m_actor.m_transform.m_position = prevPosition + movement;
-		if (normal.x != 0)
-			m_velocity.x = 0;
-		if (normal.y != 0)
-			m_velocity.y = 0;
-		if (normal.z != 0)
-			m_velocity.z = 0;
-	}
-	else
-	{
-		m_actor.m_transform.m_position = position;
-	}
+	if (collidesWithWorld && m_actor.m_definition->m_dieOnCollide && (result.m_blocked[0] || result.m_blocked[1] || result.m_blocked[2]))
+		m_actor.Die();
 }
 
 void Physics::AddForce(const Vec3& force)
@@ -163,7 +139,9 @@ void Physics::SwitchMode()
 
 void Physics::SetMode(PhysicsMode mode)
 {
+	// contact from the previous mode says nothing about this one, the next blocked descent sets it again
 	m_mode = mode;
+	m_onGround = false;
 	switch (mode)
 	{
 	case PhysicsMode::WALKING:
@@ -191,24 +169,9 @@ bool Physics::IsNoclip() const
 	return m_noclip;
 }
 
-#include "Engine/Renderer/DebugRender.hpp"
-
 bool Physics::IsOnGround() const
 {
-	World* world = m_actor.m_world;
-
-	Vec3& position = m_actor.m_transform.m_position;
-	float sizeHalfXY = m_physicsRadius;
-
-	for (Vec3 offset : { Vec3(+sizeHalfXY, +sizeHalfXY, 0), Vec3(-sizeHalfXY, -sizeHalfXY, 0) , Vec3(+sizeHalfXY, -sizeHalfXY, 0) , Vec3(-sizeHalfXY, +sizeHalfXY, 0) })
-	{
-		Vec3 pos = position + offset;
-		auto result = world->FastRaycastVsTiles(pos, pos - Vec3(0.0f, 0.0f, 0.1f));
-		DebugAddWorldRay(pos, Vec3(0.0f, 0.0f, -1.f), 0.1f, result.m_result, 0.01f, 0.0f, Rgba8::WHITE, Rgba8::WHITE, DebugRenderMode::XRAY);
-		if (result.m_result.DidImpact())
-			return true;
-	}
-	return false;
+	return m_onGround;
 }
 
 const EntityComponentType StaticMeshComp::TYPE = EC_TYPE_STATIC_MESH;
@@ -103,8 +103,10 @@ public:
 	EulerAngles m_angluerVelocity;
 	float       m_drag = 0.0f;
 	float       m_maxAngularVel = 360.0f;
+	Vec3        m_resolvedPosition; // position after the last move against the blocks
 
 private:
+	bool        m_onGround = false; // set by downward moves stopped by a block
 	bool        m_flying = false;
 	bool        m_noclip = false;
 	PhysicsMode m_mode = PhysicsMode::NOCLIP;
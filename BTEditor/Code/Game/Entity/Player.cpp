@@ -66,7 +66,7 @@ void Player::Update(float deltaSeconds)
 
 	HandleInput(deltaSeconds);
 
-	g_theGame->GetCurrentMap()->GetChunkManager()->SetHotspot(m_index, GetEyePosition());
+	g_theGame->GetCurrentMap()->GetChunkManager()->SetHotspot(m_index, GetEyePosition(), forward);
 
 	HandleDebugRender(deltaSeconds);
 }
@@ -30,6 +30,12 @@ constexpr unsigned int CHUNK_BLOCKMASK_X = CHUNK_MAX_X << CHUNK_BITSHIFT_X;
 constexpr unsigned int CHUNK_BLOCKMASK_Y = CHUNK_MAX_Y << CHUNK_BITSHIFT_Y;
 constexpr unsigned int CHUNK_BLOCKMASK_Z = CHUNK_MAX_Z << CHUNK_BITSHIFT_Z;
 
+constexpr unsigned int CHUNK_SECTION_BITWIDTH_Z = 4;
+constexpr unsigned int CHUNK_SECTION_SIZE_Z     = 1 << CHUNK_SECTION_BITWIDTH_Z;
+constexpr unsigned int CHUNK_SECTION_BLOCKS     = CHUNK_SIZE_XY * CHUNK_SIZE_XY * CHUNK_SECTION_SIZE_Z;
+constexpr unsigned int CHUNK_SECTION_COUNT      = CHUNK_SIZE_Z / CHUNK_SECTION_SIZE_Z;
+constexpr unsigned int CHUNK_SECTION_BITSHIFT   = CHUNK_BITSHIFT_Z + CHUNK_SECTION_BITWIDTH_Z;
+
 constexpr int MAP_ORIGIN_X     = 0;
 constexpr int MAP_ORIGIN_Y     = 0;
 constexpr int MAP_DIMENSIONS_X = 0xFF;
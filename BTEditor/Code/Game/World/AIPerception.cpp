@@ -0,0 +1,170 @@
+#include "Game/World/AIPerception.hpp"
+
+#include "Game/Framework/GameCommon.hpp"
+#include "Game/World/World.hpp"
+#include "Game/Entity/Actor.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+
+#include <algorithm>
+
+AIPerception::AIPerception(World* world)
+    : m_world(world)
+{
+    m_sightRange = g_gameConfigBlackboard.GetValue("perceptionSightRange", m_sightRange);
+    m_noiseRange = g_gameConfigBlackboard.GetValue("perceptionNoiseRange", m_noiseRange);
+    m_raycastBudget = g_gameConfigBlackboard.GetValue("perceptionRaycastBudget", m_raycastBudget);
+}
+
+void AIPerception::AddObserver(Actor* actor)
+{
+    m_observers.push_back(actor);
+    m_states[actor].m_registered = true;
+}
+
+void AIPerception::AddNoise(const Vec3& location, float loudness, const Actor* instigator)
+{
+    if (loudness > 0.0f)
+        m_noises.push_back({ location, loudness, instigator });
+}
+
+void AIPerception::Update()
+{
+    // agents that stopped thinking this frame may be gone, their pointers can be reused
+    for (auto ite = m_states.begin(); ite != m_states.end();)
+    {
+        if (!ite->second.m_registered)
+        {
+            ite = m_states.erase(ite);
+            continue;
+        }
+        ite->second.m_registered = false;
+        ++ite;
+    }
+
+    UpdateSight();
+    UpdateHearing();
+
+    m_observers.clear();
+    m_noises.clear();
+}
+
+bool AIPerception::CanSee(const Actor* observer, const Actor* target) const
+{
+    // the first frame of a new agent has nothing cached yet, and targets the index leaves out are never paired:
+    // beyond the sight range, dead or projectiles, these are traced right away
+    auto ite = m_states.find(observer);
+    bool tracked = !target->IsDead() && !target->IsProjectile() && (target->GetPosition() - observer->GetPosition()).GetLengthSquared() <= m_sightRange * m_sightRange;
+    if (!tracked || ite == m_states.end() || !ite->second.m_refreshed)
+        return !m_world->FastRaycastVsTiles(observer->GetEyePosition(), target->GetEyePosition()).m_hitBlock;
+
+    const std::vector<ActorUID>& visible = ite->second.m_visible;
+    return std::find(visible.begin(), visible.end(), target->GetUID()) != visible.end();
+}
+
+bool AIPerception::GetHeardNoise(const Actor* observer, Vec3& location, float& loudness) const
+{
+    auto ite = m_states.find(observer);
+    if (ite == m_states.end() || !ite->second.m_heardNoise)
+        return false;
+
+    location = ite->second.m_noiseLocation;
+    loudness = ite->second.m_noiseLoudness;
+    return true;
+}
+
+void AIPerception::QueryRange(const Vec3& center, float radius, std::vector<Actor*>& actors) const
+{
+    // the world's actor grid holds every actor at its final position for this frame
+    m_world->GetEntitiesInRange(actors, center, radius);
+
+    float radiusSq = radius * radius;
+    size_t count = 0;
+    for (Actor* actor : actors)
+    {
+        if (!m_world->IsEntityNotGarbage(actor) || actor->IsDead() || actor->IsProjectile())
+            continue;
+        if ((actor->GetPosition() - center).GetLengthSquared() <= radiusSq)
+            actors[count++] = actor;
+    }
+    actors.resize(count);
+}
+
+void AIPerception::UpdateSight()
+{
+    m_pairs.clear();
+    if (m_observers.empty())
+        return;
+
+    // observers take turns until the raycast budget runs out, the rest keep last frame's answer
+    std::vector<Actor*> targets;
+    size_t count = m_observers.size();
+    size_t start = m_nextObserver % count;
+    size_t visited = 0;
+    for (; visited < count; visited++)
+    {
+        if (!m_pairs.empty() && (int)m_pairs.size() >= m_raycastBudget)
+            break;
+
+        Actor* observer = m_observers[(start + visited) % count];
+        PerceptionObserver& state = m_states[observer];
+        state.m_visible.clear();
+        state.m_refreshed = true;
+
+        QueryRange(observer->GetPosition(), m_sightRange, targets);
+        for (Actor* target : targets)
+        {
+            if (target != observer)
+                m_pairs.push_back({ observer, target });
+        }
+    }
+    m_nextObserver = start + visited;
+
+    m_sightRays.Clear();
+    m_sightRays.Reserve((int)m_pairs.size());
+    for (const PerceptionSightPair& pair : m_pairs)
+        m_sightRays.AddRay(pair.m_observer->GetEyePosition(), pair.m_target->GetEyePosition());
+    m_world->RaycastVsTiles(m_sightRays, true);
+
+    for (int i = 0; i < (int)m_pairs.size(); i++)
+    {
+        const PerceptionSightPair& pair = m_pairs[i];
+        if (!m_sightRays.DidHit(i))
+            m_states[pair.m_observer].m_visible.push_back(pair.m_target->GetUID());
+    }
+}
+
+void AIPerception::UpdateHearing()
+{
+    for (auto& state : m_states)
+        state.second.m_heardNoise = false;
+
+    // loudness falls off linearly to zero at loudness * m_noiseRange, the loudest noise wins
+    std::vector<Actor*> listeners;
+    for (const PerceptionNoise& noise : m_noises)
+    {
+        float range = noise.m_loudness * m_noiseRange;
+        if (range <= 0.0f)
+            continue;
+
+        QueryRange(noise.m_location, range, listeners);
+        for (Actor* listener : listeners)
+        {
+            auto ite = m_states.find(listener);
+            if (ite == m_states.end() || listener == noise.m_instigator)
+                continue;
+
+            float distance = (listener->GetPosition() - noise.m_location).GetLength();
+            float loudness = noise.m_loudness * (1.0f - distance / range);
+            PerceptionObserver& state = ite->second;
+            if (!state.m_heardNoise || loudness > state.m_noiseLoudness)
+            {
+                state.m_heardNoise = true;
+                state.m_noiseLocation = noise.m_location;
+                state.m_noiseLoudness = loudness;
+            }
+        }
+    }
+}
+
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Game/Entity/ActorUID.hpp"
+#include "Game/World/RaycastBatch.hpp"
+
+#include "Engine/Math/Vec3.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+class Actor;
+class World;
+class AIPerception;
+
+struct PerceptionObserver
+{
+    std::vector<ActorUID> m_visible;        // targets in sight as of the last refresh
+    bool                  m_refreshed = false;
+    bool                  m_registered = false;
+
+    bool                  m_heardNoise = false;
+    Vec3                  m_noiseLocation;
+    float                 m_noiseLoudness = 0.0f;
+};
+
+struct PerceptionSightPair
+{
+    Actor* m_observer = nullptr;
+    Actor* m_target = nullptr;
+};
+
+struct PerceptionNoise
+{
+    Vec3         m_location;
+    float        m_loudness = 0.0f;
+    const Actor* m_instigator = nullptr; // does not hear itself
+};
+
+// sight and hearing for every AI agent, refreshed once per frame and read by the behavior trees
+class AIPerception
+{
+public:
+    AIPerception(World* world);
+
+    void AddObserver(Actor* actor);
+    void AddNoise(const Vec3& location, float loudness, const Actor* instigator = nullptr);
+
+    void Update();
+
+    bool CanSee(const Actor* observer, const Actor* target) const; // cached inside the sight range, traced directly outside it
+    bool GetHeardNoise(const Actor* observer, Vec3& location, float& loudness) const;
+
+private:
+    void QueryRange(const Vec3& center, float radius, std::vector<Actor*>& actors) const; // live, non-projectile actors within radius
+    void UpdateSight();
+    void UpdateHearing();
+
+private:
+    World * const                                         m_world;
+    std::unordered_map<const Actor*, PerceptionObserver>  m_states;
+    std::vector<Actor*>                                   m_observers;
+    std::vector<PerceptionNoise>                          m_noises;
+    size_t                                                m_nextObserver = 0;
+
+    std::vector<PerceptionSightPair>                      m_pairs;
+    RaycastBatch                                          m_sightRays; // one ray per pair, large batches run on the job system
+
+    float                                                 m_sightRange = 48.0f;
+    float                                                 m_noiseRange = 16.0f; // hearing distance per unit of loudness
+    int                                                   m_raycastBudget = 512;
+};
+
@@ -0,0 +1,199 @@
+#include "Game/World/ActorGrid.hpp"
+
+#include "Game/Entity/Actor.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+static float GetActorRadius(const Actor* actor)
+{
+	return actor->m_physics ? actor->m_physics->m_physicsRadius : 0.0f;
+}
+
+void ActorGrid::UpdateActor(Actor* actor)
+{
+	int index = (int)actor->GetUID().GetIndex();
+	if (index >= (int)m_entries.size())
+		m_entries.resize((size_t)index + 1);
+
+	const Vec3& position = actor->m_transform.m_position;
+	long long cell = GetCellKey(GetCell(position.x), GetCell(position.y));
+	Entry& entry = m_entries[index];
+	if (entry.m_actor == actor && entry.m_cell == cell)
+		return;
+
+	// a reused uid slot may still hold the previous actor
+	if (entry.m_actor)
+		RemoveFromCell(index);
+
+	std::vector<int>& cellActors = m_cells[cell];
+	entry.m_actor = actor;
+	entry.m_cell = cell;
+	entry.m_slot = (int)cellActors.size();
+	cellActors.push_back(index);
+
+	float radius = GetActorRadius(actor);
+	if (radius > m_maxRadius)
+		m_maxRadius = radius;
+}
+
+void ActorGrid::RemoveActor(const Actor* actor)
+{
+	int index = (int)actor->GetUID().GetIndex();
+	if (index < (int)m_entries.size() && m_entries[index].m_actor == actor)
+		RemoveFromCell(index);
+}
+
+void ActorGrid::Clear()
+{
+	m_entries.clear();
+	m_cells.clear();
+	m_maxRadius = 0.0f;
+}
+
+void ActorGrid::QueryBox(const Vec2& mins, const Vec2& maxs, std::vector<Actor*>& actors) const
+{
+	actors.clear();
+	int minX = GetCell(mins.x - m_maxRadius);
+	int maxX = GetCell(maxs.x + m_maxRadius);
+	int minY = GetCell(mins.y - m_maxRadius);
+	int maxY = GetCell(maxs.y + m_maxRadius);
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			auto ite = m_cells.find(GetCellKey(x, y));
+			if (ite == m_cells.end())
+				continue;
+
+			for (int index : ite->second)
+			{
+				Actor* actor = m_entries[index].m_actor;
+				const Vec3& position = actor->m_transform.m_position;
+				float radius = GetActorRadius(actor);
+				if (position.x + radius >= mins.x && position.x - radius <= maxs.x && position.y + radius >= mins.y && position.y - radius <= maxs.y)
+					actors.push_back(actor);
+			}
+		}
+	}
+}
+
+void ActorGrid::QueryRange(const Vec3& center, float radius, std::vector<Actor*>& actors) const
+{
+	QueryBox(Vec2(center.x - radius, center.y - radius), Vec2(center.x + radius, center.y + radius), actors);
+
+	size_t count = 0;
+	for (Actor* actor : actors)
+	{
+		const Vec3& position = actor->m_transform.m_position;
+		float reach = radius + GetActorRadius(actor);
+		float distX = position.x - center.x;
+		float distY = position.y - center.y;
+		if (distX * distX + distY * distY <= reach * reach)
+			actors[count++] = actor;
+	}
+	actors.resize(count);
+}
+
+void ActorGrid::QueryRay(const Vec3& start, const Vec3& forward, float maxDist, std::vector<Actor*>& actors) const
+{
+	actors.clear();
+	Vec2 start2D(start.x, start.y);
+	Vec2 end2D(start.x + forward.x * maxDist, start.y + forward.y * maxDist);
+
+	// cells are widened by the largest radius, so a disc centered next to the ray is still found
+	int reach = (int)ceilf(m_maxRadius / m_cellSize);
+	int cellX = GetCell(start2D.x);
+	int cellY = GetCell(start2D.y);
+	for (int y = cellY - reach; y <= cellY + reach; y++)
+	{
+		for (int x = cellX - reach; x <= cellX + reach; x++)
+			GatherRayCell(x, y, start2D, end2D, actors);
+	}
+
+	// 2D DDA, each step only adds the row or column the widened window moves into, so no cell is gathered twice
+	float deltaX = end2D.x - start2D.x;
+	float deltaY = end2D.y - start2D.y;
+	int stepX = deltaX < 0.0f ? -1 : 1;
+	int stepY = deltaY < 0.0f ? -1 : 1;
+	int remainingX = abs(GetCell(end2D.x) - cellX);
+	int remainingY = abs(GetCell(end2D.y) - cellY);
+	float tDeltaX = deltaX != 0.0f ? m_cellSize / fabsf(deltaX) : INFINITY;
+	float tDeltaY = deltaY != 0.0f ? m_cellSize / fabsf(deltaY) : INFINITY;
+	float tMaxX = deltaX != 0.0f ? ((float)(stepX > 0 ? cellX + 1 : cellX) * m_cellSize - start2D.x) / deltaX : INFINITY;
+	float tMaxY = deltaY != 0.0f ? ((float)(stepY > 0 ? cellY + 1 : cellY) * m_cellSize - start2D.y) / deltaY : INFINITY;
+
+	while (remainingX > 0 || remainingY > 0)
+	{
+		if (remainingY == 0 || (remainingX > 0 && tMaxX < tMaxY))
+		{
+			cellX += stepX;
+			tMaxX += tDeltaX;
+			remainingX--;
+			for (int y = cellY - reach; y <= cellY + reach; y++)
+				GatherRayCell(cellX + stepX * reach, y, start2D, end2D, actors);
+		}
+		else
+		{
+			cellY += stepY;
+			tMaxY += tDeltaY;
+			remainingY--;
+			for (int x = cellX - reach; x <= cellX + reach; x++)
+				GatherRayCell(x, cellY + stepY * reach, start2D, end2D, actors);
+		}
+	}
+}
+
+int ActorGrid::GetCell(float coord) const
+{
+	return (int)floorf(coord / m_cellSize);
+}
+
+long long ActorGrid::GetCellKey(int cellX, int cellY) const
+{
+	return ((long long)cellX << 32) | (long long)(unsigned int)cellY;
+}
+
+void ActorGrid::GatherRayCell(int cellX, int cellY, const Vec2& start, const Vec2& end, std::vector<Actor*>& actors) const
+{
+	auto ite = m_cells.find(GetCellKey(cellX, cellY));
+	if (ite == m_cells.end())
+		return;
+
+	Vec2 segment = end - start;
+	float lengthSquared = segment.x * segment.x + segment.y * segment.y;
+	for (int index : ite->second)
+	{
+		Actor* actor = m_entries[index].m_actor;
+		const Vec3& position = actor->m_transform.m_position;
+		float radius = GetActorRadius(actor);
+
+		// distance from the disc center to the closest point of the segment
+		float t = 0.0f;
+		if (lengthSquared > 0.0f)
+			t = fminf(fmaxf(((position.x - start.x) * segment.x + (position.y - start.y) * segment.y) / lengthSquared, 0.0f), 1.0f);
+		float distX = position.x - (start.x + segment.x * t);
+		float distY = position.y - (start.y + segment.y * t);
+		if (distX * distX + distY * distY <= radius * radius)
+			actors.push_back(actor);
+	}
+}
+
+void ActorGrid::RemoveFromCell(int index)
+{
+	Entry& entry = m_entries[index];
+	auto ite = m_cells.find(entry.m_cell);
+	std::vector<int>& cellActors = ite->second;
+
+	// swap with the last actor of the cell, which then takes over the slot
+	int last = cellActors.back();
+	cellActors[entry.m_slot] = last;
+	m_entries[last].m_slot = entry.m_slot;
+	cellActors.pop_back();
+	if (cellActors.empty())
+		m_cells.erase(ite);
+
+	entry.m_actor = nullptr;
+}
+
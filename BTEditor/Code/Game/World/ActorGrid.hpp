@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+class Actor;
+
+// uniform grid over actor positions in the XY plane, an actor only moves between cells when it crosses one
+// every actor sits in the cell of its position, queries widen by the largest radius seen to reach overlapping ones
+class ActorGrid
+{
+public:
+	void SetCellSize(float cellSize) { m_cellSize = cellSize; }
+	void UpdateActor(Actor* actor); // inserts or moves the actor, call after it moved
+	void RemoveActor(const Actor* actor);
+	void Clear();
+
+	void QueryBox(const Vec2& mins, const Vec2& maxs, std::vector<Actor*>& actors) const;       // actors whose disc may touch the box
+	void QueryRange(const Vec3& center, float radius, std::vector<Actor*>& actors) const;       // actors whose disc overlaps the circle
+	void QueryRay(const Vec3& start, const Vec3& forward, float maxDist, std::vector<Actor*>& actors) const; // actors whose disc may touch the ray in XY
+
+private:
+	struct Entry
+	{
+		Actor*    m_actor = nullptr;
+		long long m_cell = 0;
+		int       m_slot = 0; // position in the cell's list
+	};
+
+	int       GetCell(float coord) const;
+	long long GetCellKey(int cellX, int cellY) const;
+	void      GatherRayCell(int cellX, int cellY, const Vec2& start, const Vec2& end, std::vector<Actor*>& actors) const;
+	void      RemoveFromCell(int index);
+
+private:
+	std::vector<Entry>                              m_entries; // by actor uid index
+	std::unordered_map<long long, std::vector<int>> m_cells;   // actor uid indices per occupied cell
+	float                                           m_cellSize = 4.0f;
+	float                                           m_maxRadius = 0.0f;
+};
+
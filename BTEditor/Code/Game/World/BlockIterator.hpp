@@ -19,6 +19,8 @@ public:
 	inline bool IsValid() const;
 	inline Chunk* GetChunk() const;
 	inline Block* GetBlock() const;
+	inline const Block* PeekBlock() const; // read only, leaves packed chunks packed
+	inline bool IsInEmptySection() const;
 	inline LocalCoords GetLocalCoords() const;
 	inline WorldCoords GetWorldCoords() const;
 
@@ -80,6 +82,22 @@ Block* BlockIterator::GetBlock() const
 	return &m_chunk->GetBlock(coords);
 }
 
+const Block* BlockIterator::PeekBlock() const
+{
+	if (!IsValid())
+		return &Block::INVALID;
+	if (m_blockIndex < 0 || m_blockIndex >= (int)CHUNK_SIZE_BLOCKS)
+		return &Block::INVALID;
+	return &m_chunk->GetBlockAtIndex(m_blockIndex);
+}
+
+bool BlockIterator::IsInEmptySection() const
+{
+	if (!IsValid() || m_blockIndex < 0 || m_blockIndex >= (int)CHUNK_SIZE_BLOCKS)
+		return false;
+	return m_chunk->GetSection(Chunk::GetSectionIndex(m_blockIndex)).IsEmpty();
+}
+
 LocalCoords BlockIterator::GetLocalCoords() const
 {
 	return Chunk::GetLocalCoords(m_blockIndex);
@@ -4,6 +4,8 @@
 #include "Game/Block/BlockMaterialDef.hpp"
 #include "Game/Block/BlockSetDefinition.hpp"
 #include "Game/World/World.hpp"
+#include "Game/World/ChunkMesher.hpp"
+#include "Game/World/ChunkPool.hpp"
 #include "Game/World/ChunkProvider.hpp"
 
 #include "Engine/Core/ByteBuffer.hpp"
@@ -16,11 +18,16 @@
 #include "Engine/Renderer/IndexBuffer.hpp"
 #include "Engine/Renderer/DebugRender.hpp"
 
+#include <mutex>
+
+static std::mutex s_unpackMutex;
+static uint32_t   s_meshVersion = 0;
+
 Chunk::Chunk(World* world, const ChunkCoords& chunkCoords)
 	: m_world(world)
 	, m_chunkCoords(chunkCoords)
 {
-	m_blockArray = new Block[CHUNK_SIZE_BLOCKS];
+	m_blockArray = ChunkPool::GetInstance().AcquireBlocks(true);
 }
 
 Chunk::~Chunk()
@@ -30,59 +37,116 @@ Chunk::~Chunk()
 	delete m_fluidBuffer;
 	delete m_fluidBufferIdx;
 
-	delete m_blockArray;
+	ChunkPool::GetInstance().ReleaseBlocks(m_blockArray.load(std::memory_order_acquire));
 }
 
 void Chunk::Update()
 {
-	if (m_meshDirty)
+	// the palette may still be read by workers until the frame it was unpacked in is over
+	if (!IsPacked())
+	{
+		if (!m_packedBlocks[0].IsEmpty())
+		{
+			for (PalettedBlocks& packed : m_packedBlocks)
+				packed.Clear();
+			m_idleFrames = 0;
+		}
+		m_idleFrames++;
+	}
+
+	if (m_navDirty)
+	{
+		// border links on both sides depend on this chunk's spans
+		m_nav.Build(*this);
+		for (BlockFace face : CHUNK_NEIGHBORS)
+		{
+			if (m_neighbors[face])
+			{
+				m_nav.LinkNeighbor(m_neighbors[face]->m_nav, face);
+				m_neighbors[face]->m_nav.LinkNeighbor(m_nav, (BlockFace)(face ^ 1));
+			}
+		}
+		m_navDirty = false;
+	}
+
+	// edits during a rebuild keep the chunk dirty until the pending mesh lands
+	if (m_meshDirty && !m_meshPending)
 	{
 		for (auto& neighbor : m_neighbors)
 			if (!neighbor)
 				return;
 		if (m_world->GetChunkManager()->GetRebuildMeshTicket())
-			RebuildMesh();
+			QueueMeshRebuild();
+	}
+}
+
+void Chunk::UpdateRandomTick(int ticksPerSection, size_t rndSize, const float* rndSource, size_t offset)
+{
+	// only blocks that have a tick rule are candidates, so the cost follows their count and not the volume
+	size_t rndIdx = offset;
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+	{
+		const std::vector<unsigned short>& ticks = m_randomTicks[section];
+		for (int tick = 0; tick < ticksPerSection && !ticks.empty(); tick++)
+		{
+			size_t pick = (size_t)(rndSource[rndIdx++ % rndSize] * (float)ticks.size());
+			if (pick >= ticks.size())
+				pick = ticks.size() - 1;
+			RandomTickBlock(section * CHUNK_SECTION_BLOCKS + ticks[pick], rndSource[rndIdx++ % rndSize]);
+		}
 	}
 }
 
-void Chunk::UpdateRandomTick(size_t rndSize, const float* rndSource, size_t offset)
+void Chunk::RandomTickBlock(int blockIndex, float rnd)
 {
-	if (rndSource[offset] > 0.25f)
+	BlockIterator ite(this, blockIndex);
+	if (ite.PeekBlock()->GetBlockId() != Blocks::BLOCK_GRASS)
 		return;
 
-	size_t rndIdx = offset;
+	// grass spreads onto a neighboring dirt block that has lit air above it, reads leave packed neighbors packed
+	const Block* up = ite.GetBlockNeighborUp().PeekBlock();
+	if (!up->IsValid() || up->GetBlockId() != Blocks::BLOCK_AIR)
+		return;
 
-	for (int i = 0; i < CHUNK_SIZE_BLOCKS; i++)
+	BlockFace face;
+	if (rnd < 0.25f)
+		face = BLOCK_FACE_NORTH;
+	else if (rnd < 0.5f)
+		face = BLOCK_FACE_SOUTH;
+	else if (rnd < 0.75f)
+		face = BLOCK_FACE_WEST;
+	else
+		face = BLOCK_FACE_EAST;
+
+	BlockIterator sideIte = ite.GetBlockNeighbor(face);
+	const Block* side = sideIte.PeekBlock();
+	if (side->IsValid() && side->GetBlockId() == Blocks::BLOCK_DIRT)
 	{
-		if (m_blockArray[i].GetBlockId() == Blocks::BLOCK_GRASS && rndSource[rndIdx++ % rndSize] < 0.01f)
+		up = sideIte.GetBlockNeighborUp().PeekBlock();
+		if (up->IsValid() && up->GetBlockId() == Blocks::BLOCK_AIR)
 		{
-			BlockIterator ite(this, i);
-			Block* up = ite.GetBlockNeighborUp().GetBlock();
-			if (up->IsValid() && up->GetBlockId() == Blocks::BLOCK_AIR)
-			{
-				BlockFace face;
-				float randNum = rndSource[rndIdx++ % rndSize];
-				if (randNum < 0.25f)
-					face = BLOCK_FACE_NORTH;
-				else if (randNum < 0.5f)
-					face = BLOCK_FACE_SOUTH;
-				else if (randNum < 0.75f)
-					face = BLOCK_FACE_WEST;
-				else
-					face = BLOCK_FACE_EAST;
-
-				BlockIterator sideIte = ite.GetBlockNeighbor(face);
-				Block* side = sideIte.GetBlock();
-				if (side->IsValid() && side->GetBlockId() == Blocks::BLOCK_DIRT)
-				{
-					up = sideIte.GetBlockNeighborUp().GetBlock();
-					if (up->IsValid() && up->GetBlockId() == Blocks::BLOCK_AIR)
-					{
-						if (up->GetOutdoorLightInfluence() >= 6 || up->GetIndoorLightInfluence() >= 6)
-							sideIte.GetChunk()->SetBlockId(sideIte.GetLocalCoords(), Blocks::BLOCK_GRASS);
-					}
-				}
-			}
+			if (up->GetOutdoorLightInfluence() >= 6 || up->GetIndoorLightInfluence() >= 6)
+				sideIte.GetChunk()->SetBlockId(sideIte.GetLocalCoords(), Blocks::BLOCK_GRASS);
+		}
+	}
+}
+
+void Chunk::AddRandomTick(int blockIndex)
+{
+	m_randomTicks[GetSectionIndex(blockIndex)].push_back((unsigned short)(blockIndex & (CHUNK_SECTION_BLOCKS - 1)));
+}
+
+void Chunk::RemoveRandomTick(int blockIndex)
+{
+	std::vector<unsigned short>& ticks = m_randomTicks[GetSectionIndex(blockIndex)];
+	unsigned short local = (unsigned short)(blockIndex & (CHUNK_SECTION_BLOCKS - 1));
+	for (size_t i = 0; i < ticks.size(); i++)
+	{
+		if (ticks[i] == local)
+		{
+			ticks[i] = ticks.back();
+			ticks.pop_back();
+			return;
 		}
 	}
 }
@@ -111,64 +175,30 @@ void Chunk::Render(int pass) const
 
 void Chunk::RebuildMesh()
 {
-	RebuildOpaqueMesh();
-	RebuildTranslucentMesh();
+	ChunkMeshSnapshot* snapshot = new ChunkMeshSnapshot();
+	snapshot->Capture(*this);
+	ChunkMeshData data;
+	data.Build(*snapshot);
+	delete snapshot;
+
+	// a job still in flight for this chunk is now stale
+	m_meshVersion = ++s_meshVersion;
 	m_meshDirty = false;
+	UploadMesh(data);
 }
 
-void Chunk::MarkDirty()
+void Chunk::QueueMeshRebuild()
 {
-	m_meshDirty = true;
-	m_blocksDirty = true;
+	m_meshVersion = ++s_meshVersion;
+	m_meshDirty = false;
+	m_meshPending = true;
+	m_world->GetChunkManager()->QueueChunkMesh(this);
 }
 
-void Chunk::PopulateSkyLight()
+void Chunk::MarkDirty()
 {
-	LocalCoords coords = IntVec3::ZERO;
-	BlockIterator ite = BlockIterator(this, CHUNK_SIZE_BLOCKS);
-	for (coords.z = CHUNK_MAX_Z; coords.z >= 0; coords.z--)
-		for (coords.y = CHUNK_MAX_Y; coords.y >= 0; coords.y--)
-			for (coords.x = CHUNK_MAX_X; coords.x >= 0; coords.x--)
-			{
-				ite--;
-				Block* blk = ite.GetBlock();
-				if (blk->IsSolid())
-					continue;
-				
-				if (coords.z == CHUNK_MAX_Z || ite.GetBlockNeighbor(BLOCK_FACE_UP).GetBlock()->IsSky())
-				{
-					blk->SetSky(true);
-					blk->SetOutdoorLightInfluence(15);
-				}
-			}
-
-	ite = BlockIterator(this, CHUNK_SIZE_BLOCKS);
-	for (coords.z = CHUNK_MAX_Z; coords.z >= 0; coords.z--)
-		for (coords.y = CHUNK_MAX_Y; coords.y >= 0; coords.y--)
-			for (coords.x = CHUNK_MAX_X; coords.x >= 0; coords.x--)
-			{
-				ite--;
-				Block* blk = ite.GetBlock();
-				if (blk->GetGlowLight())
-				{
-					m_world->GetChunkManager()->MarkLightingDirty(ite);
-					continue;
-				}
-
-				if (!blk->IsSky())
-					continue;
-
-				for (BlockFace face : CHUNK_NEIGHBORS)
-				{
-					BlockIterator iteNbr = ite.GetBlockNeighbor(face);
-
-					Block* block = iteNbr.GetBlock();
-					if (block->IsValid() && !block->IsSky() && !block->IsSolid())
-					{
-						m_world->GetChunkManager()->MarkLightingDirty(iteNbr);
-					}
-				}
-			}
+	m_meshDirty = true;
+	m_blocksDirty = true;
 }
 
 WorldCoords Chunk::GetChunkOrigin() const
@@ -195,8 +225,7 @@ const Block& Chunk::GetBlock(const LocalCoords& localCoords) const
 	if (localCoords.z < 0 || localCoords.z >= CHUNK_SIZE_Z)
 		return Block::INVALID;
 
-	int index = GetIndex(localCoords);
-	return m_blockArray[index];
+	return GetBlockAtIndex(GetIndex(localCoords));
 }
 
 Block& Chunk::GetBlock(const LocalCoords& localCoords)
@@ -215,7 +244,7 @@ Block& Chunk::GetBlock(const LocalCoords& localCoords)
 	}
 
 	int index = GetIndex(localCoords);
-	return m_blockArray[index];
+	return GetBlocks()[index];
 }
 
 void Chunk::SetBlockId(const LocalCoords& localCoords, BlockId block)
@@ -237,14 +266,34 @@ void Chunk::SetBlockId(const LocalCoords& localCoords, BlockId block)
 	}
 
 	int index = GetIndex(localCoords);
+	Block* blocks = GetBlocks();
 
-	bool wasOpaque = m_blockArray[index].IsOpaque();
+	bool wasOpaque = blocks[index].IsOpaque();
+	bool wasAir = blocks[index].GetBlockId() == Blocks::BLOCK_AIR;
+	bool wasTicked = blocks[index].GetBlockDef()->m_randomTick;
 
-	m_blockArray[index].SetBlockId(block);
+	blocks[index].SetBlockId(block);
+
+	bool isTicked = blocks[index].GetBlockDef()->m_randomTick;
+	if (wasTicked != isTicked)
+	{
+		if (isTicked)
+			AddRandomTick(index);
+		else
+			RemoveRandomTick(index);
+	}
+
+	ChunkSection& section = m_sections[GetSectionIndex(index)];
+	section.m_nonAirCount = (unsigned short)(section.m_nonAirCount + (int)wasAir - (int)(block == Blocks::BLOCK_AIR));
+	section.m_opaqueCount = (unsigned short)(section.m_opaqueCount + (int)blocks[index].IsOpaque() - (int)wasOpaque);
+	if (block != section.m_uniformId)
+		section.m_uniform = false;
 
 	MarkDirty();
+	m_navDirty = true;
+	m_idleFrames = 0;
 
-	if (wasOpaque != m_blockArray[index].IsOpaque() && wasOpaque) // change from opaque to transparent, neighbor might need to build a face
+	if (wasOpaque != blocks[index].IsOpaque() && wasOpaque) // change from opaque to transparent, neighbor might need to build a face
 	{
 		BlockIterator ite(this, index);
 		for (BlockFace face : CHUNK_NEIGHBORS)
@@ -256,7 +305,7 @@ void Chunk::SetBlockId(const LocalCoords& localCoords, BlockId block)
 	}
 
 	m_world->GetChunkManager()->MarkLightingDirty(BlockIterator(this, index));
-	if (!m_blockArray[index].IsOpaque())
+	if (!blocks[index].IsOpaque())
 	{
 		// transparent (air)
 		BlockIterator ite = BlockIterator(this, index);
@@ -401,16 +450,13 @@ void Chunk::OnNeighborLoad(Chunk& neighbor)
 		{
 			m_neighbors[face] = &neighbor;
 			m_meshDirty = true;
-			break;
-		}
-	}
+			m_nav.LinkNeighbor(neighbor.m_nav, face);
 
-	for (auto& nbr : m_neighbors)
-		if (!nbr)
+			// the chunk was lit on its own when populated, only light crossing this border is left
+			m_world->GetChunkManager()->MarkBorderLightingDirty(this, face);
 			return;
-
-	// all neighbors are loaded, do some work
-	PopulateSkyLight();
+		}
+	}
 }
 
 void Chunk::OnNeighborUnload(const Chunk& neighbor)
@@ -421,6 +467,7 @@ void Chunk::OnNeighborUnload(const Chunk& neighbor)
 		{
 			m_neighbors[face] = nullptr;
 			m_meshDirty = true;
+			m_nav.UnlinkNeighbor(face);
 			return;
 		}
 	}
@@ -446,22 +493,36 @@ void Chunk::OnNeighborBlockUpdate(const Chunk& neighbor, const LocalCoords& coor
 
 void Chunk::WriteBytes(ByteBuffer* buffer) const
 {
-	unsigned char rle_len = 1;
-	unsigned char rle_last_char = m_blockArray[0].GetBlockId();
-	for (size_t idx = 1; idx < CHUNK_SIZE_BLOCKS; idx++)
+	unsigned char rle_len = 0;
+	unsigned char rle_last_char = GetBlockAtIndex(0).GetBlockId();
+	auto writeRun = [&](unsigned char rle_char, int count)
 	{
-		unsigned char rle_char = m_blockArray[idx].GetBlockId();
-		if (rle_char != rle_last_char || rle_len == 255)
+		while (count > 0)
 		{
-			buffer->Write(rle_last_char);
-			buffer->Write(rle_len);
-			rle_len = 1;
-			rle_last_char = rle_char;
+			if (rle_char != rle_last_char || rle_len == 255)
+			{
+				buffer->Write(rle_last_char);
+				buffer->Write(rle_len);
+				rle_len = 0;
+				rle_last_char = rle_char;
+			}
+			int len = count < 255 - rle_len ? count : 255 - rle_len;
+			rle_len = (unsigned char)(rle_len + len);
+			count -= len;
 		}
-		else
+	};
+
+	// uniform sections are written as runs without reading their blocks
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+	{
+		if (m_sections[section].m_uniform)
 		{
-			rle_len++;
+			writeRun(m_sections[section].m_uniformId, CHUNK_SECTION_BLOCKS);
+			continue;
 		}
+
+		for (int idx = section * CHUNK_SECTION_BLOCKS; idx < (section + 1) * (int)CHUNK_SECTION_BLOCKS; idx++)
+			writeRun(GetBlockAtIndex(idx).GetBlockId(), 1);
 	}
 	buffer->Write(rle_last_char);
 	buffer->Write(rle_len);
@@ -472,287 +533,130 @@ void Chunk::ReadBytes(ByteBuffer* buffer)
 	size_t idx = 0;
 	unsigned char rle_len;
 	unsigned char rle_last_char;
+	Block* blocks = GetBlocks();
 	while (idx < CHUNK_SIZE_BLOCKS)
 	{
 		buffer->Read(rle_last_char);
 		buffer->Read(rle_len);
 		for (int i = 0; i < rle_len; i++)
-			m_blockArray[idx + i].SetBlockId(rle_last_char);
+			blocks[idx + i].SetBlockId(rle_last_char);
 		idx += rle_len;
 	}
+
+	RecountSections();
 }
 
-void Chunk::RebuildOpaqueMesh()
+void Chunk::RecountSections()
 {
-	Shader* shader = BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas()->m_shader;
-	m_opaqueMesh.Start(shader->GetInputFormat(0), 65535);
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+	{
+		ChunkSection& counts = m_sections[section];
+		counts = ChunkSection();
+		counts.m_uniformId = GetBlockAtIndex(section * CHUNK_SECTION_BLOCKS).GetBlockId();
+		m_randomTicks[section].clear();
 
-	LocalCoords coords = IntVec3::ZERO;
-	for (coords.z = 0; coords.z < CHUNK_SIZE_Z; coords.z++)
-		for (coords.y = 0; coords.y < CHUNK_SIZE_XY; coords.y++)
-			for (coords.x = 0; coords.x < CHUNK_SIZE_XY; coords.x++)
-			{
-				WorldCoords worldCoords = GetWorldCoords(coords);
-				Vec3 worldPos;
-				worldPos.x = (float)worldCoords.x;
-				worldPos.y = (float)worldCoords.y;
-				worldPos.z = (float)worldCoords.z;
-
-				const Block& block = GetBlock(coords);
-				const BlockDef* blockDef = block.GetBlockDef();
-				if (!blockDef->m_opaque)
-					continue;
-
-				for (BlockFace face : BLOCK_NEIGHBORS)
-				{
-					const Block* neighborBlock = BlockIterator(this, coords).GetBlockNeighbor(face).GetBlock();
-					if (neighborBlock->IsValid())
-					{
-						if (neighborBlock->GetBlockId() == block.GetBlockId())
-							continue; // cull same block face
-						if (neighborBlock->IsOpaque())
-							continue; // cull opaque neighbor face
-					}
-
-					const BlockMaterialDef* material = blockDef->GetBlockMaterial(face);
-
-					if (!material->m_visible)
-						continue;
-
-					unsigned char iLight /* indoor  */ = neighborBlock ? neighborBlock->GetIndoorLightInfluenceNormalized() : 15;
-					unsigned char oLight /* outdoor */ = neighborBlock ? neighborBlock->GetOutdoorLightInfluenceNormalized() : 0;
-
-					switch (face)
-					{
-					case BLOCK_FACE_NORTH:
-					{
-						unsigned char fLight /* face */ = 0xCD;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_SOUTH:
-					{
-						unsigned char fLight /* face */ = 0xCD;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_WEST:
-					{
-						unsigned char fLight /* face */ = 0xE6;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_EAST:
-					{
-						unsigned char fLight /* face */ = 0xE6;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_UP:
-					{
-						unsigned char fLight /* face */ = 0xFF;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_DOWN:
-					{
-						unsigned char fLight /* face */ = 0xFF;
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_opaqueMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					}
-				}
-			}
+		for (int idx = section * CHUNK_SECTION_BLOCKS; idx < (section + 1) * (int)CHUNK_SECTION_BLOCKS; idx++)
+		{
+			const Block& block = GetBlockAtIndex(idx);
+			if (block.GetBlockId() != Blocks::BLOCK_AIR)
+				counts.m_nonAirCount++;
+			if (block.IsOpaque())
+				counts.m_opaqueCount++;
+			if (block.GetBlockId() != counts.m_uniformId)
+				counts.m_uniform = false;
+			if (block.GetBlockDef()->m_randomTick)
+				AddRandomTick(idx);
+		}
+	}
+}
+
+Block* Chunk::GetBlocks()
+{
+	Block* blocks = m_blockArray.load(std::memory_order_acquire);
+	if (blocks)
+		return blocks;
+
+	// workers may get here too, the palette itself is only released by Update on the main thread
+	std::lock_guard<std::mutex> lock(s_unpackMutex);
+	blocks = m_blockArray.load(std::memory_order_relaxed);
+	if (!blocks)
+	{
+		blocks = ChunkPool::GetInstance().AcquireBlocks(false);
+		for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+			m_packedBlocks[section].Unpack(blocks + section * CHUNK_SECTION_BLOCKS);
+		m_blockArray.store(blocks, std::memory_order_release);
+	}
+	return blocks;
+}
+
+bool Chunk::CanPack(int idleFrames) const
+{
+	return m_state == ChunkState::LOADED && !IsPacked() && !m_meshDirty && !m_navDirty && m_idleFrames >= idleFrames;
+}
+
+void Chunk::Pack()
+{
+	Block* blocks = m_blockArray.load(std::memory_order_acquire);
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+		m_packedBlocks[section].Pack(blocks + section * CHUNK_SECTION_BLOCKS, CHUNK_SECTION_BLOCKS);
+	m_blockArray.store(nullptr, std::memory_order_release);
+	ChunkPool::GetInstance().ReleaseBlocks(blocks);
+}
+
+bool Chunk::IsSectionBuried(int sectionIndex) const
+{
+	// faces towards the world bottom and top are always drawn
+	if (sectionIndex == 0 || sectionIndex == (int)CHUNK_SECTION_COUNT - 1)
+		return false;
+	if (!m_sections[sectionIndex].IsOpaque() || !m_sections[sectionIndex - 1].IsOpaque() || !m_sections[sectionIndex + 1].IsOpaque())
+		return false;
+
+	for (const Chunk* neighbor : m_neighbors)
+	{
+		if (!neighbor || !neighbor->m_sections[sectionIndex].IsOpaque())
+			return false;
+	}
+	return true;
+}
+
+void Chunk::UploadMesh(ChunkMeshData& data)
+{
+	Shader* shader = BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas()->m_shader;
 
 	delete m_opaqueBuffer;
 	delete m_opaqueBufferIdx;
 
-	if (m_opaqueMesh.Count())
+	if (data.m_opaque.Count())
 	{
-		m_opaqueBuffer = g_theRenderer->CreateVertexBuffer(m_opaqueMesh.GetBufferSize(), &shader->GetInputFormat(0));
-		m_opaqueMesh.Upload(g_theRenderer, m_opaqueBuffer);
+		m_opaqueBuffer = g_theRenderer->CreateVertexBuffer(data.m_opaque.GetBufferSize(), &shader->GetInputFormat(0));
+		data.m_opaque.Upload(g_theRenderer, m_opaqueBuffer);
 
-		size_t meshIndexCount = m_opaqueMesh.Count() / 4 * 6;
-		int* indexBuffer = new int[meshIndexCount];
-		size_t indexIdx = 0;
-		for (int index = 0; index < m_opaqueMesh.Count(); index += 4)
-		{
-			indexBuffer[indexIdx + 0] = index + 0;
-			indexBuffer[indexIdx + 1] = index + 1;
-			indexBuffer[indexIdx + 2] = index + 2;
-			indexBuffer[indexIdx + 3] = index + 0;
-			indexBuffer[indexIdx + 4] = index + 2;
-			indexBuffer[indexIdx + 5] = index + 3;
-			indexIdx += 6;
-		}
-		m_opaqueBufferIdx = g_theRenderer->CreateIndexBuffer(sizeof(int) * meshIndexCount);
-		g_theRenderer->CopyCPUToGPU(indexBuffer, sizeof(int) * meshIndexCount, m_opaqueBufferIdx);
-		delete[] indexBuffer;
+		m_opaqueBufferIdx = g_theRenderer->CreateIndexBuffer(sizeof(int) * data.m_opaqueIndices.size());
+		g_theRenderer->CopyCPUToGPU(data.m_opaqueIndices.data(), sizeof(int) * data.m_opaqueIndices.size(), m_opaqueBufferIdx);
 	}
 	else
 	{
 		m_opaqueBuffer = nullptr;
 		m_opaqueBufferIdx = nullptr;
 	}
-	m_opaqueMeshCount = m_opaqueMesh.Count();
-    m_opaqueMesh.Reset();
-    m_opaqueMesh.Clear();
-}
-
-void Chunk::RebuildTranslucentMesh()
-{
-	Shader* shader = BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas()->m_shader;
-	m_fluidMesh.Start(shader->GetInputFormat(0), 65535);
-
-	LocalCoords coords = IntVec3::ZERO;
-	for (coords.z = 0; coords.z < CHUNK_SIZE_Z; coords.z++)
-		for (coords.y = 0; coords.y < CHUNK_SIZE_XY; coords.y++)
-			for (coords.x = 0; coords.x < CHUNK_SIZE_XY; coords.x++)
-			{
-				WorldCoords worldCoords = GetWorldCoords(coords);
-				Vec3 worldPos;
-				worldPos.x = (float)worldCoords.x;
-				worldPos.y = (float)worldCoords.y;
-				worldPos.z = (float)worldCoords.z;
-
-				const Block& block = GetBlock(coords);
-				if (block.GetBlockId() == Blocks::BLOCK_AIR)
-					continue; // do not render air
-				if (block.IsOpaque())
-					continue; // do not render opaque
-
-				bool isUpAir = false;
-				const Block* upBlock = BlockIterator(this, coords).GetBlockNeighborUp().GetBlock();
-				isUpAir = !upBlock->IsValid() || upBlock->GetBlockId() == Blocks::BLOCK_AIR;
-
-				for (BlockFace face : BLOCK_NEIGHBORS)
-				{
-					const Block* neighborBlock = BlockIterator(this, coords).GetBlockNeighbor(face).GetBlock();
-					if (neighborBlock->IsValid())
-					{
-						if (neighborBlock->GetBlockId() == block.GetBlockId())
-							continue; // cull same block face
-						if (neighborBlock->IsOpaque())
-							continue; // cull opaque neighbor face
-					}
-
-					const BlockMaterialDef* material = block.GetBlockDef()->GetBlockMaterial(face);
-
-					if (!material->m_visible)
-						continue;
-
-					unsigned char iLight /* indoor  */ = neighborBlock ? neighborBlock->GetIndoorLightInfluenceNormalized() : 15;
-					unsigned char oLight /* outdoor */ = neighborBlock ? neighborBlock->GetOutdoorLightInfluenceNormalized() : 0;
-
-					switch (face)
-					{
-					case BLOCK_FACE_NORTH:
-					{
-						unsigned char fLight /* face */ = 0xCD;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_SOUTH:
-					{
-						unsigned char fLight /* face */ = 0xCD;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_WEST:
-					{
-						unsigned char fLight /* face */ = 0xE6;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_EAST:
-					{
-						unsigned char fLight /* face */ = 0xE6;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, isUpAir ? 0xff : fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_UP:
-					{
-						unsigned char fLight /* face */ = isUpAir ? 0xff : 0xF9;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 1.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					case BLOCK_FACE_DOWN:
-					{
-						unsigned char fLight /* face */ = 0xF9;
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(1.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_mins.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 0.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_maxs.x, material->m_uv.m_maxs.y)->end();
-						m_fluidMesh.begin()->pos(worldPos + Vec3(0.0f, 1.0f, 0.0f))->color(iLight, oLight, fLight)->tex(material->m_uv.m_mins.x, material->m_uv.m_maxs.y)->end();
-					}
-					break;
-					}
-				}
-			}
+	m_opaqueMeshCount = data.m_opaque.Count();
 
 	delete m_fluidBuffer;
 	delete m_fluidBufferIdx;
 
-	if (m_fluidMesh.Count())
+	if (data.m_fluid.Count())
 	{
-		m_fluidBuffer = g_theRenderer->CreateVertexBuffer(m_fluidMesh.GetBufferSize(), &shader->GetInputFormat(0));
-		m_fluidMesh.Upload(g_theRenderer, m_fluidBuffer);
+		m_fluidBuffer = g_theRenderer->CreateVertexBuffer(data.m_fluid.GetBufferSize(), &shader->GetInputFormat(0));
+		data.m_fluid.Upload(g_theRenderer, m_fluidBuffer);
 
-		size_t meshIndexCount = m_fluidMesh.Count() / 4 * 6;
-		int* indexBuffer = new int[meshIndexCount];
-		size_t indexIdx = 0;
-		for (int index = 0; index < m_fluidMesh.Count(); index += 4)
-		{
-			indexBuffer[indexIdx + 0] = index + 0;
-			indexBuffer[indexIdx + 1] = index + 1;
-			indexBuffer[indexIdx + 2] = index + 2;
-			indexBuffer[indexIdx + 3] = index + 0;
-			indexBuffer[indexIdx + 4] = index + 2;
-			indexBuffer[indexIdx + 5] = index + 3;
-			indexIdx += 6;
-		}
-		m_fluidBufferIdx = g_theRenderer->CreateIndexBuffer(sizeof(int) * meshIndexCount);
-		g_theRenderer->CopyCPUToGPU(indexBuffer, sizeof(int) * meshIndexCount, m_fluidBufferIdx);
-		delete[] indexBuffer;
+		m_fluidBufferIdx = g_theRenderer->CreateIndexBuffer(sizeof(int) * data.m_fluidIndices.size());
+		g_theRenderer->CopyCPUToGPU(data.m_fluidIndices.data(), sizeof(int) * data.m_fluidIndices.size(), m_fluidBufferIdx);
 	}
 	else
 	{
 		m_fluidBuffer = nullptr;
 		m_fluidBufferIdx = nullptr;
-    }
-    m_fluidMeshCount = m_fluidMesh.Count();
-	m_fluidMesh.Reset();
-	m_fluidMesh.Clear();
+	}
+	m_fluidMeshCount = data.m_fluid.Count();
+	m_meshPending = false;
 }
@@ -2,12 +2,15 @@
 
 #include "Game/Framework/GameCommon.hpp"
 #include "Game/Block/Block.hpp"
+#include "Game/World/ChunkNav.hpp"
+#include "Game/World/PalettedBlocks.hpp"
 #include "Engine/Math/IntVec2.hpp"
 #include "Engine/Math/IntVec3.hpp"
 #include "Engine/Math/Vec3.hpp"
 #include "Engine/Renderer/VertexFormat.hpp"
 
 #include <atomic>
+#include <vector>
 
 //------------------------------------------------------------------------------------------------
 typedef unsigned char BlockId;
@@ -19,6 +22,7 @@ class World;
 class VertexBuffer;
 class IndexBuffer;
 class ByteBuffer;
+struct ChunkMeshData;
 
 struct BlockState
 {
@@ -27,6 +31,18 @@ struct BlockState
 	Block m_block;
 };
 
+// 16x16x16 slice of a chunk, lets whole runs of air or stone be skipped
+struct ChunkSection
+{
+	unsigned short m_nonAirCount = 0;
+	unsigned short m_opaqueCount = 0;
+	bool           m_uniform = true;      // every block has m_uniformId, only cleared by edits until the next recount
+	BlockId        m_uniformId = 0;
+
+	bool IsEmpty() const { return m_nonAirCount == 0; }
+	bool IsOpaque() const { return m_opaqueCount == CHUNK_SECTION_BLOCKS; }
+};
+
 enum class ChunkState
 {
 	UNLOAD,           // chunk is not in memory 
@@ -49,23 +65,26 @@ public:
 	static inline WorldCoords            GetWorldCoords(const ChunkCoords& chunkCoords, const LocalCoords& localCoords);
 	static inline int                    GetIndex(const LocalCoords& localCoords);
 	static inline LocalCoords            GetLocalCoords(int blockIndex);
+	static inline int                    GetSectionIndex(int blockIndex);
 
 	Chunk(World* world, const ChunkCoords& chunkCoords);
 	~Chunk();
 
 	void Update();
-	void UpdateRandomTick(size_t rndSize, const float* rndSource, size_t offset);
+	void UpdateRandomTick(int ticksPerSection, size_t rndSize, const float* rndSource, size_t offset);
 	void Render(int pass) const;
 
 	void RebuildMesh();
+	void QueueMeshRebuild();
+	void UploadMesh(ChunkMeshData& data);
 	void MarkDirty();
-	void PopulateSkyLight();
 
 	WorldCoords     GetChunkOrigin() const;
 	WorldCoords     GetWorldCoords(const LocalCoords& localCoords) const;
 	BlockId         GetBlockId(const LocalCoords& localCoords) const;
 	const Block&    GetBlock(const LocalCoords& localCoords) const;
 	Block&          GetBlock(const LocalCoords& localCoords);
+	inline const Block& GetBlockAtIndex(int blockIndex) const;
 	void            SetBlockId(const LocalCoords& localCoords, BlockId block);
 	const Block&    FindBlockOnFace(const LocalCoords& coords, BlockFace face) const;
 
@@ -76,26 +95,46 @@ public:
 	void            WriteBytes(ByteBuffer* buffer) const;
 	void            ReadBytes(ByteBuffer* buffer);
 
-private:
-	void RebuildOpaqueMesh();
-	void RebuildTranslucentMesh();
+	const ChunkSection& GetSection(int sectionIndex) const { return m_sections[sectionIndex]; }
+	void            RecountSections();
+	int             GetRandomTickCount(int sectionIndex) const { return (int)m_randomTicks[sectionIndex].size(); }
+	bool            IsSectionBuried(int sectionIndex) const;
+
+	// packed storage for idle chunks, any mutable access unpacks again
+	Block*          GetBlocks();
+	bool            IsPacked() const { return m_blockArray.load(std::memory_order_acquire) == nullptr; }
+	bool            CanPack(int idleFrames) const;
+	void            Pack();
 
 public:
 	World* m_world;
 	ChunkCoords m_chunkCoords;
 	std::atomic<ChunkState> m_state = ChunkState::UNLOAD;
+	std::atomic<bool> m_cancelled = false; // set while queued once no hotspot wants it, the load job then drops it
 	Chunk* m_neighbors[4] = {}; // NORTH(+X), SOUTH(-X), WEST(+Y), EAST(-Y)
-	Block* m_blockArray = nullptr;
+	std::atomic<Block*> m_blockArray = nullptr; // null while packed
+	PalettedBlocks m_packedBlocks[CHUNK_SECTION_COUNT];
+	ChunkSection m_sections[CHUNK_SECTION_COUNT];
+	int m_idleFrames = 0;
+	std::vector<unsigned short> m_randomTicks[CHUNK_SECTION_COUNT]; // section-local indices of blocks with random ticks
 
 	bool m_meshDirty = true;
 	bool m_blocksDirty = false;
+	bool m_navDirty = false;
+	bool m_meshPending = false;
+	uint32_t m_meshVersion = 0; // bumped per rebuild, older mesh jobs are discarded
+
+	ChunkNav m_nav;
 
 private:
-	VertexBufferBuilder m_opaqueMesh;
-    uint32_t m_opaqueMeshCount = 0;
+	void RandomTickBlock(int blockIndex, float rnd);
+	void AddRandomTick(int blockIndex);
+	void RemoveRandomTick(int blockIndex);
+
+private:
+	uint32_t m_opaqueMeshCount = 0;
 	VertexBuffer* m_opaqueBuffer = nullptr;
 	IndexBuffer* m_opaqueBufferIdx = nullptr;
-	VertexBufferBuilder m_fluidMesh;
 	uint32_t m_fluidMeshCount = 0;
 	VertexBuffer* m_fluidBuffer = nullptr;
 	IndexBuffer* m_fluidBufferIdx = nullptr;
@@ -160,6 +199,17 @@ WorldCoords Chunk::GetOriginInWorld(const ChunkCoords& chunkCoords)
 	return origin;
 }
 
+const Block& Chunk::GetBlockAtIndex(int blockIndex) const
+{
+	Block* blocks = m_blockArray.load(std::memory_order_acquire);
+	return blocks ? blocks[blockIndex] : m_packedBlocks[GetSectionIndex(blockIndex)].Get(blockIndex & (CHUNK_SECTION_BLOCKS - 1));
+}
+
+int Chunk::GetSectionIndex(int blockIndex)
+{
+	return blockIndex >> CHUNK_SECTION_BITSHIFT;
+}
+
 int Chunk::GetIndex(const LocalCoords& localCoords)
 {
 	int i = 0;
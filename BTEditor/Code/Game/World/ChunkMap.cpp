@@ -0,0 +1,109 @@
+#include "Game/World/ChunkMap.hpp"
+
+constexpr int CHUNK_MAP_INITIAL_SLOTS = 256;
+
+ChunkMap::ChunkMap()
+{
+	m_slots.resize(CHUNK_MAP_INITIAL_SLOTS);
+	m_slotMask = CHUNK_MAP_INITIAL_SLOTS - 1;
+}
+
+Chunk* ChunkMap::Find(const ChunkCoords& coords) const
+{
+	int slot = FindSlot(coords);
+	return m_slots[slot].m_entry < 0 ? nullptr : m_entries[m_slots[slot].m_entry].second;
+}
+
+void ChunkMap::Insert(const ChunkCoords& coords, Chunk* chunk)
+{
+	int slot = FindSlot(coords);
+	if (m_slots[slot].m_entry >= 0)
+	{
+		m_entries[m_slots[slot].m_entry].second = chunk;
+		return;
+	}
+
+	// stay at most half full so probe chains remain short
+	if ((m_entries.size() + 1) * 2 > m_slots.size())
+	{
+		Grow();
+		slot = FindSlot(coords);
+	}
+
+	m_slots[slot].m_coords = coords;
+	m_slots[slot].m_entry = (int)m_entries.size();
+	m_entries.emplace_back(coords, chunk);
+}
+
+bool ChunkMap::Erase(const ChunkCoords& coords)
+{
+	int slot = FindSlot(coords);
+	int entry = m_slots[slot].m_entry;
+	if (entry < 0)
+		return false;
+
+	// fill the entry gap with the last entry and repoint its slot
+	if (entry != (int)m_entries.size() - 1)
+	{
+		m_entries[entry] = m_entries.back();
+		m_slots[FindSlot(m_entries[entry].first)].m_entry = entry;
+	}
+	m_entries.pop_back();
+
+	// shift later slots of the probe chain back instead of leaving tombstones
+	unsigned int hole = (unsigned int)slot;
+	unsigned int next = hole;
+	m_slots[hole].m_entry = -1;
+	while (true)
+	{
+		next = (next + 1) & m_slotMask;
+		if (m_slots[next].m_entry < 0)
+			break;
+
+		unsigned int home = (unsigned int)GetHomeSlot(m_slots[next].m_coords);
+		if (((next - home) & m_slotMask) >= ((next - hole) & m_slotMask))
+		{
+			m_slots[hole] = m_slots[next];
+			m_slots[next].m_entry = -1;
+			hole = next;
+		}
+	}
+	return true;
+}
+
+void ChunkMap::Clear()
+{
+	m_entries.clear();
+	for (Slot& slot : m_slots)
+		slot.m_entry = -1;
+}
+
+int ChunkMap::GetHomeSlot(const ChunkCoords& coords) const
+{
+	// neighboring coords land in different slots
+	unsigned int hash = (unsigned int)coords.x * 0x9E3779B1u ^ (unsigned int)coords.y * 0x85EBCA77u;
+	hash ^= hash >> 16;
+	return (int)(hash & m_slotMask);
+}
+
+int ChunkMap::FindSlot(const ChunkCoords& coords) const
+{
+	unsigned int slot = (unsigned int)GetHomeSlot(coords);
+	while (m_slots[slot].m_entry >= 0 && m_slots[slot].m_coords != coords)
+		slot = (slot + 1) & m_slotMask;
+	return (int)slot;
+}
+
+void ChunkMap::Grow()
+{
+	m_slots.assign(m_slots.size() * 2, Slot());
+	m_slotMask = (unsigned int)m_slots.size() - 1;
+
+	for (int i = 0; i < (int)m_entries.size(); i++)
+	{
+		int slot = FindSlot(m_entries[i].first);
+		m_slots[slot].m_coords = m_entries[i].first;
+		m_slots[slot].m_entry = i;
+	}
+}
+
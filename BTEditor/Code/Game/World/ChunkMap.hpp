@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+
+#include <utility>
+#include <vector>
+
+typedef std::pair<ChunkCoords, Chunk*> ChunkMapEntry;
+
+// coords to chunk lookup, open addressing over a slot table pointing into a dense entry list
+class ChunkMap
+{
+public:
+	typedef std::vector<ChunkMapEntry>::const_iterator const_iterator;
+
+	ChunkMap();
+
+	Chunk* Find(const ChunkCoords& coords) const;
+	void   Insert(const ChunkCoords& coords, Chunk* chunk);
+	bool   Erase(const ChunkCoords& coords);
+	void   Clear();
+
+	size_t size() const { return m_entries.size(); }
+	bool   empty() const { return m_entries.empty(); }
+
+	// entries are packed but unordered, erasing moves the last entry into the gap
+	const_iterator begin() const { return m_entries.begin(); }
+	const_iterator end() const { return m_entries.end(); }
+
+private:
+	struct Slot
+	{
+		ChunkCoords m_coords;
+		int         m_entry = -1;
+	};
+
+	int  GetHomeSlot(const ChunkCoords& coords) const;
+	int  FindSlot(const ChunkCoords& coords) const;
+	void Grow();
+
+private:
+	std::vector<ChunkMapEntry> m_entries;
+	std::vector<Slot>          m_slots;
+	unsigned int               m_slotMask = 0;
+};
+
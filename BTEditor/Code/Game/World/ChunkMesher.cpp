@@ -0,0 +1,352 @@
+#include "Game/World/ChunkMesher.hpp"
+
+#include "Game/Block/BlockDef.hpp"
+#include "Game/Block/BlockMaterialDef.hpp"
+#include "Game/Block/BlockSetDefinition.hpp"
+#include "Game/World/ChunkProvider.hpp"
+#include "Game/World/World.hpp"
+
+#include "Engine/Renderer/Shader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+void ChunkMeshSnapshot::Capture(const Chunk& chunk)
+{
+	m_chunkCoords = chunk.m_chunkCoords;
+
+	// the atlas column count rides in the vertex alpha, 255 is left for untiled faces
+	const BlockMaterialAtlas* atlas = BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas();
+	m_atlasColumns = atlas->m_gridLayout.x;
+	m_atlasRows = atlas->m_gridLayout.y;
+	m_greedy = chunk.m_world->GetChunkManager()->IsGreedyMeshing() && m_atlasColumns < 255;
+
+	std::fill(m_padded, m_padded + MESH_PADDED_BLOCKS, Block::INVALID);
+
+	// interior rows are contiguous along x in both layouts
+	const Block* blocks = chunk.m_blockArray.load(std::memory_order_acquire);
+	for (int z = 0; z < (int)CHUNK_SIZE_Z; z++)
+	{
+		const PalettedBlocks& packed = chunk.m_packedBlocks[z / CHUNK_SECTION_SIZE_Z];
+		for (int y = 0; y < (int)CHUNK_SIZE_XY; y++)
+		{
+			int index = Chunk::GetIndex(LocalCoords(0, y, z));
+			Block* row = m_padded + GetPaddedIndex(LocalCoords(0, y, z));
+			if (blocks)
+				std::copy(blocks + index, blocks + index + CHUNK_SIZE_XY, row);
+			else
+				for (int x = 0; x < (int)CHUNK_SIZE_XY; x++)
+					row[x] = packed.Get((index + x) & (CHUNK_SECTION_BLOCKS - 1));
+		}
+	}
+
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+	{
+		m_sections[section] = chunk.GetSection(section);
+		m_buried[section] = chunk.IsSectionBuried(section);
+	}
+
+	// the layer of each loaded neighbor touching this chunk, the corner columns are never sampled
+	for (BlockFace face : CHUNK_NEIGHBORS)
+	{
+		const Chunk* neighbor = chunk.m_neighbors[face];
+		if (!neighbor)
+			continue;
+
+		for (int z = 0; z < (int)CHUNK_SIZE_Z; z++)
+			for (int i = 0; i < (int)CHUNK_SIZE_XY; i++)
+			{
+				LocalCoords inside;
+				switch (face)
+				{
+				case BLOCK_FACE_NORTH: inside = LocalCoords(CHUNK_MAX_X, i, z); break;
+				case BLOCK_FACE_SOUTH: inside = LocalCoords(0, i, z);           break;
+				case BLOCK_FACE_WEST:  inside = LocalCoords(i, CHUNK_MAX_Y, z); break;
+				case BLOCK_FACE_EAST:  inside = LocalCoords(i, 0, z);           break;
+				default: break;
+				}
+				LocalCoords outside = inside + Block::GetOffsetByFace(face);
+				m_padded[GetPaddedIndex(outside)] = neighbor->GetBlockAtIndex(Chunk::GetIndex(outside)); // index masks into the neighbor
+			}
+	}
+}
+
+int ChunkMeshSnapshot::GetPaddedOffset(BlockFace face)
+{
+	static const int s_offsets[BLOCK_FACE_SIZE] =
+	{
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_NORTH)),
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_SOUTH)),
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_WEST)),
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_EAST)),
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_UP)),
+		GetPaddedOffset(Block::GetOffsetByFace(BLOCK_FACE_DOWN)),
+	};
+	return s_offsets[face];
+}
+
+void ChunkMeshData::Build(const ChunkMeshSnapshot& snapshot)
+{
+	BuildPass(snapshot, false, m_opaque);
+	BuildQuadIndices(m_opaque.Count(), m_opaqueIndices);
+	BuildPass(snapshot, true, m_fluid);
+	BuildQuadIndices(m_fluid.Count(), m_fluidIndices);
+}
+
+void ChunkMeshData::BuildQuadIndices(int vertexCount, std::vector<int>& indices)
+{
+	indices.resize((size_t)vertexCount / 4 * 6);
+	size_t indexIdx = 0;
+	for (int index = 0; index < vertexCount; index += 4)
+	{
+		indices[indexIdx + 0] = index + 0;
+		indices[indexIdx + 1] = index + 1;
+		indices[indexIdx + 2] = index + 2;
+		indices[indexIdx + 3] = index + 0;
+		indices[indexIdx + 4] = index + 2;
+		indices[indexIdx + 5] = index + 3;
+		indexIdx += 6;
+	}
+}
+
+// corner of the block the quad starts at and the world directions its texture u and v run along,
+// single faces come out exactly as the per-block quads always did
+struct MeshFace
+{
+	IntVec3       m_origin;
+	IntVec3       m_u;
+	IntVec3       m_v;
+	unsigned char m_opaqueLight;
+	unsigned char m_fluidLight;
+};
+
+static const MeshFace MESH_FACES[BLOCK_FACE_SIZE] =
+{
+	{ IntVec3(1, 0, 0), IntVec3( 0,  1, 0), IntVec3( 0, 0, 1), 0xCD, 0xCD }, // NORTH
+	{ IntVec3(0, 1, 0), IntVec3( 0, -1, 0), IntVec3( 0, 0, 1), 0xCD, 0xCD }, // SOUTH
+	{ IntVec3(1, 1, 0), IntVec3(-1,  0, 0), IntVec3( 0, 0, 1), 0xE6, 0xE6 }, // WEST
+	{ IntVec3(0, 0, 0), IntVec3( 1,  0, 0), IntVec3( 0, 0, 1), 0xE6, 0xE6 }, // EAST
+	{ IntVec3(0, 1, 1), IntVec3( 0, -1, 0), IntVec3( 1, 0, 0), 0xFF, 0xF9 }, // UP
+	{ IntVec3(1, 1, 0), IntVec3( 0, -1, 0), IntVec3(-1, 0, 0), 0xFF, 0xF9 }, // DOWN
+};
+
+constexpr int   MESH_MASK_SIZE = 16;
+constexpr float GREEDY_UV_TILE_SCALE = 32.0f; // must match World.hlsl and Fluid.hlsl
+
+static_assert(CHUNK_SIZE_XY == MESH_MASK_SIZE && CHUNK_SECTION_SIZE_Z == MESH_MASK_SIZE, "faces are merged in 16x16 slices of a section");
+
+struct MeshFaceKey
+{
+	const BlockMaterialDef* m_material = nullptr; // null where no face is drawn
+	unsigned char           m_iLight = 0;
+	unsigned char           m_oLight = 0;
+	bool                    m_mergeable = true;   // fluid surfaces touching air wave per vertex
+	bool                    m_upAir = false;
+
+	bool CanMerge(const MeshFaceKey& other) const
+	{
+		return m_material && m_mergeable && other.m_mergeable && m_material == other.m_material && m_iLight == other.m_iLight && m_oLight == other.m_oLight;
+	}
+};
+
+static inline int GetMaskStart(int u, int v)
+{
+	return (u < 0 || v < 0) ? MESH_MASK_SIZE - 1 : 0;
+}
+
+static void EmitQuad(VertexBufferBuilder& builder, const MeshFace& face, const Vec3& corner, int width, int height, const MeshFaceKey& key, const unsigned char lights[4], int atlasColumns, int atlasRows)
+{
+	const AABB2& uvs = key.m_material->m_uv;
+	bool tiled = width > 1 || height > 1;
+
+	// merged quads put the atlas cell in the integer part of the uv and the tile position in the fraction,
+	// alpha tells the shader how many columns the atlas has so it can wrap inside the cell
+	float cellU = roundf(fminf(uvs.m_mins.x, uvs.m_maxs.x) * (float)atlasColumns);
+	float cellV = roundf(fminf(uvs.m_mins.y, uvs.m_maxs.y) * (float)atlasRows);
+	unsigned char alpha = tiled ? (unsigned char)atlasColumns : 255;
+
+	for (int vert = 0; vert < 4; vert++)
+	{
+		int a = (vert == 1 || vert == 2) ? width : 0;
+		int b = (vert >= 2) ? height : 0;
+		Vec3 pos = corner;
+		pos.x += (float)(face.m_u.x * a + face.m_v.x * b);
+		pos.y += (float)(face.m_u.y * a + face.m_v.y * b);
+		pos.z += (float)(face.m_u.z * a + face.m_v.z * b);
+
+		float u = a ? uvs.m_maxs.x : uvs.m_mins.x;
+		float v = b ? uvs.m_maxs.y : uvs.m_mins.y;
+		if (tiled)
+		{
+			// counting the tile backwards mirrors each tile, not the whole quad
+			int tileU = uvs.m_mins.x <= uvs.m_maxs.x ? a : width - a;
+			int tileV = uvs.m_mins.y <= uvs.m_maxs.y ? b : height - b;
+			u = cellU + (float)tileU / GREEDY_UV_TILE_SCALE;
+			v = cellV + (float)tileV / GREEDY_UV_TILE_SCALE;
+		}
+
+		builder.begin()->pos(pos)->color(Rgba8(key.m_iLight, key.m_oLight, lights[vert], alpha))->tex(u, v)->end();
+	}
+}
+
+void ChunkMeshData::BuildPass(const ChunkMeshSnapshot& snapshot, bool fluid, VertexBufferBuilder& builder)
+{
+	Shader* shader = BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas()->m_shader;
+	builder.Start(shader->GetInputFormat(0), 65535);
+
+	WorldCoords origin = Chunk::GetOriginInWorld(snapshot.m_chunkCoords);
+	MeshFaceKey mask[MESH_MASK_SIZE * MESH_MASK_SIZE];
+
+	for (int section = 0; section < (int)CHUNK_SECTION_COUNT; section++)
+	{
+		const ChunkSection& counts = snapshot.m_sections[section];
+		if (!fluid && (counts.m_opaqueCount == 0 || snapshot.m_buried[section]))
+			continue; // no opaque block, or opaque and buried under other opaque sections on all sides
+		if (fluid && counts.m_nonAirCount == counts.m_opaqueCount)
+			continue; // every non-air block is opaque, nothing translucent to draw
+
+		int zBase = section * CHUNK_SECTION_SIZE_Z;
+		for (BlockFace face : BLOCK_NEIGHBORS)
+		{
+			const MeshFace& meshFace = MESH_FACES[face];
+			IntVec3 normal = Block::GetOffsetByFace(face);
+			normal = IntVec3(abs(normal.x), abs(normal.y), abs(normal.z));
+			LocalCoords start;
+			start.x = GetMaskStart(meshFace.m_u.x, meshFace.m_v.x);
+			start.y = GetMaskStart(meshFace.m_u.y, meshFace.m_v.y);
+			start.z = GetMaskStart(meshFace.m_u.z, meshFace.m_v.z) + zBase;
+
+			// walk the padded snapshot by stride, neighbors are a fixed offset even across chunk borders
+			int strideU = ChunkMeshSnapshot::GetPaddedOffset(meshFace.m_u);
+			int strideV = ChunkMeshSnapshot::GetPaddedOffset(meshFace.m_v);
+			int strideN = ChunkMeshSnapshot::GetPaddedOffset(normal);
+			int neighborOffset = ChunkMeshSnapshot::GetPaddedOffset(face);
+			int upOffset = ChunkMeshSnapshot::GetPaddedOffset(BLOCK_FACE_UP);
+			int startIndex = ChunkMeshSnapshot::GetPaddedIndex(start);
+
+			for (int slice = 0; slice < MESH_MASK_SIZE; slice++)
+			{
+				// mask i runs along the face's texture u, j along v
+				for (int j = 0; j < MESH_MASK_SIZE; j++)
+					for (int i = 0; i < MESH_MASK_SIZE; i++)
+					{
+						int index = startIndex + strideU * i + strideV * j + strideN * slice;
+
+						MeshFaceKey& key = mask[j * MESH_MASK_SIZE + i];
+						key = MeshFaceKey();
+
+						const Block& block = snapshot.GetBlock(index);
+						if (fluid ? (block.GetBlockId() == Blocks::BLOCK_AIR || block.IsOpaque()) : !block.GetBlockDef()->m_opaque)
+							continue;
+
+						const Block& neighborBlock = snapshot.GetBlock(index + neighborOffset);
+						if (neighborBlock.IsValid())
+						{
+							if (neighborBlock.GetBlockId() == block.GetBlockId())
+								continue; // cull same block face
+							if (neighborBlock.IsOpaque())
+								continue; // cull opaque neighbor face
+						}
+
+						const BlockMaterialDef* material = block.GetBlockDef()->GetBlockMaterial(face);
+						if (!material->m_visible)
+							continue;
+
+						key.m_material = material;
+						key.m_iLight = neighborBlock.GetIndoorLightInfluenceNormalized();
+						key.m_oLight = neighborBlock.GetOutdoorLightInfluenceNormalized();
+						if (fluid)
+						{
+							const Block& upBlock = snapshot.GetBlock(index + upOffset);
+							key.m_upAir = !upBlock.IsValid() || upBlock.GetBlockId() == Blocks::BLOCK_AIR;
+							key.m_mergeable = !key.m_upAir;
+						}
+					}
+
+				for (int j = 0; j < MESH_MASK_SIZE; j++)
+					for (int i = 0; i < MESH_MASK_SIZE; i++)
+					{
+						MeshFaceKey key = mask[j * MESH_MASK_SIZE + i];
+						if (!key.m_material)
+							continue;
+
+						// grow along u first, then add rows along v while the whole row matches
+						int width = 1;
+						int height = 1;
+						if (snapshot.m_greedy)
+						{
+							while (i + width < MESH_MASK_SIZE && key.CanMerge(mask[j * MESH_MASK_SIZE + i + width]))
+								width++;
+							for (; j + height < MESH_MASK_SIZE; height++)
+							{
+								int run = 0;
+								while (run < width && key.CanMerge(mask[(j + height) * MESH_MASK_SIZE + i + run]))
+									run++;
+								if (run < width)
+									break;
+							}
+						}
+						for (int row = j; row < j + height; row++)
+							for (int col = i; col < i + width; col++)
+								mask[row * MESH_MASK_SIZE + col].m_material = nullptr;
+
+						LocalCoords coords;
+						coords.x = start.x + meshFace.m_u.x * i + meshFace.m_v.x * j + normal.x * slice;
+						coords.y = start.y + meshFace.m_u.y * i + meshFace.m_v.y * j + normal.y * slice;
+						coords.z = start.z + meshFace.m_u.z * i + meshFace.m_v.z * j + normal.z * slice;
+						Vec3 corner;
+						corner.x = (float)(origin.x + coords.x + meshFace.m_origin.x);
+						corner.y = (float)(origin.y + coords.y + meshFace.m_origin.y);
+						corner.z = (float)(origin.z + coords.z + meshFace.m_origin.z);
+
+						// fluid faces under air brighten their top edge, the shader waves those vertices
+						unsigned char fLight = fluid ? meshFace.m_fluidLight : meshFace.m_opaqueLight;
+						unsigned char lights[4] = { fLight, fLight, fLight, fLight };
+						if (key.m_upAir)
+						{
+							if (face == BLOCK_FACE_UP)
+								lights[0] = lights[1] = lights[2] = lights[3] = 0xFF;
+							else if (face != BLOCK_FACE_DOWN)
+								lights[2] = lights[3] = 0xFF;
+						}
+
+						EmitQuad(builder, meshFace, corner, width, height, key, lights, snapshot.m_atlasColumns, snapshot.m_atlasRows);
+					}
+			}
+		}
+	}
+}
+
+ChunkMeshJob::ChunkMeshJob(ChunkProvider* provider, const Chunk& chunk, uint32_t version) : Job(JOB_TYPE_MESH_CHUNK)
+	, m_chunkProvider(provider)
+	, m_chunkCoords(chunk.m_chunkCoords)
+	, m_version(version)
+{
+	m_snapshot = new ChunkMeshSnapshot();
+	m_snapshot->Capture(chunk);
+	m_data = new ChunkMeshData();
+}
+
+ChunkMeshJob::~ChunkMeshJob()
+{
+	delete m_snapshot;
+	delete m_data;
+}
+
+void ChunkMeshJob::Execute()
+{
+	m_data->Build(*m_snapshot);
+	delete m_snapshot;
+	m_snapshot = nullptr;
+}
+
+void ChunkMeshJob::OnFinished()
+{
+	m_chunkProvider->m_meshJobsPending--;
+
+	// the chunk may have been unloaded, or rebuilt since this job was queued
+	Chunk* chunk = m_chunkProvider->FindLoadedChunk(m_chunkCoords);
+	if (chunk && chunk->m_meshVersion == m_version)
+		chunk->UploadMesh(*m_data);
+}
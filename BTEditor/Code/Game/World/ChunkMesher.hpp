@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+#include "Engine/Core/JobSystem.hpp"
+
+#include <cstdint>
+#include <vector>
+
+constexpr int JOB_TYPE_MESH_CHUNK = 991;
+
+constexpr int MESH_PADDED_SIZE_XY = CHUNK_SIZE_XY + 2;
+constexpr int MESH_PADDED_SIZE_Z  = CHUNK_SIZE_Z + 2;
+constexpr int MESH_PADDED_STRIDE_Y = MESH_PADDED_SIZE_XY;
+constexpr int MESH_PADDED_STRIDE_Z = MESH_PADDED_SIZE_XY * MESH_PADDED_SIZE_XY;
+constexpr int MESH_PADDED_BLOCKS = MESH_PADDED_STRIDE_Z * MESH_PADDED_SIZE_Z;
+
+class ChunkProvider;
+
+// copy of a chunk inside a one block border (neighbors, or invalid blocks above, below and past unloaded chunks),
+// so every face neighbor is a fixed offset away and meshing never branches on chunk edges
+struct ChunkMeshSnapshot
+{
+	ChunkCoords  m_chunkCoords;
+	Block        m_padded[MESH_PADDED_BLOCKS]; // whole block states: id, meta, light and flags in one word
+	ChunkSection m_sections[CHUNK_SECTION_COUNT];
+	bool         m_buried[CHUNK_SECTION_COUNT] = {};
+	bool         m_greedy = false;
+	int          m_atlasColumns = 1;
+	int          m_atlasRows = 1;
+
+	void Capture(const Chunk& chunk);
+	const Block& GetBlock(int paddedIndex) const { return m_padded[paddedIndex]; }
+
+	static int GetPaddedIndex(const LocalCoords& coords) { return (coords.z + 1) * MESH_PADDED_STRIDE_Z + (coords.y + 1) * MESH_PADDED_STRIDE_Y + coords.x + 1; }
+	static int GetPaddedOffset(const IntVec3& offset) { return offset.z * MESH_PADDED_STRIDE_Z + offset.y * MESH_PADDED_STRIDE_Y + offset.x; }
+	static int GetPaddedOffset(BlockFace face);
+};
+
+// vertices and indices of both passes, ready for upload on the main thread
+struct ChunkMeshData
+{
+	VertexBufferBuilder m_opaque;
+	VertexBufferBuilder m_fluid;
+	std::vector<int>    m_opaqueIndices;
+	std::vector<int>    m_fluidIndices;
+
+	void Build(const ChunkMeshSnapshot& snapshot);
+
+private:
+	void BuildPass(const ChunkMeshSnapshot& snapshot, bool fluid, VertexBufferBuilder& builder);
+	static void BuildQuadIndices(int vertexCount, std::vector<int>& indices);
+};
+
+class ChunkMeshJob : public Job
+{
+public:
+	ChunkMeshJob(ChunkProvider* provider, const Chunk& chunk, uint32_t version);
+	~ChunkMeshJob();
+
+private:
+	virtual void Execute() override;
+	virtual void OnFinished() override;
+
+private:
+	ChunkProvider* const m_chunkProvider;
+	ChunkCoords          m_chunkCoords;
+	uint32_t             m_version = 0;
+	ChunkMeshSnapshot*   m_snapshot = nullptr;
+	ChunkMeshData*       m_data = nullptr;
+};
+
@@ -0,0 +1,204 @@
+#include "Game/World/ChunkNav.hpp"
+
+#include "Game/World/Chunk.hpp"
+
+#include <atomic>
+
+static std::atomic<unsigned int> s_nextNavVersion = 1;
+
+void ChunkNav::Build(const Chunk& chunk)
+{
+	auto isSolid = [&chunk](int x, int y, int z)
+	{
+		return chunk.GetBlockAtIndex(Chunk::GetIndex(LocalCoords(x, y, z))).IsSolid();
+	};
+
+	m_spans.clear();
+	for (int y = 0; y < (int)CHUNK_SIZE_XY; y++)
+	{
+		for (int x = 0; x < (int)CHUNK_SIZE_XY; x++)
+		{
+			m_columnStart[x + y * CHUNK_SIZE_XY] = (unsigned short)m_spans.size();
+
+			int z = 1;
+			while (z < (int)CHUNK_SIZE_Z)
+			{
+				if (isSolid(x, y, z) || !isSolid(x, y, z - 1))
+				{
+					z++;
+					continue;
+				}
+
+				int top = z;
+				while (top < (int)CHUNK_SIZE_Z && !isSolid(x, y, top))
+					top++;
+
+				// open to the sky counts as unlimited clearance
+				int clearance = top == (int)CHUNK_SIZE_Z ? 0xFF : top - z;
+				if (clearance >= NAV_AGENT_HEIGHT)
+				{
+					NavSpan span;
+					span.m_floor = (unsigned char)z;
+					span.m_clearance = (unsigned char)clearance;
+					m_spans.push_back(span);
+				}
+				z = top + 1;
+			}
+		}
+	}
+	m_columnStart[CHUNK_SIZE_XY * CHUNK_SIZE_XY] = (unsigned short)m_spans.size();
+
+	// links inside the chunk, border links wait for the neighbor chunk
+	for (int y = 0; y < (int)CHUNK_SIZE_XY; y++)
+	{
+		for (int x = 0; x < (int)CHUNK_SIZE_XY; x++)
+		{
+			for (BlockFace face : CHUNK_NEIGHBORS)
+			{
+				IntVec2 offset = Block::GetOffset2ByFace(face);
+				int nx = x + offset.x;
+				int ny = y + offset.y;
+				if (nx < 0 || ny < 0 || nx >= (int)CHUNK_SIZE_XY || ny >= (int)CHUNK_SIZE_XY)
+					continue;
+				LinkColumn(x, y, *this, nx, ny, face);
+			}
+		}
+	}
+
+	m_built = true;
+	Touch();
+}
+
+void ChunkNav::LinkNeighbor(const ChunkNav& neighbor, BlockFace face)
+{
+	if (!m_built || !neighbor.m_built)
+		return;
+
+	for (int i = 0; i < (int)CHUNK_SIZE_XY; i++)
+	{
+		switch (face)
+		{
+		case BLOCK_FACE_NORTH: LinkColumn(CHUNK_MAX_X, i, neighbor, 0, i, face); break;
+		case BLOCK_FACE_SOUTH: LinkColumn(0, i, neighbor, CHUNK_MAX_X, i, face); break;
+		case BLOCK_FACE_WEST:  LinkColumn(i, CHUNK_MAX_Y, neighbor, i, 0, face); break;
+		case BLOCK_FACE_EAST:  LinkColumn(i, 0, neighbor, i, CHUNK_MAX_Y, face); break;
+		default: break;
+		}
+	}
+	Touch();
+}
+
+void ChunkNav::UnlinkNeighbor(BlockFace face)
+{
+	if (!m_built)
+		return;
+
+	for (int i = 0; i < (int)CHUNK_SIZE_XY; i++)
+	{
+		int x = face == BLOCK_FACE_NORTH ? CHUNK_MAX_X : face == BLOCK_FACE_SOUTH ? 0 : i;
+		int y = face == BLOCK_FACE_WEST ? CHUNK_MAX_Y : face == BLOCK_FACE_EAST ? 0 : i;
+		int column = x + y * CHUNK_SIZE_XY;
+		for (int s = m_columnStart[column]; s < m_columnStart[column + 1]; s++)
+			m_spans[s].m_links[face] = NAV_NO_LINK;
+	}
+	Touch();
+}
+
+bool ChunkNav::IsBuilt() const
+{
+	return m_built;
+}
+
+int ChunkNav::GetSpanCount(int x, int y) const
+{
+	if (!m_built)
+		return 0;
+
+	int column = x + y * CHUNK_SIZE_XY;
+	return m_columnStart[column + 1] - m_columnStart[column];
+}
+
+const NavSpan* ChunkNav::GetSpans(int x, int y) const
+{
+	if (!m_built)
+		return nullptr;
+
+	return m_spans.data() + m_columnStart[x + y * CHUNK_SIZE_XY];
+}
+
+int ChunkNav::FindSpan(int x, int y, int floor) const
+{
+	int count = GetSpanCount(x, y);
+	const NavSpan* spans = GetSpans(x, y);
+	for (int i = 0; i < count; i++)
+		if (spans[i].m_floor == floor)
+			return i;
+	return -1;
+}
+
+int ChunkNav::FindNearestSpan(int x, int y, int z) const
+{
+	int count = GetSpanCount(x, y);
+	const NavSpan* spans = GetSpans(x, y);
+	int nearest = -1;
+	int nearestDist = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int dist = spans[i].m_floor > z ? spans[i].m_floor - z : z - spans[i].m_floor;
+		if (nearest < 0 || dist < nearestDist)
+		{
+			nearest = i;
+			nearestDist = dist;
+		}
+	}
+	return nearest;
+}
+
+bool ChunkNav::CanStep(const NavSpan& from, const NavSpan& to)
+{
+	int step = (int)to.m_floor - (int)from.m_floor;
+	if (step > NAV_MAX_STEP || step < -NAV_MAX_STEP)
+		return false;
+
+	// the agent needs its full height above the higher floor on both sides
+	int floor = from.m_floor > to.m_floor ? from.m_floor : to.m_floor;
+	int fromTop = from.m_clearance == 0xFF ? 0xFFFF : from.m_floor + from.m_clearance;
+	int toTop = to.m_clearance == 0xFF ? 0xFFFF : to.m_floor + to.m_clearance;
+	return floor + NAV_AGENT_HEIGHT <= fromTop && floor + NAV_AGENT_HEIGHT <= toTop;
+}
+
+void ChunkNav::LinkColumn(int x, int y, const ChunkNav& other, int otherX, int otherY, BlockFace face)
+{
+	int column = x + y * CHUNK_SIZE_XY;
+	int otherColumn = otherX + otherY * CHUNK_SIZE_XY;
+	int otherStart = other.m_columnStart[otherColumn];
+	int otherCount = other.m_columnStart[otherColumn + 1] - otherStart;
+
+	for (int s = m_columnStart[column]; s < m_columnStart[column + 1]; s++)
+	{
+		NavSpan& span = m_spans[s];
+		span.m_links[face] = NAV_NO_LINK;
+
+		// prefer the flattest step
+		int best = 0xFF;
+		for (int o = 0; o < otherCount; o++)
+		{
+			const NavSpan& target = other.m_spans[otherStart + o];
+			if (!CanStep(span, target))
+				continue;
+
+			int step = target.m_floor > span.m_floor ? target.m_floor - span.m_floor : span.m_floor - target.m_floor;
+			if (step < best)
+			{
+				best = step;
+				span.m_links[face] = (unsigned char)o;
+			}
+		}
+	}
+}
+
+void ChunkNav::Touch()
+{
+	// built on populate workers, so the counter is shared between threads
+	m_version = s_nextNavVersion++;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Game/Framework/GameCommon.hpp"
+#include "Game/Block/Block.hpp"
+
+#include <vector>
+
+class Chunk;
+
+constexpr unsigned char NAV_NO_LINK      = 0xFF;
+constexpr int           NAV_AGENT_HEIGHT = 2; // passable blocks needed to stand in a span
+constexpr int           NAV_MAX_STEP     = 1; // blocks an agent can step up or down
+
+//------------------------------------------------------------------------------------------------
+struct NavSpan
+{
+	unsigned char m_floor = 0;                  // local z of the lowest passable block, standing on a solid block
+	unsigned char m_clearance = 0;              // passable blocks from the floor up
+	unsigned char m_links[4] = { NAV_NO_LINK, NAV_NO_LINK, NAV_NO_LINK, NAV_NO_LINK }; // span index in the neighbor column, by BlockFace
+};
+
+//------------------------------------------------------------------------------------------------
+// walkable spans of every block column in a chunk, packed column by column
+class ChunkNav
+{
+public:
+	void Build(const Chunk& chunk);
+	void LinkNeighbor(const ChunkNav& neighbor, BlockFace face);
+	void UnlinkNeighbor(BlockFace face);
+
+	bool           IsBuilt() const;
+	unsigned int   GetVersion() const { return m_version; }
+	int            GetSpanCount(int x, int y) const;
+	const NavSpan* GetSpans(int x, int y) const;
+	int            FindSpan(int x, int y, int floor) const;
+	int            FindNearestSpan(int x, int y, int z) const;
+
+	static bool    CanStep(const NavSpan& from, const NavSpan& to);
+
+private:
+	void LinkColumn(int x, int y, const ChunkNav& other, int otherX, int otherY, BlockFace face);
+	void Touch();
+
+private:
+	std::vector<NavSpan> m_spans;
+	unsigned short       m_columnStart[CHUNK_SIZE_XY * CHUNK_SIZE_XY + 1] = {};
+	bool                 m_built = false;
+	unsigned int         m_version = 0; // unique across all chunks, changes whenever a span or link does
+};
+
@@ -0,0 +1,195 @@
+#include "Game/World/ChunkPool.hpp"
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>			// only for allocating slabs in large pages
+#else
+#include <sys/mman.h>
+#endif
+
+constexpr size_t CHUNK_POOL_ARRAY_BYTES = sizeof(Block) * CHUNK_SIZE_BLOCKS;
+
+static void* AllocateSlabMemory(size_t size, bool tryLargePages, bool& largePages)
+{
+	largePages = false;
+
+#if defined(_WIN32)
+	// large pages need the lock memory privilege, without it the plain allocation below is used
+	SIZE_T largePageSize = GetLargePageMinimum();
+	if (tryLargePages && largePageSize > 0 && size % largePageSize == 0)
+	{
+		void* memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (memory)
+		{
+			largePages = true;
+			return memory;
+		}
+	}
+	return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return nullptr;
+#if defined(MADV_HUGEPAGE)
+	if (tryLargePages)
+		largePages = madvise(memory, size, MADV_HUGEPAGE) == 0;
+#endif
+	return memory;
+#endif
+}
+
+static void FreeSlabMemory(void* memory, size_t size)
+{
+#if defined(_WIN32)
+	(void)size;
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+ChunkPool& ChunkPool::GetInstance()
+{
+	static ChunkPool s_instance;
+	return s_instance;
+}
+
+ChunkPool::~ChunkPool()
+{
+	for (const Slab& slab : m_blockSlabs)
+		FreeSlabMemory(slab.m_memory, slab.m_size);
+	for (void* slab : m_chunkSlabs)
+		::operator delete(slab);
+}
+
+Chunk* ChunkPool::CreateChunk(World* world, const ChunkCoords& chunkCoords)
+{
+	void* slot = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_freeChunks.empty())
+			AllocateChunkSlab();
+		slot = m_freeChunks.back();
+		m_freeChunks.pop_back();
+	}
+
+	// the constructor takes its block array from the pool, so it runs outside the lock
+	return new (slot) Chunk(world, chunkCoords);
+}
+
+void ChunkPool::DestroyChunk(Chunk* chunk)
+{
+	if (!chunk)
+		return;
+
+	chunk->~Chunk();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeChunks.push_back(chunk);
+}
+
+Block* ChunkPool::AcquireBlocks(bool clear)
+{
+	Block* blocks = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_freeBlocks.empty())
+			AllocateBlockSlab();
+		blocks = m_freeBlocks.back();
+		m_freeBlocks.pop_back();
+		m_blockSlabs[FindBlockSlab(blocks)].m_freeArrays--;
+	}
+
+	if (clear)
+		std::fill(blocks, blocks + CHUNK_SIZE_BLOCKS, Block());
+	return blocks;
+}
+
+void ChunkPool::ReleaseBlocks(Block* blocks)
+{
+	if (!blocks)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeBlocks.push_back(blocks);
+
+	int slabIndex = FindBlockSlab(blocks);
+	if (++m_blockSlabs[slabIndex].m_freeArrays == CHUNK_POOL_SLAB_ARRAYS && (int)m_blockSlabs.size() > m_reservedBlockSlabs)
+		FreeBlockSlab(slabIndex);
+}
+
+void ChunkPool::Reserve(int chunks, int blockArrays)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reservedBlockSlabs = (blockArrays + CHUNK_POOL_SLAB_ARRAYS - 1) / CHUNK_POOL_SLAB_ARRAYS;
+	while ((int)m_blockSlabs.size() < m_reservedBlockSlabs)
+		AllocateBlockSlab();
+	while ((int)(m_chunkSlabs.size() * CHUNK_POOL_SLAB_CHUNKS) < chunks)
+		AllocateChunkSlab();
+}
+
+size_t ChunkPool::GetMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t size = m_chunkSlabs.size() * CHUNK_POOL_SLAB_CHUNKS * sizeof(Chunk);
+	for (const Slab& slab : m_blockSlabs)
+		size += slab.m_size;
+	return size;
+}
+
+void ChunkPool::AllocateBlockSlab()
+{
+	Slab slab;
+	slab.m_size = CHUNK_POOL_ARRAY_BYTES * CHUNK_POOL_SLAB_ARRAYS;
+	slab.m_memory = AllocateSlabMemory(slab.m_size, m_useLargePages, slab.m_largePages);
+	slab.m_freeArrays = CHUNK_POOL_SLAB_ARRAYS;
+	if (!slab.m_memory)
+		ERROR_AND_DIE("Out of memory for chunk block arrays");
+	m_blockSlabs.push_back(slab);
+
+	Block* blocks = (Block*)slab.m_memory;
+	std::uninitialized_fill_n(blocks, CHUNK_SIZE_BLOCKS * CHUNK_POOL_SLAB_ARRAYS, Block());
+	for (int index = CHUNK_POOL_SLAB_ARRAYS - 1; index >= 0; index--)
+		m_freeBlocks.push_back(blocks + index * CHUNK_SIZE_BLOCKS);
+}
+
+void ChunkPool::AllocateChunkSlab()
+{
+	unsigned char* slab = (unsigned char*)::operator new(sizeof(Chunk) * CHUNK_POOL_SLAB_CHUNKS);
+	m_chunkSlabs.push_back(slab);
+	for (int index = CHUNK_POOL_SLAB_CHUNKS - 1; index >= 0; index--)
+		m_freeChunks.push_back(slab + index * sizeof(Chunk));
+}
+
+int ChunkPool::FindBlockSlab(const Block* blocks) const
+{
+	int index = 0;
+	for (; index < (int)m_blockSlabs.size(); index++)
+	{
+		const Block* first = (const Block*)m_blockSlabs[index].m_memory;
+		if (blocks >= first && blocks < first + CHUNK_SIZE_BLOCKS * CHUNK_POOL_SLAB_ARRAYS)
+			break;
+	}
+
+	if (index == (int)m_blockSlabs.size())
+		ERROR_AND_DIE("Block array does not belong to the chunk pool");
+	return index;
+}
+
+void ChunkPool::FreeBlockSlab(int slabIndex)
+{
+	Slab slab = m_blockSlabs[slabIndex];
+	const Block* first = (const Block*)slab.m_memory;
+	const Block* last = first + CHUNK_SIZE_BLOCKS * CHUNK_POOL_SLAB_ARRAYS;
+	m_freeBlocks.erase(std::remove_if(m_freeBlocks.begin(), m_freeBlocks.end(), [&](const Block* blocks)
+		{
+			return blocks >= first && blocks < last;
+		}), m_freeBlocks.end());
+
+	FreeSlabMemory(slab.m_memory, slab.m_size);
+	m_blockSlabs.erase(m_blockSlabs.begin() + slabIndex);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+
+#include <mutex>
+#include <vector>
+
+constexpr int CHUNK_POOL_SLAB_ARRAYS = 16; // 2 MB of block arrays, one large page where the OS has them
+constexpr int CHUNK_POOL_SLAB_CHUNKS = 16;
+
+// fixed size storage for chunks and their block arrays, recycled through free lists across loads and unloads
+// block arrays are also taken by workers unpacking a chunk, so every call is serialized
+// block slabs beyond the reserve go back to the OS once all their arrays are free, packed chunks do not pin them
+class ChunkPool
+{
+public:
+	static ChunkPool& GetInstance();
+
+	ChunkPool(const ChunkPool&) = delete;
+	~ChunkPool();
+
+	Chunk* CreateChunk(World* world, const ChunkCoords& chunkCoords);
+	void   DestroyChunk(Chunk* chunk);
+	Block* AcquireBlocks(bool clear);
+	void   ReleaseBlocks(Block* blocks);
+
+	void   Reserve(int chunks, int blockArrays);
+	void   SetUseLargePages(bool useLargePages) { m_useLargePages = useLargePages; }
+	size_t GetMemoryUsage() const;
+
+private:
+	ChunkPool() = default;
+
+	void AllocateBlockSlab();
+	void AllocateChunkSlab();
+	int  FindBlockSlab(const Block* blocks) const;
+	void FreeBlockSlab(int slabIndex);
+
+private:
+	struct Slab
+	{
+		void*  m_memory = nullptr;
+		size_t m_size = 0;
+		bool   m_largePages = false;
+		int    m_freeArrays = 0;
+	};
+
+	mutable std::mutex  m_mutex;
+	std::vector<Slab>   m_blockSlabs;
+	std::vector<void*>  m_chunkSlabs;
+	std::vector<Block*> m_freeBlocks;
+	std::vector<void*>  m_freeChunks;
+	int                 m_reservedBlockSlabs = 0;
+	bool                m_useLargePages = true;
+};
+
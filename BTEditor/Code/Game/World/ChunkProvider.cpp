@@ -1,4 +1,6 @@
 #include "Game/World/ChunkProvider.hpp"
+#include "Game/World/ChunkMesher.hpp"
+#include "Game/World/ChunkPool.hpp"
 
 #include "Engine/Core/ByteBuffer.hpp"
 #include "Engine/Core/EngineCommon.hpp"
@@ -9,18 +11,12 @@
 #include "Game/World/World.hpp"
 #include "Game/Block/BlockDef.hpp"
 #include "Game/World/WorldGenerator.hpp"
+#include "Engine/Math/MathUtils.hpp"
 #include "Engine/Math/RandomNumberGenerator.hpp"
 
+#include <algorithm>
 #include <filesystem>
 
-int g_nbrReqCounter = 0;
-int g_dirtyCounter = 0;
-int g_acceptedCounter = 0;
-int g_rejectedCounter = 0;
-int g_changedCounter = 0;
-int g_notchangedCounter = 0;
-int g_newReqCounter = 0;
-
 extern RandomNumberGenerator rng;
 
 ChunkProvider::ChunkProvider(World* world, const char* folderPath, WorldGenerator* generator)
@@ -31,14 +27,44 @@ ChunkProvider::ChunkProvider(World* world, const char* folderPath, WorldGenerato
 	std::filesystem::create_directories(std::filesystem::path(folderPath));
 
 	m_chunkActivationRange = g_gameConfigBlackboard.GetValue("chunkActivationRange", m_chunkActivationRange);
+	m_activationFacingWeight = g_gameConfigBlackboard.GetValue("chunkActivationFacingWeight", m_activationFacingWeight);
+	m_chunkIOTicketsPerFrame = g_gameConfigBlackboard.GetValue("chunkIOTicketsPerFrame", m_chunkIOTicketsPerFrame);
+	m_chunkIOMaxPending = g_gameConfigBlackboard.GetValue("chunkIOMaxPending", m_chunkIOMaxPending);
+	m_chunkInstallsPerFrame = g_gameConfigBlackboard.GetValue("chunkInstallsPerFrame", m_chunkInstallsPerFrame);
+	m_chunkMeshJobsPerFrame = g_gameConfigBlackboard.GetValue("chunkMeshJobsPerFrame", m_chunkMeshJobsPerFrame);
+	m_greedyMeshing = g_gameConfigBlackboard.GetValue("chunkGreedyMeshing", m_greedyMeshing);
+	m_chunkPackRange = g_gameConfigBlackboard.GetValue("chunkPackRange", m_chunkPackRange);
+	m_randomTickRadius = g_gameConfigBlackboard.GetValue("randomTickRadius", m_randomTickRadius);
+	m_randomTicksPerSection = g_gameConfigBlackboard.GetValue("randomTicksPerSection", m_randomTicksPerSection);
+	m_chunkPackIdleFrames = g_gameConfigBlackboard.GetValue("chunkPackIdleFrames", m_chunkPackIdleFrames);
+	m_chunkPackPerFrame = g_gameConfigBlackboard.GetValue("chunkPackPerFrame", m_chunkPackPerFrame);
 	m_worldSeed = (unsigned int)g_gameConfigBlackboard.GetValue("worldSeed", (int)m_worldSeed);
 	m_generator->m_seed = m_worldSeed;
 
+	ConvertLegacyChunkFiles();
+	BuildActivationOffsets();
+
+	// headers for everything inside the activation radius of one hotspot, block arrays only for the chunks that
+	// stay unpacked around it, both plus the loads in flight
+	ChunkPool& pool = ChunkPool::GetInstance();
+	pool.SetUseLargePages(g_gameConfigBlackboard.GetValue("chunkPoolLargePages", true));
+	if (g_gameConfigBlackboard.GetValue("chunkPoolPrewarm", true))
+	{
+		int packChunksRadius = m_chunkPackRange / CHUNK_SIZE_XY;
+		int blockArrays = m_chunkIOMaxPending;
+		for (int y = -packChunksRadius; y <= packChunksRadius; y++)
+			for (int x = -packChunksRadius; x <= packChunksRadius; x++)
+				if (x * x + y * y <= packChunksRadius * packChunksRadius)
+					blockArrays++;
+		pool.Reserve((int)m_activationOffsets.size() + m_chunkIOMaxPending, blockArrays);
+	}
+
 	m_rndTickWatch.Start(1.0 / 20.0);
 }
 
 ChunkProvider::~ChunkProvider()
 {
+	CloseAllRegions();
 	delete m_generator;
 }
 
@@ -49,7 +75,10 @@ void ChunkProvider::Update()
 	for (auto& chunkEntry : GetLoadedChunks())
 		chunkEntry.second->Update();
 
-	// UpdateRandomTick();
+	PackIdleChunks();
+
+	if (m_randomTicksPerSection > 0)
+		UpdateRandomTick();
 
 	if (g_theInput->WasKeyJustPressed(KEYCODE_F8))
 	{
@@ -59,19 +88,14 @@ void ChunkProvider::Update()
 	EndFrame();
 }
 
-std::map<ChunkCoords, Chunk*>& ChunkProvider::GetLoadedChunks()
-{
-	return m_chunksLoaded;
-}
-
-const std::map<ChunkCoords, Chunk*>& ChunkProvider::GetLoadedChunks() const
+const ChunkMap& ChunkProvider::GetLoadedChunks() const
 {
 	return m_chunksLoaded;
 }
 
 bool ChunkProvider::LoadChunkWithTicket(const ChunkCoords& coords)
 {
-	if (m_chunkIOTicket <= 0)
+	if (m_chunkIOTicket <= 0 || (int)m_chunksGenerating.size() >= m_chunkIOMaxPending)
 		return false;
 	if (LoadChunk(coords) == ChunkLoadStatus::LOADED)
 		GetChunkIOTicket();
@@ -81,37 +105,52 @@ bool ChunkProvider::LoadChunkWithTicket(const ChunkCoords& coords)
 void ChunkProvider::PopulateChunk(Chunk* chunk)
 {
 	m_generator->GenerateChunk(chunk);
+	chunk->RecountSections();
 	chunk->m_meshDirty = true;
 	chunk->m_blocksDirty = true;
 }
 
 Chunk* ChunkProvider::FindLoadedChunk(const ChunkCoords& coords) const
 {
-	auto ite = m_chunksLoaded.find(coords);
-	if (ite != m_chunksLoaded.end())
-		return ite->second;
-	return nullptr;
+	return m_chunksLoaded.Find(coords);
 }
 
-std::string ChunkProvider::GetFileName(const ChunkCoords& coords) const
+std::string ChunkProvider::GetRegionFileName(const IntVec2& regionCoords) const
 {
-	return Stringf("%s/Chunk(%d,%d).chunk", m_path.c_str(), coords.x, coords.y);
+	return Stringf("%s/Region(%d,%d).region", m_path.c_str(), regionCoords.x, regionCoords.y);
 }
 
 void ChunkProvider::UnloadAllChunks()
 {
+	// mesh results are dropped for unloaded chunks, but the jobs must not outlive the provider
+	while (m_meshJobsPending > 0)
+	{
+		g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_MESH_CHUNK);
+		std::this_thread::yield();
+	}
+
+	// a load that misses the disk queues its generation when it finishes, wait for both
 	while (!m_chunksGenerating.empty())
 	{
+		g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_LOAD_CHUNK);
 		g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_GEN_CHUNK);
 		std::this_thread::sleep_for(std::chrono::milliseconds(50));
 	}
 
+	m_lightEngine.Clear();
 	for (auto& entry : m_chunksLoaded)
+		QueueChunkSave(entry.second);
+	m_chunksLoaded.Clear();
+
+	while (!m_chunksSaving.empty())
 	{
-		SaveChunkToDisk(entry.second);
-		delete entry.second;
+		g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_SAVE_CHUNK);
+		std::this_thread::yield();
 	}
-	m_chunksLoaded.clear();
+	CloseAllRegions();
+
+	m_activationDirty = true;
+	m_deactivationDirty = true;
 }
 
 const Block& ChunkProvider::GetBlock(const WorldCoords& coords) const
@@ -119,13 +158,13 @@ const Block& ChunkProvider::GetBlock(const WorldCoords& coords) const
 	if (coords.z < 0 || coords.z >= CHUNK_SIZE_Z)
 		return Block::INVALID;
 
-	auto ite = m_chunksLoaded.find(Chunk::GetChunkCoords(coords));
-	if (ite == m_chunksLoaded.end())
+	Chunk* chunk = m_chunksLoaded.Find(Chunk::GetChunkCoords(coords));
+	if (!chunk)
 	{
 		return Block::INVALID;
 	}
 
-	return ite->second->GetBlock(Chunk::GetLocalCoords(coords));
+	return chunk->GetBlock(Chunk::GetLocalCoords(coords));
 }
 
 BlockId ChunkProvider::GetBlockId(const WorldCoords& coords) const
@@ -133,13 +172,13 @@ BlockId ChunkProvider::GetBlockId(const WorldCoords& coords) const
 	if (coords.z < 0 || coords.z >= CHUNK_SIZE_Z)
 		return Blocks::BLOCK_AIR;
 
-	auto ite = m_chunksLoaded.find(Chunk::GetChunkCoords(coords));
-	if (ite == m_chunksLoaded.end())
+	Chunk* chunk = m_chunksLoaded.Find(Chunk::GetChunkCoords(coords));
+	if (!chunk)
 	{
 		return Blocks::BLOCK_AIR;
 	}
 
-	return ite->second->GetBlockId(Chunk::GetLocalCoords(coords));
+	return chunk->GetBlockId(Chunk::GetLocalCoords(coords));
 }
 
 void ChunkProvider::SetBlockId(const WorldCoords& coords, BlockId block)
@@ -150,167 +189,53 @@ void ChunkProvider::SetBlockId(const WorldCoords& coords, BlockId block)
 		return;
 	}
 
-	auto ite = m_chunksLoaded.find(Chunk::GetChunkCoords(coords));
-	if (ite == m_chunksLoaded.end())
+	Chunk* chunk = m_chunksLoaded.Find(Chunk::GetChunkCoords(coords));
+	if (!chunk)
 	{
 		ERROR_RECOVERABLE("Chunk not loaded");
 		return;
 	}
 
-	ite->second->SetBlockId(Chunk::GetLocalCoords(coords), block);
+	chunk->SetBlockId(Chunk::GetLocalCoords(coords), block);
 }
 
-#include "Engine/Renderer/DebugRender.hpp"
-
 void ChunkProvider::ProcessDirtyLighting()
 {
-	g_nbrReqCounter = 0;
-	g_dirtyCounter = 0;
-	g_acceptedCounter = 0;
-	g_rejectedCounter = 0;
-	g_changedCounter = 0;
-	g_notchangedCounter = 0;
-	g_newReqCounter = 0;
-
+	// step mode runs one wave per key press
 	if (WORLD_DEBUG_STEP_LIGHTING)
-		if (!g_theInput->WasKeyJustPressed(KEYCODE_G))
-			return;
-
-	if (WORLD_DEBUG_STEP_LIGHTING)
-		m_dirtyLighting.swap(m_debugLighting);
-	size_t initial = m_dirtyLighting.size();
-	while (m_dirtyLighting.size())
 	{
-		g_dirtyCounter++;
-		ProcessNextDirtyLightBlock();
-	}
-
-	if (initial == 0)
+		if (g_theInput->WasKeyJustPressed(KEYCODE_G) && m_lightEngine.HasWork())
+			m_lightEngine.RunWave();
 		return;
-
-// 	const char* info = "LightInfo: Init=%d, Dirty=%d, New=%d, Acc=%d, Rej=%d, Chg=%d, NoChg=%d, Nbr=%d";
-// 	std::string msg = Stringf(info, initial, g_dirtyCounter, g_newReqCounter, g_acceptedCounter, g_rejectedCounter, g_changedCounter, g_notchangedCounter, g_nbrReqCounter);
-// 	DebugAddMessage(msg, 10.f, Rgba8::WHITE, Rgba8::WHITE);
-}
-
-void ChunkProvider::ProcessNextDirtyLightBlock()
-{
-	BlockIterator ite = m_dirtyLighting.front();
-	m_dirtyLighting.pop_front();
-	Block* block = ite.GetBlock();
-
-	block->SetLightDirty(false);
-
-	if (g_theInput->IsKeyDown(KEYCODE_H))
-	{
-		IntVec3 worldCoords = ite.GetWorldCoords();
-		Vec3 world = Vec3((float)worldCoords.x + 0.5f, (float)worldCoords.y + 0.5f, (float)worldCoords.z + 0.5f);
-		DebugAddWorldPoint(world, 0.2f, 5.0f, Rgba8::RED, Rgba8::WHITE, DebugRenderMode::XRAY);
 	}
 
-	LightLevel iLightPrev = block->GetIndoorLightInfluence();
-	LightLevel oLightPrev = block->GetOutdoorLightInfluence();
-
-	LightLevel iLight = block->GetGlowLight();
-	LightLevel oLight = block->GetSkyLight();
-
-	BlockIterator iteNbrs[BlockFace::BLOCK_FACE_SIZE] = {};
-	Block*        nbrs[BlockFace::BLOCK_FACE_SIZE]    = {};
-
-	for (BlockFace face : BLOCK_NEIGHBORS)
-	{
-		iteNbrs[face] = ite.GetBlockNeighbor(face);
-		g_nbrReqCounter++;
-		nbrs[face] = iteNbrs[face].GetBlock();
-	}
-
-	if (!block->IsOpaque())
-	{
-		// transparent (air)
-		for (BlockFace face : BLOCK_NEIGHBORS)
-		{
-			Block* nbr = nbrs[face];
-			if (nbr->IsValid())
-			{
-				LightLevel iLightNbr = nbr->GetIndoorLightInfluence();
-				LightLevel oLightNbr = nbr->GetOutdoorLightInfluence();
-				if (iLightNbr > 0)
-					iLightNbr--;
-				if (oLightNbr > 0)
-					oLightNbr--;
-				iLight = Max(iLight, iLightNbr);
-				oLight = Max(oLight, oLightNbr);
-			}
-		}
-	}
-
-	if (iLight != iLightPrev || oLight != oLightPrev)
-	{
-		g_changedCounter++;
-
-		block->SetIndoorLightInfluence(iLight);
-		block->SetOutdoorLightInfluence(oLight);
-		ite.GetChunk()->m_meshDirty = true;
-		for (BlockFace face : BLOCK_NEIGHBORS)
-		{
-			const BlockIterator& iteNbr = iteNbrs[face];
-			Block* nbr = nbrs[face];
-			if (nbr->IsValid())
-			{
-				if (nbr->IsOpaque()) // a face of neighbor's lighting has changed
-				{
-					iteNbr.GetChunk()->m_meshDirty = true;
-				}
-				else // a block of neighbor needs to update light
-				{
-					g_newReqCounter++;
-					MarkLightingDirty(iteNbr);
-				}
-			}
-		}
-	}
-	else
-	{
-		g_notchangedCounter++;
-	}
+	m_lightEngine.Update();
 }
 
 void ChunkProvider::MarkLightingDirty(const BlockIterator& blockIte)
 {
-	Block* blk = blockIte.GetBlock();
-	if (!blk->IsValid() || blk->IsLightDirty())
-	{
-		g_rejectedCounter++;
+	if (!blockIte.IsValid())
 		return;
-	}
-	g_acceptedCounter++;
-	blk->SetLightDirty(true);
-	(WORLD_DEBUG_STEP_LIGHTING ? m_debugLighting : m_dirtyLighting).push_back(blockIte);
+	m_lightEngine.MarkDirty(blockIte.GetChunk(), Chunk::GetIndex(blockIte.GetLocalCoords()));
 }
 
 void ChunkProvider::MarkLightingDirty(const WorldCoords& worldCoords)
 {
+	if (worldCoords.z < 0 || worldCoords.z >= CHUNK_SIZE_Z)
+		return;
 	MarkLightingDirty(BlockIterator(this, worldCoords));
 }
 
+void ChunkProvider::MarkBorderLightingDirty(Chunk* chunk, BlockFace face)
+{
+	m_lightEngine.MarkBorderDirty(chunk, face);
+}
+
 void ChunkProvider::UndirtyAllBlocksInChunk(const ChunkCoords& chunkCoords)
 {
 	Chunk* chunk = FindLoadedChunk(chunkCoords);
-	if (!chunk)
-		return;
-
-	auto ite = m_dirtyLighting.begin();
-	while (ite != m_dirtyLighting.end())
-	{
-		auto& blockIte = *ite;
-		if (blockIte.GetChunk() == chunk)
-		{
-			blockIte.GetBlock()->SetLightDirty(false);
-			ite = m_dirtyLighting.erase(ite);
-			continue;
-		}
-		ite++;
-	}
+	if (chunk)
+		m_lightEngine.RemoveChunk(chunk);
 }
 
 bool ChunkProvider::GetChunkIOTicket()
@@ -333,26 +258,47 @@ bool ChunkProvider::GetRebuildMeshTicket()
 	return false;
 }
 
+void ChunkProvider::QueueChunkMesh(Chunk* chunk)
+{
+	m_meshJobsPending++;
+	g_theJobSystem->QueueJob(new ChunkMeshJob(this, *chunk, chunk->m_meshVersion));
+}
+
 void ChunkProvider::SetHotspotSize(int size)
 {
 	m_hotspots.resize(size);
+	m_hotspotFacings.resize(size, -1);
+	m_activationDirty = true;
+	m_deactivationDirty = true;
 }
 
-void ChunkProvider::SetHotspot(int index, const Vec3& worldPos)
+void ChunkProvider::SetHotspot(int index, const Vec3& worldPos, const Vec3& forward)
 {
 	ChunkCoords newCoords = Chunk::GetChunkCoords(worldPos);
 	if (m_hotspots[index] != newCoords) 
 	{
 		m_hotspots[index] = newCoords;
-		if (m_chunksLoaded.find(newCoords) == m_chunksLoaded.end())
+		m_activationDirty = true;
+		m_deactivationDirty = true;
+		if (!m_chunksLoaded.Find(newCoords))
 			LoadChunk(newCoords); // make sure chunk is loaded otherwise player will fall into ground
 	}
+
+	// the load order only changes when the view turns into another eighth
+	int facing = -1;
+	if (forward.x != 0.0f || forward.y != 0.0f)
+		facing = (int)floorf(Atan2Degrees(forward.y, forward.x) / 45.0f + 8.5f) & 7;
+	if (m_hotspotFacings[index] != facing)
+	{
+		m_hotspotFacings[index] = facing;
+		m_activationDirty = true;
+	}
 }
 
 void ChunkProvider::BeginFrame()
 {
-	m_rebuildMeshTicket = 2;
-	m_chunkIOTicket = 2;
+	m_rebuildMeshTicket = m_chunkMeshJobsPerFrame;
+	m_chunkIOTicket = m_chunkIOTicketsPerFrame;
 
 	DoChunkActivation();
 	DoChunkDeactivation();
@@ -366,151 +312,231 @@ void ChunkProvider::UpdateRandomTick()
 		for (int i = 0; i < 1024; i++)
 			rndSource[i] = rng.RollRandomFloatZeroToOne();
 
-		int rndTickChunksRadius = 8;
-
+		// activation offsets are sorted by distance, the tick radius is a prefix of them
 		for (auto& hotspot : m_hotspots)
 		{
-			Chunk* origin = FindLoadedChunk(hotspot);
-			if (origin)
-				origin->UpdateRandomTick(1024, rndSource, rng.RollRandomIntInRange(0, 1023));
-
-			for (int size = 1; size < rndTickChunksRadius; size++)
+			for (const IntVec2& offset : m_activationOffsets)
 			{
-				ChunkCoords coords = hotspot + IntVec2(size, size);
-				for (BlockFace face : { BLOCK_FACE_EAST, BLOCK_FACE_SOUTH, BLOCK_FACE_WEST, BLOCK_FACE_NORTH })
-				{
-					for (int i = 0; i < size * 2; i++)
-					{
-						if ((coords - hotspot).GetLengthSquared() < rndTickChunksRadius * rndTickChunksRadius)
-						{
-							Chunk* chunk = FindLoadedChunk(coords);
-							if (chunk)
-								chunk->UpdateRandomTick(1024, rndSource, rng.RollRandomIntInRange(0, 1023));
-						}
-						coords += Block::GetOffset2ByFace(face);
-					}
-				}
+				if (offset.GetLengthSquared() >= m_randomTickRadius * m_randomTickRadius)
+					break;
+
+				Chunk* chunk = FindLoadedChunk(hotspot + offset);
+				if (chunk)
+					chunk->UpdateRandomTick(m_randomTicksPerSection, 1024, rndSource, rng.RollRandomIntInRange(0, 1023));
 			}
 		}
 	}
 }
 
-void ChunkProvider::DoChunkDeactivation()
+void ChunkProvider::PackIdleChunks()
 {
-	int chunkDeactivationRange = m_chunkActivationRange + CHUNK_SIZE_XY + CHUNK_SIZE_XY;
-	int unloadChunksRadius = 1 + chunkDeactivationRange / CHUNK_SIZE_XY;
-
-	std::vector<ChunkCoords> unloadingChunks;
+	// chunks around the hotspots are touched by physics every frame, packing them would only churn
+	int packChunksRadius = m_chunkPackRange / CHUNK_SIZE_XY;
+	int packed = 0;
 	for (const auto& entry : m_chunksLoaded)
 	{
-		bool unload = true;
+		if (packed >= m_chunkPackPerFrame)
+			return;
+
+		Chunk* chunk = entry.second;
+		if (!chunk->CanPack(m_chunkPackIdleFrames))
+			continue;
+
+		bool nearHotspot = false;
 		for (const auto& hotspot : m_hotspots)
 		{
-			if ((entry.first - hotspot).GetLengthSquared() < unloadChunksRadius * unloadChunksRadius)
+			if ((entry.first - hotspot).GetLengthSquared() <= packChunksRadius * packChunksRadius)
 			{
-				unload = false;
+				nearHotspot = true;
 				break;
 			}
 		}
-		if (unload)
-			unloadingChunks.push_back(entry.first);
+		if (nearHotspot)
+			continue;
+
+		chunk->Pack();
+		packed++;
 	}
+}
+
+bool ChunkProvider::IsNearHotspot(const ChunkCoords& coords, int radius) const
+{
+	for (const auto& hotspot : m_hotspots)
+		if ((coords - hotspot).GetLengthSquared() < radius * radius)
+			return true;
+	return false;
+}
+
+void ChunkProvider::BuildActivationOffsets()
+{
+	int loadChunksRadius = 1 + m_chunkActivationRange / CHUNK_SIZE_XY;
+
+	m_activationOffsets.clear();
+	for (int y = -loadChunksRadius; y <= loadChunksRadius; y++)
+		for (int x = -loadChunksRadius; x <= loadChunksRadius; x++)
+			if (IntVec2(x, y).GetLengthSquared() < loadChunksRadius * loadChunksRadius)
+				m_activationOffsets.push_back(IntVec2(x, y));
+
+	std::stable_sort(m_activationOffsets.begin(), m_activationOffsets.end(), [](const IntVec2& a, const IntVec2& b)
+		{
+			return a.GetLengthSquared() < b.GetLengthSquared();
+		});
+}
+
+void ChunkProvider::RebuildActivationQueue()
+{
+	int loadChunksRadius = 1 + m_chunkActivationRange / CHUNK_SIZE_XY;
 
-	ChunkCoords coordsMax;
-	int lenSqMax = -1;
-	for (const auto& coords : unloadingChunks)
+	m_activationQueue.clear();
+	for (size_t index = 0; index < m_hotspots.size(); index++)
 	{
-		int lenSqTemp = 0;
-		for (const auto& hotspot : m_hotspots)
+		const ChunkCoords& hotspot = m_hotspots[index];
+		int facing = m_hotspotFacings[index];
+		Vec2 forward = facing < 0 ? Vec2() : Vec2(CosDegrees((float)facing * 45.0f), SinDegrees((float)facing * 45.0f));
+
+		// chunks ahead of the view count as closer, up to m_activationFacingWeight of their distance
+		for (const IntVec2& offset : m_activationOffsets)
 		{
-			lenSqTemp += (coords - hotspot).GetLengthSquared();
+			ChunkCoords coords = hotspot + offset;
+			if (m_chunksLoaded.Find(coords) || m_chunksGenerating.Find(coords))
+				continue;
+
+			float distance = sqrtf((float)offset.GetLengthSquared());
+			float alignment = distance > 0.0f ? ((float)offset.x * forward.x + (float)offset.y * forward.y) / distance : 0.0f;
+			m_activationQueue.push_back({ coords, distance * (1.0f - m_activationFacingWeight * alignment) });
 		}
-		if (lenSqTemp > lenSqMax)
+	}
+
+	std::sort(m_activationQueue.begin(), m_activationQueue.end(), [](const ChunkActivation& a, const ChunkActivation& b)
 		{
-			lenSqMax = lenSqTemp;
-			coordsMax = coords;
-		}
+			return a.m_priority > b.m_priority;
+		});
+
+	// queued loads that fell out of range are dropped before or right after they run
+	for (const auto& entry : m_chunksGenerating)
+		if (!IsNearHotspot(entry.first, loadChunksRadius))
+			entry.second->m_cancelled = true;
+}
+
+void ChunkProvider::RebuildDeactivationQueue()
+{
+	int chunkDeactivationRange = m_chunkActivationRange + CHUNK_SIZE_XY + CHUNK_SIZE_XY;
+	int unloadChunksRadius = 1 + chunkDeactivationRange / CHUNK_SIZE_XY;
+
+	m_deactivationQueue.clear();
+	for (const auto& entry : m_chunksLoaded)
+		if (!IsNearHotspot(entry.first, unloadChunksRadius))
+			m_deactivationQueue.push_back(entry.first);
+
+	auto getDistance = [this](const ChunkCoords& coords)
+		{
+			int lenSq = 0;
+			for (const auto& hotspot : m_hotspots)
+				lenSq += (coords - hotspot).GetLengthSquared();
+			return lenSq;
+		};
+	std::sort(m_deactivationQueue.begin(), m_deactivationQueue.end(), [&](const ChunkCoords& a, const ChunkCoords& b)
+		{
+			return getDistance(a) < getDistance(b);
+		});
+}
+
+void ChunkProvider::DoChunkDeactivation()
+{
+	if (m_deactivationDirty)
+	{
+		m_deactivationDirty = false;
+		RebuildDeactivationQueue();
 	}
 
-	if (lenSqMax >= 0 && GetChunkIOTicket())
-		UnloadChunk(coordsMax);
+	if (!m_deactivationQueue.empty() && GetChunkIOTicket())
+	{
+		UnloadChunk(m_deactivationQueue.back());
+		m_deactivationQueue.pop_back();
+	}
 }
 
 void ChunkProvider::DoChunkActivation()
 {
-	int loadChunksRadius = 1 + m_chunkActivationRange / CHUNK_SIZE_XY;
-	int maxChunks = (2 * loadChunksRadius) * (2 * loadChunksRadius);
+	if (m_activationDirty)
+	{
+		m_activationDirty = false;
+		RebuildActivationQueue();
+	}
 
-	if (m_chunksLoaded.size() < maxChunks)
+	while (!m_activationQueue.empty())
 	{
-		for (auto& hotspot : m_hotspots)
-		{
-			if (!LoadChunkWithTicket(hotspot))
-				return;
-			for (int size = 1; size < loadChunksRadius; size++)
-			{
-				ChunkCoords coords = hotspot + IntVec2(size, size);
-				for (BlockFace face : { BLOCK_FACE_EAST, BLOCK_FACE_SOUTH, BLOCK_FACE_WEST, BLOCK_FACE_NORTH })
-				{
-					for (int i = 0; i < size * 2; i++)
-					{
-						if ((coords - hotspot).GetLengthSquared() < loadChunksRadius * loadChunksRadius)
-						{
-							if (!LoadChunkWithTicket(coords))
-								return;
-						}
-						coords += Block::GetOffset2ByFace(face);
-					}
-				}
-			}
-		}
+		if (!LoadChunkWithTicket(m_activationQueue.back().m_coords))
+			return;
+		m_activationQueue.pop_back();
 	}
 }
 
+void ChunkProvider::DiscardCancelledChunk(Chunk* chunk)
+{
+	m_chunksGenerating.Erase(chunk->m_chunkCoords);
+	ChunkPool::GetInstance().DestroyChunk(chunk);
+
+	// a hotspot may have come back for it after it was skipped
+	m_activationDirty = true;
+}
+
 void ChunkProvider::EndFrame()
 {
 	ProcessDirtyLighting();
 
-	g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_GEN_CHUNK, 2);
+	g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_LOAD_CHUNK, m_chunkInstallsPerFrame);
+	g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_GEN_CHUNK, m_chunkInstallsPerFrame);
+	g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_SAVE_CHUNK);
+	g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_MESH_CHUNK);
 }
 
 ChunkLoadStatus ChunkProvider::LoadChunk(const ChunkCoords& coords)
 {
-	auto ite = m_chunksLoaded.find(coords);
-	if (ite != m_chunksLoaded.end())
+	if (m_chunksLoaded.Find(coords))
 		return ChunkLoadStatus::PRESENT;
-	auto iteGen = m_chunksGenerating.find(coords);
-	if (iteGen != m_chunksGenerating.end())
+	if (Chunk* generating = m_chunksGenerating.Find(coords))
+	{
+		generating->m_cancelled = false;
 		return ChunkLoadStatus::QUEUED;
+	}
+	if (m_chunksSaving.Find(coords))
+		return ChunkLoadStatus::QUEUED; // the region has stale data until the save lands
 
-	Chunk* chunk = new Chunk(m_world, coords);
-	if (!LoadChunkFromDisk(chunk))
-	{
-		chunk->m_state = ChunkState::QUEUED;
-		m_chunksGenerating[coords] = chunk; // insert into m_chunksLoaded
+	Chunk* chunk = ChunkPool::GetInstance().CreateChunk(m_world, coords);
+	chunk->m_state = ChunkState::QUEUED;
+	m_chunksGenerating.Insert(coords, chunk); // insert into m_chunksLoaded
+	if (m_disableLoadFromDisk)
 		g_theJobSystem->QueueJob(new ChunkPopulateJob(this, chunk));
-		return ChunkLoadStatus::LOADED;
-	}
 	else
-	{
-		FinishUpChunkLoading(chunk);
-	}
+		g_theJobSystem->QueueJob(new ChunkLoadJob(this, chunk));
 	return ChunkLoadStatus::LOADED;
 }
 
 void ChunkProvider::UnloadChunk(const ChunkCoords& coords)
 {
-	auto ite = m_chunksLoaded.find(coords);
-	if (ite == m_chunksLoaded.end())
+	Chunk* chunk = m_chunksLoaded.Find(coords);
+	if (!chunk)
 		return;
 
-	Chunk* chunk = ite->second;
 	for (BlockFace face : CHUNK_NEIGHBORS)
 		if (chunk->m_neighbors[(int)face])
-			chunk->m_neighbors[(int)face]->OnNeighborUnload(*ite->second);
-	m_chunksLoaded.erase(ite);
-	SaveChunkToDisk(chunk);
-	delete chunk;
+			chunk->m_neighbors[(int)face]->OnNeighborUnload(*chunk);
+	m_lightEngine.RemoveChunk(chunk);
+	m_chunksLoaded.Erase(coords);
+	QueueChunkSave(chunk);
+}
+
+void ChunkProvider::QueueChunkSave(Chunk* chunk)
+{
+	if (!chunk->m_blocksDirty)
+	{
+		ChunkPool::GetInstance().DestroyChunk(chunk);
+		return;
+	}
+
+	m_chunksSaving.Insert(chunk->m_chunkCoords, chunk);
+	g_theJobSystem->QueueJob(new ChunkSaveJob(this, chunk));
 }
 
 // ============ IO ================ //
@@ -523,15 +549,75 @@ constexpr unsigned char CHUNK_FILE_BITS_Y = (unsigned char)CHUNK_SIZE_BITWIDTH_X
 constexpr unsigned char CHUNK_FILE_BITS_Z = (unsigned char)CHUNK_SIZE_BITWIDTH_Z;
 
 
-bool ChunkProvider::LoadChunkFromDisk(Chunk* chunk) const
+RegionFile* ChunkProvider::GetRegion(const ChunkCoords& chunkCoords)
+{
+	std::lock_guard<std::mutex> lock(m_regionsMutex);
+	IntVec2 regionCoords = RegionFile::GetRegionCoords(chunkCoords);
+	auto ite = m_regions.find(regionCoords);
+	if (ite != m_regions.end())
+		return ite->second;
+
+	RegionFile* region = new RegionFile(GetRegionFileName(regionCoords));
+	m_regions[regionCoords] = region;
+	return region;
+}
+
+void ChunkProvider::CloseAllRegions()
+{
+	// only called with no IO jobs in flight
+	std::lock_guard<std::mutex> lock(m_regionsMutex);
+	for (auto& entry : m_regions)
+		delete entry.second;
+	m_regions.clear();
+}
+
+void ChunkProvider::ConvertLegacyChunkFiles()
+{
+	// one chunk per file from older saves, moved into the regions once and deleted
+	std::error_code error;
+	std::vector<std::filesystem::path> legacyFiles;
+	for (const auto& file : std::filesystem::directory_iterator(std::filesystem::path(m_path), error))
+	{
+		if (file.path().extension() == ".chunk")
+			legacyFiles.push_back(file.path());
+	}
+
+	for (const auto& path : legacyFiles)
+	{
+		ChunkCoords coords;
+		if (sscanf(path.filename().string().c_str(), "Chunk(%d,%d).chunk", &coords.x, &coords.y) != 2)
+			continue;
+
+		// the region copy was saved after the conversion, so it wins and the old file is only in the way
+		RegionFile* region = GetRegion(coords);
+		if (region->HasChunk(coords))
+		{
+			std::filesystem::remove(path, error);
+			continue;
+		}
+
+		ByteBuffer buffer;
+		if (FileReadToBuffer(buffer, path.string()) == -1)
+			continue;
+		if (region->WriteChunk(coords, (const unsigned char*)buffer.GetData(), buffer.GetSize()))
+			std::filesystem::remove(path, error);
+	}
+
+	if (!legacyFiles.empty())
+		CloseAllRegions();
+}
+
+bool ChunkProvider::LoadChunkFromDisk(Chunk* chunk)
 {
 	if (m_disableLoadFromDisk)
 		return false; // Disabled load from disk.
 
+	std::vector<unsigned char> data;
+	if (!GetRegion(chunk->m_chunkCoords)->ReadChunk(chunk->m_chunkCoords, data))
+		return false; // Chunk not in region.
+
 	ByteBuffer buffer;
-	int len = FileReadToBuffer(buffer, GetFileName(chunk->m_chunkCoords));
-	if (len == -1)
-		return false; // Read file failed.
+	buffer.Write(data.size(), data.data());
 
 	unsigned char chunk_FILE_HEADER[CHUNK_FILE_HEADER_SIZE];
 	unsigned char chunk_FILE_VERSION;
@@ -561,7 +647,7 @@ bool ChunkProvider::LoadChunkFromDisk(Chunk* chunk) const
 	return true;
 }
 
-bool ChunkProvider::SaveChunkToDisk(const Chunk* chunk) const
+bool ChunkProvider::SaveChunkToDisk(const Chunk* chunk)
 {
 	if (!chunk->m_blocksDirty)
 		return true;
@@ -577,21 +663,20 @@ bool ChunkProvider::SaveChunkToDisk(const Chunk* chunk) const
 	buffer.Write(CHUNK_FILE_BITS_Z);
 	
 	chunk->WriteBytes(&buffer);
-	int len = FileWriteFromBuffer(buffer, GetFileName(chunk->m_chunkCoords));
-	return len != -1;
+	return GetRegion(chunk->m_chunkCoords)->WriteChunk(chunk->m_chunkCoords, (const unsigned char*)buffer.GetData(), buffer.GetSize());
 }
 
 void ChunkProvider::FinishUpChunkLoading(Chunk* chunk)
 {
-	m_chunksLoaded[chunk->m_chunkCoords] = chunk;
+	m_chunksLoaded.Insert(chunk->m_chunkCoords, chunk);
 
 	for (BlockFace face : CHUNK_NEIGHBORS)
 	{
-		auto iteNeighbor = m_chunksLoaded.find(chunk->m_chunkCoords + Block::GetOffset2ByFace(face));
-		if (iteNeighbor != m_chunksLoaded.end())
+		Chunk* neighbor = m_chunksLoaded.Find(chunk->m_chunkCoords + Block::GetOffset2ByFace(face));
+		if (neighbor)
 		{
-			iteNeighbor->second->OnNeighborLoad(*chunk);
-			chunk->OnNeighborLoad(*iteNeighbor->second);
+			neighbor->OnNeighborLoad(*chunk);
+			chunk->OnNeighborLoad(*neighbor);
 		}
 	}
 
@@ -606,13 +691,89 @@ ChunkPopulateJob::ChunkPopulateJob(ChunkProvider* provider, Chunk* chunk) : Job(
 
 void ChunkPopulateJob::Execute()
 {
+	if (m_chunk->m_cancelled)
+	{
+		m_skipped = true;
+		return;
+	}
+
 	m_chunk->m_state = ChunkState::GENERATING;
 	m_chunkProvider->PopulateChunk(m_chunk);
+	LightEngine::PopulateChunk(*m_chunk);
+	m_chunk->m_nav.Build(*m_chunk);
 	m_chunk->m_state = ChunkState::GENERATED;
 }
 
 void ChunkPopulateJob::OnFinished()
 {
-	m_chunkProvider->m_chunksGenerating.erase(m_chunk->m_chunkCoords);
+	if (m_skipped || m_chunk->m_cancelled)
+	{
+		m_chunkProvider->DiscardCancelledChunk(m_chunk);
+		return;
+	}
+
+	m_chunkProvider->m_chunksGenerating.Erase(m_chunk->m_chunkCoords);
 	m_chunkProvider->FinishUpChunkLoading(m_chunk);
 }
+
+ChunkLoadJob::ChunkLoadJob(ChunkProvider* provider, Chunk* chunk) : Job(JOB_TYPE_LOAD_CHUNK)
+	, m_chunk(chunk)
+	, m_chunkProvider(provider)
+{
+}
+
+void ChunkLoadJob::Execute()
+{
+	if (m_chunk->m_cancelled)
+	{
+		m_skipped = true;
+		return;
+	}
+
+	m_loaded = m_chunkProvider->LoadChunkFromDisk(m_chunk);
+	if (m_loaded)
+	{
+		// only block ids are saved, light is rebuilt here like for a fresh chunk
+		LightEngine::PopulateChunk(*m_chunk);
+		m_chunk->m_nav.Build(*m_chunk);
+	}
+}
+
+void ChunkLoadJob::OnFinished()
+{
+	if (m_skipped || m_chunk->m_cancelled)
+	{
+		m_chunkProvider->DiscardCancelledChunk(m_chunk);
+		return;
+	}
+
+	if (!m_loaded)
+	{
+		g_theJobSystem->QueueJob(new ChunkPopulateJob(m_chunkProvider, m_chunk));
+		return;
+	}
+
+	m_chunkProvider->m_chunksGenerating.Erase(m_chunk->m_chunkCoords);
+	m_chunkProvider->FinishUpChunkLoading(m_chunk);
+}
+
+ChunkSaveJob::ChunkSaveJob(ChunkProvider* provider, Chunk* chunk) : Job(JOB_TYPE_SAVE_CHUNK)
+	, m_chunk(chunk)
+	, m_chunkProvider(provider)
+{
+}
+
+void ChunkSaveJob::Execute()
+{
+	m_chunkProvider->SaveChunkToDisk(m_chunk);
+}
+
+void ChunkSaveJob::OnFinished()
+{
+	m_chunkProvider->m_chunksSaving.Erase(m_chunk->m_chunkCoords);
+
+	// loads of these coords were refused while the save was in flight
+	if (m_chunkProvider->IsNearHotspot(m_chunk->m_chunkCoords, 1 + m_chunkProvider->m_chunkActivationRange / CHUNK_SIZE_XY))
+		m_chunkProvider->m_activationDirty = true;
+	ChunkPool::GetInstance().DestroyChunk(m_chunk);
+}
@@ -1,14 +1,19 @@
 #include "Game/World/BlockIterator.hpp"
 #include "Game/World/Chunk.hpp"
+#include "Game/World/ChunkMap.hpp"
+#include "Game/World/LightEngine.hpp"
+#include "Game/World/RegionFile.hpp"
 #include "Engine/Core/JobSystem.hpp"
 #include "Engine/Core/Stopwatch.hpp"
 
 #include <map>
-#include <deque>
+#include <mutex>
 
 class World;
 class WorldGenerator;
 
+constexpr int JOB_TYPE_LOAD_CHUNK = 992;
+constexpr int JOB_TYPE_SAVE_CHUNK = 993;
 constexpr int JOB_TYPE_GEN_CHUNK = 999;
 
 enum class ChunkLoadStatus
@@ -30,6 +35,39 @@ private:
 	virtual void Execute() override;
 	virtual void OnFinished() override;
 
+private:
+	Chunk* const                    m_chunk;
+	ChunkProvider* const            m_chunkProvider;
+	bool                            m_skipped = false;
+};
+
+// reads and decodes a chunk from its region, falls back to generation when it is not on disk
+class ChunkLoadJob : public Job
+{
+public:
+	ChunkLoadJob(ChunkProvider* provider, Chunk* chunk);
+
+private:
+	virtual void Execute() override;
+	virtual void OnFinished() override;
+
+private:
+	Chunk* const                    m_chunk;
+	ChunkProvider* const            m_chunkProvider;
+	bool                            m_loaded = false;
+	bool                            m_skipped = false;
+};
+
+// encodes and writes an unloaded chunk, the chunk is deleted once it is on disk
+class ChunkSaveJob : public Job
+{
+public:
+	ChunkSaveJob(ChunkProvider* provider, Chunk* chunk);
+
+private:
+	virtual void Execute() override;
+	virtual void OnFinished() override;
+
 private:
 	Chunk* const                    m_chunk;
 	ChunkProvider* const            m_chunkProvider;
@@ -38,6 +76,9 @@ private:
 class ChunkProvider
 {
 	friend class ChunkPopulateJob;
+	friend class ChunkLoadJob;
+	friend class ChunkSaveJob;
+	friend class ChunkMeshJob;
 
 public:
 	ChunkProvider(World* world, const char* folderPath, WorldGenerator* generator);
@@ -46,8 +87,7 @@ public:
 	void Update();
 
 	// chunk management
-	std::map<ChunkCoords, Chunk*>& GetLoadedChunks();
-	const std::map<ChunkCoords, Chunk*>& GetLoadedChunks() const;
+	const ChunkMap& GetLoadedChunks() const;
 	bool LoadChunkWithTicket(const ChunkCoords& coords);
 	ChunkLoadStatus LoadChunk(const ChunkCoords& coords);
 	void UnloadChunk(const ChunkCoords& coords);
@@ -61,37 +101,50 @@ public:
 
 	// lighting
 	void ProcessDirtyLighting();
-	void ProcessNextDirtyLightBlock();
 	void MarkLightingDirty(const BlockIterator& blockIte);
 	void MarkLightingDirty(const WorldCoords& worldCoords);
+	void MarkBorderLightingDirty(Chunk* chunk, BlockFace face);
 	void UndirtyAllBlocksInChunk(const ChunkCoords& chunkCoords);
 
 	// utils
 	int  GetChunkActiveRange() const { return m_chunkActivationRange; }
+	bool IsGreedyMeshing() const { return m_greedyMeshing; }
 	bool GetChunkIOTicket();
 	bool GetRebuildMeshTicket();
+	void QueueChunkMesh(Chunk* chunk);
 	void SetHotspotSize(int size);
-	void SetHotspot(int index, const Vec3& worldPos);
+	void SetHotspot(int index, const Vec3& worldPos, const Vec3& forward = Vec3());
 
 	// tick
 	void BeginFrame();
 	void EndFrame();
 
 	// file utils
-	std::string GetFileName(const ChunkCoords& coords) const;
+	std::string GetRegionFileName(const IntVec2& regionCoords) const;
 
 
 private:
 	void UpdateRandomTick();
+	void PackIdleChunks();
 
 	void DoChunkDeactivation();
 	void DoChunkActivation();
+	void BuildActivationOffsets();
+	void RebuildActivationQueue();
+	void RebuildDeactivationQueue();
+	bool IsNearHotspot(const ChunkCoords& coords, int radius) const;
+	void DiscardCancelledChunk(Chunk* chunk);
+
+	RegionFile* GetRegion(const ChunkCoords& chunkCoords);
+	void CloseAllRegions();
+	void ConvertLegacyChunkFiles();
 
-	bool LoadChunkFromDisk(Chunk* chunk) const;
+	bool LoadChunkFromDisk(Chunk* chunk);
 	void PopulateChunk(Chunk* chunk);
-	bool SaveChunkToDisk(const Chunk* chunk) const;
+	bool SaveChunkToDisk(const Chunk* chunk);
 
 	void FinishUpChunkLoading(Chunk* chunk);
+	void QueueChunkSave(Chunk* chunk);
 
 private:
 	World* m_world = nullptr;
@@ -99,14 +152,41 @@ private:
 	bool m_disableLoadFromDisk = false;
 	unsigned int m_worldSeed = 781031139;
 	int m_chunkActivationRange = 250;
+	int m_chunkIOTicketsPerFrame = 8;
+	int m_chunkIOMaxPending = 32;
+	int m_chunkInstallsPerFrame = 4;
+	int m_chunkMeshJobsPerFrame = 16;
+	bool m_greedyMeshing = true;
+	int m_chunkPackRange = 64;
+	int m_chunkPackIdleFrames = 120;
+	int m_chunkPackPerFrame = 4;
+	int m_randomTickRadius = 8; // in chunks
+	int m_randomTicksPerSection = 3;
 	WorldGenerator* m_generator = nullptr;
-	std::map<ChunkCoords, Chunk*> m_chunksLoaded;
-	std::map<ChunkCoords, Chunk*> m_chunksGenerating;
+	ChunkMap m_chunksLoaded;
+	ChunkMap m_chunksGenerating; // being read from disk or generated
+	ChunkMap m_chunksSaving;
+	std::map<IntVec2, RegionFile*> m_regions;
+	std::mutex m_regionsMutex;
 	int m_rebuildMeshTicket = 0;
+	int m_meshJobsPending = 0;
 	int m_chunkIOTicket = 0;
 	std::vector<ChunkCoords> m_hotspots;
-	std::deque<BlockIterator> m_dirtyLighting;
-	std::deque<BlockIterator> m_debugLighting;
+	std::vector<int> m_hotspotFacings; // view direction in eighths of a turn, -1 when unknown
+
+	// chunks to load, best last; rebuilt only when a hotspot crosses a chunk border or turns
+	struct ChunkActivation
+	{
+		ChunkCoords m_coords;
+		float       m_priority = 0.0f;
+	};
+	std::vector<IntVec2> m_activationOffsets; // inside the activation radius, nearest first
+	std::vector<ChunkActivation> m_activationQueue;
+	std::vector<ChunkCoords> m_deactivationQueue; // nearest first, the farthest unloads first
+	bool m_activationDirty = true;
+	bool m_deactivationDirty = true;
+	float m_activationFacingWeight = 0.5f;
+	LightEngine m_lightEngine;
 	Stopwatch m_rndTickWatch;
 };
 
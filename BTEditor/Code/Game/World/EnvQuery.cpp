@@ -0,0 +1,337 @@
+#include "Game/World/EnvQuery.hpp"
+
+#include "Game/Framework/GameCommon.hpp"
+#include "Game/World/World.hpp"
+#include "Game/World/NavMesh.hpp"
+#include "Game/World/RaycastBatch.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+
+#include <cmath>
+#include <functional>
+#include <thread>
+
+static inline void HashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+static inline float ClampZeroToOne(float value)
+{
+    return value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+}
+
+size_t EnvQuery::GetHash() const
+{
+    size_t hash = (size_t)m_generator;
+    HashCombine(hash, (size_t)m_origin);
+    HashCombine(hash, std::hash<float>()(m_radius));
+    HashCombine(hash, std::hash<float>()(m_spacing));
+    HashCombine(hash, (size_t)m_count);
+    for (const EnvQueryTest& test : m_tests)
+    {
+        HashCombine(hash, (size_t)test.m_type);
+        HashCombine(hash, (size_t)test.m_reference);
+        HashCombine(hash, std::hash<float>()(test.m_weight));
+        HashCombine(hash, std::hash<float>()(test.m_min));
+        HashCombine(hash, std::hash<float>()(test.m_max));
+        HashCombine(hash, (size_t)test.m_filter << 1 | (size_t)test.m_inverse);
+    }
+    return hash;
+}
+
+bool EnvQuery::operator==(const EnvQuery& other) const
+{
+    return m_generator == other.m_generator
+        && m_origin == other.m_origin
+        && m_radius == other.m_radius
+        && m_spacing == other.m_spacing
+        && m_count == other.m_count
+        && m_tests == other.m_tests;
+}
+
+bool EnvQueryTest::operator==(const EnvQueryTest& other) const
+{
+    return m_type == other.m_type
+        && m_reference == other.m_reference
+        && m_weight == other.m_weight
+        && m_min == other.m_min
+        && m_max == other.m_max
+        && m_filter == other.m_filter
+        && m_inverse == other.m_inverse;
+}
+
+bool EnvQueryContextKey::operator==(const EnvQueryContextKey& other) const
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if (m_values[i] != other.m_values[i])
+            return false;
+    }
+    return true;
+}
+
+EnvQueryContextKey EnvQueryContext::GetKey() const
+{
+    // agents standing in the same block share the answer
+    EnvQueryContextKey key;
+    key.m_values[0] = (int)floorf(m_querier.x);
+    key.m_values[1] = (int)floorf(m_querier.y);
+    key.m_values[2] = (int)floorf(m_querier.z);
+    key.m_values[3] = (int)floorf(m_target.x);
+    key.m_values[4] = (int)floorf(m_target.y);
+    key.m_values[5] = (int)floorf(m_target.z);
+    key.m_values[6] = (int)floorf(m_direction.x * 8.0f);
+    key.m_values[7] = (int)floorf(m_direction.y * 8.0f);
+    return key;
+}
+
+void EnvQueryItems::Clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_score.clear();
+    m_valid.clear();
+}
+
+void EnvQueryItems::Add(const Vec3& position)
+{
+    m_x.push_back(position.x);
+    m_y.push_back(position.y);
+    m_z.push_back(position.z);
+    m_score.push_back(0.0f);
+    m_valid.push_back(1);
+}
+
+int EnvQueryItems::GetCount() const
+{
+    return (int)m_x.size();
+}
+
+EnvQueryJob::EnvQueryJob(EnvQuerySystem* system, int begin, int end) : Job(JOB_TYPE_ENV_QUERY)
+    , m_system(system)
+    , m_begin(begin)
+    , m_end(end)
+{
+}
+
+void EnvQueryJob::Execute()
+{
+    m_system->RunTests(m_begin, m_end);
+}
+
+void EnvQueryJob::OnFinished()
+{
+    m_system->m_runningJobs--;
+}
+
+EnvQuerySystem::EnvQuerySystem(World* world)
+    : m_world(world)
+{
+    m_itemsPerJob = g_gameConfigBlackboard.GetValue("envQueryItemsPerJob", m_itemsPerJob);
+}
+
+void EnvQuerySystem::BeginFrame()
+{
+    m_cache.clear();
+}
+
+bool EnvQuerySystem::RunQuery(const EnvQuery& query, const EnvQueryContext& context, Vec3& result)
+{
+    EnvQueryContextKey contextKey = context.GetKey();
+    size_t key = query.GetHash();
+    for (int value : contextKey.m_values)
+        HashCombine(key, (size_t)value);
+
+    auto range = m_cache.equal_range(key);
+    for (auto ite = range.first; ite != range.second; ++ite)
+    {
+        if (ite->second.m_context == contextKey && ite->second.m_query == query)
+        {
+            result = ite->second.m_result.m_position;
+            return ite->second.m_result.m_success;
+        }
+    }
+
+    m_query = &query;
+    m_context = context;
+    m_seed++;
+    Generate();
+
+    int count = m_items.GetCount();
+    if (count <= m_itemsPerJob)
+    {
+        RunTests(0, count);
+    }
+    else
+    {
+        for (int begin = 0; begin < count; begin += m_itemsPerJob)
+        {
+            m_runningJobs++;
+            g_theJobSystem->QueueJob(new EnvQueryJob(this, begin, begin + m_itemsPerJob < count ? begin + m_itemsPerJob : count));
+        }
+
+        while (m_runningJobs > 0)
+        {
+            g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_ENV_QUERY);
+            std::this_thread::yield();
+        }
+    }
+
+    EnvQueryCacheEntry& entry = m_cache.emplace(key, EnvQueryCacheEntry())->second;
+    entry.m_query = query;
+    entry.m_context = contextKey;
+
+    EnvQueryResult& best = entry.m_result;
+    for (int i = 0; i < count; i++)
+    {
+        if (!m_items.m_valid[i] || (best.m_success && m_items.m_score[i] <= best.m_score))
+            continue;
+
+        best.m_success = true;
+        best.m_score = m_items.m_score[i];
+        best.m_position = Vec3(m_items.m_x[i], m_items.m_y[i], m_items.m_z[i]);
+    }
+
+    m_query = nullptr;
+    result = best.m_position;
+    return best.m_success;
+}
+
+void EnvQuerySystem::Generate()
+{
+    m_items.Clear();
+
+    Vec3 origin = GetReference(m_query->m_origin);
+    float radius = m_query->m_radius;
+
+    switch (m_query->m_generator)
+    {
+    case EnvQueryGenerator::RING:
+    {
+        for (int i = 0; i < m_query->m_count; i++)
+        {
+            float radians = 6.2831853f * (float)i / (float)m_query->m_count;
+            m_items.Add(origin + Vec3(cosf(radians), sinf(radians), 0.0f) * radius);
+        }
+        break;
+    }
+    case EnvQueryGenerator::GRID:
+    case EnvQueryGenerator::NAV_CELLS:
+    {
+        float spacing = m_query->m_spacing > 0.0f ? m_query->m_spacing : 1.0f;
+        for (float y = -radius; y <= radius; y += spacing)
+            for (float x = -radius; x <= radius; x += spacing)
+                if (x * x + y * y <= radius * radius)
+                    m_items.Add(origin + Vec3(x, y, 0.0f));
+        break;
+    }
+    }
+}
+
+void EnvQuerySystem::RunTests(int begin, int end)
+{
+    // nav cells are grid points that survive the floor lookup, done here to keep it off the main thread
+    if (m_query->m_generator == EnvQueryGenerator::NAV_CELLS)
+    {
+        EnvQueryTest accessible;
+        accessible.m_type = EnvQueryTestType::ACCESSIBLE;
+        accessible.m_filter = true;
+        RunTest(accessible, begin, end);
+    }
+
+    // tests run in the order the query lists them, cheap filters first skip the raycasts
+    for (const EnvQueryTest& test : m_query->m_tests)
+        RunTest(test, begin, end);
+}
+
+void EnvQuerySystem::RunTest(const EnvQueryTest& test, int begin, int end)
+{
+    Vec3 reference = GetReference(test.m_reference);
+    Vec3 direction = Vec3(m_context.m_direction.x, m_context.m_direction.y, 0.0f).GetNormalized();
+    Vec3 eye = Vec3(0.0f, 0.0f, m_context.m_eyeHeight);
+
+    // line of sight rays of the whole range are traced together before scoring
+    RaycastBatch rays;
+    std::vector<int> itemRays;
+    if (test.m_type == EnvQueryTestType::LINE_OF_SIGHT)
+    {
+        itemRays.resize(end - begin, -1);
+        rays.Reserve(end - begin);
+        for (int i = begin; i < end; i++)
+        {
+            if (m_items.m_valid[i])
+                itemRays[i - begin] = rays.AddRay(reference + eye, Vec3(m_items.m_x[i], m_items.m_y[i], m_items.m_z[i]) + eye);
+        }
+        m_world->RaycastVsTiles(rays);
+    }
+
+    for (int i = begin; i < end; i++)
+    {
+        if (!m_items.m_valid[i])
+            continue;
+
+        float value = 0.0f;
+        bool pass = true;
+
+        switch (test.m_type)
+        {
+        case EnvQueryTestType::DISTANCE:
+        {
+            float distance = (Vec3(m_items.m_x[i], m_items.m_y[i], m_items.m_z[i]) - reference).GetLength();
+            pass = distance >= test.m_min && distance <= test.m_max;
+            value = test.m_max > test.m_min ? ClampZeroToOne((distance - test.m_min) / (test.m_max - test.m_min)) : 0.0f;
+            break;
+        }
+        case EnvQueryTestType::LINE_OF_SIGHT:
+        {
+            pass = !rays.DidHit(itemRays[i - begin]);
+            value = pass ? 1.0f : 0.0f;
+            break;
+        }
+        case EnvQueryTestType::ACCESSIBLE:
+        {
+            WorldCoords floor;
+            pass = m_world->m_navMesh->QueryFloor(Chunk::GetWorldCoords(Vec3(m_items.m_x[i], m_items.m_y[i], m_items.m_z[i])), floor);
+            if (pass)
+                m_items.m_z[i] = (float)floor.z;
+            value = pass ? 1.0f : 0.0f;
+            break;
+        }
+        case EnvQueryTestType::DOT:
+        {
+            Vec3 toItem = Vec3(m_items.m_x[i] - reference.x, m_items.m_y[i] - reference.y, 0.0f).GetNormalized();
+            float dot = toItem.Dot(direction);
+            pass = dot >= test.m_min && dot <= test.m_max;
+            value = (dot + 1.0f) * 0.5f;
+            break;
+        }
+        case EnvQueryTestType::RANDOM:
+        {
+            unsigned int hash = (m_seed * 2654435761u) ^ ((unsigned int)i * 2246822519u);
+            hash ^= hash >> 15;
+            hash *= 2654435761u;
+            hash ^= hash >> 13;
+            value = (float)(hash & 0xFFFF) / 65536.0f;
+            break;
+        }
+        }
+
+        if (test.m_filter)
+        {
+            if (pass == test.m_inverse)
+                m_items.m_valid[i] = 0;
+            continue;
+        }
+
+        m_items.m_score[i] += test.m_weight * (test.m_inverse ? 1.0f - value : value);
+    }
+}
+
+Vec3 EnvQuerySystem::GetReference(EnvQueryOrigin origin) const
+{
+    return origin == EnvQueryOrigin::TARGET ? m_context.m_target : m_context.m_querier;
+}
+
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+constexpr int JOB_TYPE_ENV_QUERY = 995;
+
+class World;
+class EnvQuerySystem;
+
+enum class EnvQueryGenerator
+{
+    RING,       // m_count points at m_radius around the origin
+    GRID,       // points every m_spacing blocks within m_radius of the origin
+    NAV_CELLS,  // grid points snapped to a walkable floor, columns without one are skipped
+};
+
+enum class EnvQueryOrigin
+{
+    QUERIER,
+    TARGET,
+};
+
+enum class EnvQueryTestType
+{
+    DISTANCE,       // distance to the reference, scored between m_min and m_max
+    LINE_OF_SIGHT,  // clear raycast from the reference eye height to the item
+    ACCESSIBLE,     // item column has a walkable floor, snaps the item onto it
+    DOT,            // direction from the reference against the context direction
+    RANDOM,         // breaks ties between otherwise equal items
+};
+
+struct EnvQueryTest
+{
+    EnvQueryTestType m_type      = EnvQueryTestType::DISTANCE;
+    EnvQueryOrigin   m_reference = EnvQueryOrigin::QUERIER;
+    float            m_weight    = 1.0f;
+    float            m_min       = 0.0f;
+    float            m_max       = 1.0f;
+    bool             m_filter    = false; // drop the item instead of scoring it
+    bool             m_inverse   = false; // prefer the low end, or keep the failing items
+
+    bool operator==(const EnvQueryTest& other) const;
+};
+
+struct EnvQuery
+{
+    EnvQueryGenerator         m_generator = EnvQueryGenerator::RING;
+    EnvQueryOrigin            m_origin    = EnvQueryOrigin::QUERIER;
+    float                     m_radius    = 10.0f;
+    float                     m_spacing   = 2.0f;
+    int                       m_count     = 16;
+    std::vector<EnvQueryTest> m_tests;
+
+    size_t GetHash() const;
+    bool   operator==(const EnvQuery& other) const;
+};
+
+// what two contexts must share to get the same answer
+struct EnvQueryContextKey
+{
+    int m_values[8] = {};
+
+    bool operator==(const EnvQueryContextKey& other) const;
+};
+
+struct EnvQueryContext
+{
+    Vec3  m_querier;
+    Vec3  m_target;
+    Vec3  m_direction;
+    float m_eyeHeight = 1.5f;
+
+    EnvQueryContextKey GetKey() const;
+};
+
+// candidates as parallel arrays so each test streams over one field at a time
+struct EnvQueryItems
+{
+    std::vector<float>         m_x;
+    std::vector<float>         m_y;
+    std::vector<float>         m_z;
+    std::vector<float>         m_score;
+    std::vector<unsigned char> m_valid;
+
+    void Clear();
+    void Add(const Vec3& position);
+    int  GetCount() const;
+};
+
+struct EnvQueryResult
+{
+    bool  m_success = false;
+    Vec3  m_position;
+    float m_score = 0.0f;
+};
+
+struct EnvQueryCacheEntry
+{
+    EnvQuery           m_query;
+    EnvQueryContextKey m_context;
+    EnvQueryResult     m_result;
+};
+
+class EnvQueryJob : public Job
+{
+public:
+    EnvQueryJob(EnvQuerySystem* system, int begin, int end);
+
+private:
+    virtual void Execute() override;
+    virtual void OnFinished() override;
+
+private:
+    EnvQuerySystem* const m_system;
+    const int             m_begin;
+    const int             m_end;
+};
+
+// generators and tests over candidate points, best item per (query, context) is cached for the frame
+class EnvQuerySystem
+{
+    friend class EnvQueryJob;
+
+public:
+    EnvQuerySystem(World* world);
+
+    void BeginFrame();
+    bool RunQuery(const EnvQuery& query, const EnvQueryContext& context, Vec3& result);
+
+private:
+    void Generate();
+    void RunTests(int begin, int end);
+    void RunTest(const EnvQueryTest& test, int begin, int end);
+    Vec3 GetReference(EnvQueryOrigin origin) const;
+
+private:
+    World * const                                        m_world;
+    std::unordered_multimap<size_t, EnvQueryCacheEntry>  m_cache; // by hash, a hit still compares the query and context
+
+    // the query being evaluated, read by the jobs
+    const EnvQuery*                            m_query = nullptr;
+    EnvQueryContext                            m_context;
+    EnvQueryItems                              m_items;
+    unsigned int                               m_seed = 0;
+
+    int                                        m_runningJobs = 0;
+    int                                        m_itemsPerJob = 32;
+};
+
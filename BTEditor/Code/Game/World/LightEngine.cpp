@@ -0,0 +1,434 @@
+#include "Game/World/LightEngine.hpp"
+
+#include "Game/World/BlockIterator.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+#include "Engine/Core/Time.hpp"
+
+#include <climits>
+#include <thread>
+#include <utility>
+
+enum class LightStep
+{
+	NONE,   // past the world top or bottom
+	INSIDE,
+	BORDER, // in the neighbor chunk on that face
+};
+
+static inline LightLevel GetLight(const Block& block, LightChannel channel)
+{
+	return channel == LIGHT_CHANNEL_INDOOR ? block.GetIndoorLightInfluence() : block.GetOutdoorLightInfluence();
+}
+
+static inline LightLevel GetSource(const Block& block, LightChannel channel)
+{
+	return channel == LIGHT_CHANNEL_INDOOR ? block.GetGlowLight() : block.GetSkyLight();
+}
+
+static inline LightStep StepNeighbor(int blockIndex, BlockFace face, int& neighborIndex)
+{
+	LocalCoords coords = Chunk::GetLocalCoords(blockIndex) + Block::GetOffsetByFace(face);
+	if (coords.z < 0 || coords.z > (int)CHUNK_MAX_Z)
+		return LightStep::NONE;
+
+	neighborIndex = Chunk::GetIndex(coords); // x and y wrap into the neighbor chunk
+	if (coords.x < 0 || coords.x > (int)CHUNK_MAX_X || coords.y < 0 || coords.y > (int)CHUNK_MAX_Y)
+		return LightStep::BORDER;
+	return LightStep::INSIDE;
+}
+
+static void SetLight(Block* blocks, ChunkLightQueues& queues, int blockIndex, LightChannel channel, LightLevel level)
+{
+	Block& block = blocks[blockIndex];
+	if (channel == LIGHT_CHANNEL_INDOOR)
+		block.SetIndoorLightInfluence(level);
+	else
+		block.SetOutdoorLightInfluence(level);
+
+	// neighbor meshes draw faces lit by this chunk's border blocks
+	queues.m_changed = true;
+	LocalCoords coords = Chunk::GetLocalCoords(blockIndex);
+	if (coords.x == (int)CHUNK_MAX_X)
+		queues.m_changedBorders |= 1 << BLOCK_FACE_NORTH;
+	if (coords.x == 0)
+		queues.m_changedBorders |= 1 << BLOCK_FACE_SOUTH;
+	if (coords.y == (int)CHUNK_MAX_Y)
+		queues.m_changedBorders |= 1 << BLOCK_FACE_WEST;
+	if (coords.y == 0)
+		queues.m_changedBorders |= 1 << BLOCK_FACE_EAST;
+}
+
+static void ApplyIncrease(Block* blocks, ChunkLightQueues& queues, int blockIndex, LightChannel channel, LightLevel level)
+{
+	const Block& block = blocks[blockIndex];
+	if (block.IsOpaque() || GetLight(block, channel) >= level)
+		return;
+
+	SetLight(blocks, queues, blockIndex, channel, level);
+	queues.m_increase[channel].push_back(blockIndex);
+}
+
+static void ApplyDecrease(Block* blocks, ChunkLightQueues& queues, int blockIndex, LightChannel channel, LightLevel removed)
+{
+	const Block& block = blocks[blockIndex];
+	LightLevel level = GetLight(block, channel);
+	if (level == 0)
+		return;
+
+	// dimmer than the removed light, it may have come from there; otherwise it lights the hole back up
+	if (level < removed)
+	{
+		LightLevel source = GetSource(block, channel);
+		if (level > source)
+		{
+			SetLight(blocks, queues, blockIndex, channel, source);
+			queues.m_decrease[channel].push_back({ blockIndex, level });
+		}
+		if (source > 0)
+			queues.m_increase[channel].push_back(blockIndex);
+	}
+	else
+	{
+		queues.m_increase[channel].push_back(blockIndex);
+	}
+}
+
+static int RunDecreases(Block* blocks, ChunkLightQueues& queues, LightChannel channel, int maxSteps)
+{
+	int steps = 0;
+	std::deque<LightNode>& decrease = queues.m_decrease[channel];
+	while (!decrease.empty() && steps < maxSteps)
+	{
+		LightNode node = decrease.front();
+		decrease.pop_front();
+		steps++;
+
+		for (BlockFace face : BLOCK_NEIGHBORS)
+		{
+			int nbrIndex = 0;
+			LightStep step = StepNeighbor(node.m_blockIndex, face, nbrIndex);
+			if (step == LightStep::INSIDE)
+				ApplyDecrease(blocks, queues, nbrIndex, channel, node.m_level);
+			else if (step == LightStep::BORDER)
+				queues.m_outgoing.push_back({ face, channel, true, { nbrIndex, node.m_level } });
+		}
+	}
+	return steps;
+}
+
+static int RunIncreases(Block* blocks, ChunkLightQueues& queues, LightChannel channel, int maxSteps)
+{
+	int steps = 0;
+	std::deque<int>& increase = queues.m_increase[channel];
+	while (!increase.empty() && steps < maxSteps)
+	{
+		int blockIndex = increase.front();
+		increase.pop_front();
+		steps++;
+
+		LightLevel level = GetLight(blocks[blockIndex], channel);
+		if (level <= 1)
+			continue;
+
+		for (BlockFace face : BLOCK_NEIGHBORS)
+		{
+			int nbrIndex = 0;
+			LightStep step = StepNeighbor(blockIndex, face, nbrIndex);
+			if (step == LightStep::INSIDE)
+				ApplyIncrease(blocks, queues, nbrIndex, channel, level - 1);
+			else if (step == LightStep::BORDER)
+				queues.m_outgoing.push_back({ face, channel, false, { nbrIndex, (LightLevel)(level - 1) } });
+		}
+	}
+	return steps;
+}
+
+size_t ChunkLightQueues::GetWorkSize() const
+{
+	size_t size = m_dirty.size();
+	for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+		size += m_decrease[channel].size() + m_increase[channel].size() + m_borderDecrease[channel].size() + m_borderIncrease[channel].size();
+	return size;
+}
+
+LightChunkJob::LightChunkJob(LightEngine* engine, Chunk* chunk, ChunkLightQueues* queues) : Job(JOB_TYPE_LIGHT_CHUNK)
+	, m_engine(engine)
+	, m_chunk(chunk)
+	, m_queues(queues)
+{
+
+}
+
+void LightChunkJob::Execute()
+{
+	m_engine->ProcessChunk(m_chunk, *m_queues);
+}
+
+void LightChunkJob::OnFinished()
+{
+	m_engine->m_runningJobs--;
+}
+
+LightEngine::LightEngine()
+{
+	m_budgetMs = g_gameConfigBlackboard.GetValue("lightBudgetMs", m_budgetMs);
+	m_stepsPerWave = g_gameConfigBlackboard.GetValue("lightStepsPerWave", m_stepsPerWave);
+	m_minJobSteps = g_gameConfigBlackboard.GetValue("lightMinJobSteps", m_minJobSteps);
+}
+
+void LightEngine::MarkDirty(Chunk* chunk, int blockIndex)
+{
+	Block& block = chunk->GetBlocks()[blockIndex];
+	if (!block.IsValid() || block.IsLightDirty())
+		return;
+
+	block.SetLightDirty(true);
+	m_queues[chunk].m_dirty.push_back(blockIndex);
+
+	// lit neighbors flow back in once the block has been re-evaluated
+	BlockIterator ite(chunk, blockIndex);
+	for (BlockFace face : BLOCK_NEIGHBORS)
+	{
+		BlockIterator iteNbr = ite.GetBlockNeighbor(face);
+		const Block* nbr = iteNbr.PeekBlock();
+		if (!nbr->IsValid())
+			continue;
+
+		for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+			if (GetLight(*nbr, (LightChannel)channel) > 1)
+				m_queues[iteNbr.GetChunk()].m_increase[channel].push_back(Chunk::GetIndex(iteNbr.GetLocalCoords()));
+	}
+}
+
+void LightEngine::MarkBorderDirty(Chunk* chunk, BlockFace face)
+{
+	Chunk* neighbor = chunk->m_neighbors[face];
+	if (!neighbor)
+		return;
+
+	// each side only pushes its own light across, the neighbor does the same from its side
+	const Block* blocks = chunk->GetBlocks();
+	for (int z = 0; z < (int)CHUNK_SIZE_Z; z++)
+		for (int i = 0; i < (int)CHUNK_SIZE_XY; i++)
+		{
+			LocalCoords inside;
+			switch (face)
+			{
+			case BLOCK_FACE_NORTH: inside = LocalCoords(CHUNK_MAX_X, i, z); break;
+			case BLOCK_FACE_SOUTH: inside = LocalCoords(0, i, z);           break;
+			case BLOCK_FACE_WEST:  inside = LocalCoords(i, CHUNK_MAX_Y, z); break;
+			case BLOCK_FACE_EAST:  inside = LocalCoords(i, 0, z);           break;
+			default: break;
+			}
+			int blockIndex = Chunk::GetIndex(inside);
+			const Block& block = blocks[blockIndex];
+			const Block& nbr = neighbor->GetBlockAtIndex(Chunk::GetIndex(inside + Block::GetOffsetByFace(face)));
+			if (nbr.IsOpaque())
+				continue;
+
+			for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+				if (GetLight(block, (LightChannel)channel) > GetLight(nbr, (LightChannel)channel) + 1)
+					m_queues[chunk].m_increase[channel].push_back(blockIndex);
+		}
+}
+
+void LightEngine::RemoveChunk(Chunk* chunk)
+{
+	auto ite = m_queues.find(chunk);
+	if (ite == m_queues.end())
+		return;
+
+	Block* blocks = chunk->GetBlocks();
+	for (int blockIndex : ite->second.m_dirty)
+		blocks[blockIndex].SetLightDirty(false);
+	m_queues.erase(ite);
+}
+
+void LightEngine::Clear()
+{
+	while (!m_queues.empty())
+		RemoveChunk(m_queues.begin()->first);
+}
+
+void LightEngine::Update()
+{
+	double start = GetCurrentTimeSeconds();
+	while (!m_queues.empty() && (GetCurrentTimeSeconds() - start) * 1000.0 < (double)m_budgetMs)
+		RunWave();
+}
+
+void LightEngine::PopulateChunk(Chunk& chunk)
+{
+	Block* blocks = chunk.GetBlocks();
+	ChunkLightQueues queues;
+
+	// sky runs down every column to the first solid block, glow starts at its emitters
+	for (int y = 0; y < (int)CHUNK_SIZE_XY; y++)
+		for (int x = 0; x < (int)CHUNK_SIZE_XY; x++)
+			for (int z = CHUNK_MAX_Z; z >= 0; z--)
+			{
+				int blockIndex = Chunk::GetIndex(LocalCoords(x, y, z));
+				Block& block = blocks[blockIndex];
+				if (block.IsSolid())
+					break;
+				block.SetSky(true);
+				block.SetOutdoorLightInfluence(15);
+			}
+
+	for (int blockIndex = 0; blockIndex < (int)CHUNK_SIZE_BLOCKS; blockIndex++)
+	{
+		Block& block = blocks[blockIndex];
+		LightLevel glow = block.GetGlowLight();
+		if (glow > 0)
+		{
+			block.SetIndoorLightInfluence(glow);
+			queues.m_increase[LIGHT_CHANNEL_INDOOR].push_back(blockIndex);
+		}
+
+		// only sky next to a darker block has somewhere to spread
+		if (!block.IsSky())
+			continue;
+		for (BlockFace face : CHUNK_NEIGHBORS)
+		{
+			int nbrIndex = 0;
+			if (StepNeighbor(blockIndex, face, nbrIndex) == LightStep::INSIDE && !blocks[nbrIndex].IsSky() && !blocks[nbrIndex].IsOpaque())
+			{
+				queues.m_increase[LIGHT_CHANNEL_OUTDOOR].push_back(blockIndex);
+				break;
+			}
+		}
+	}
+
+	// light leaving the chunk is dropped, MarkBorderDirty carries it over once the neighbor attaches
+	for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+		RunIncreases(blocks, queues, (LightChannel)channel, INT_MAX);
+}
+
+void LightEngine::RunWave()
+{
+	std::vector<std::pair<Chunk*, ChunkLightQueues*>> active;
+	size_t workSize = 0;
+	for (auto& entry : m_queues)
+	{
+		active.push_back({ entry.first, &entry.second });
+		workSize += entry.second.GetWorkSize();
+	}
+
+	// every chunk only writes its own blocks and queues, so a wave runs them all at once
+	if (active.size() == 1 || (int)workSize < m_minJobSteps)
+	{
+		for (auto& entry : active)
+			ProcessChunk(entry.first, *entry.second);
+	}
+	else
+	{
+		for (auto& entry : active)
+		{
+			m_runningJobs++;
+			g_theJobSystem->QueueJob(new LightChunkJob(this, entry.first, entry.second));
+		}
+
+		while (m_runningJobs > 0)
+		{
+			g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_LIGHT_CHUNK);
+			std::this_thread::yield();
+		}
+	}
+
+	for (auto& entry : active)
+		ExchangeBorders(entry.first, *entry.second);
+
+	for (auto ite = m_queues.begin(); ite != m_queues.end();)
+	{
+		if (ite->second.HasWork())
+			ite++;
+		else
+			ite = m_queues.erase(ite);
+	}
+}
+
+void LightEngine::ProcessChunk(Chunk* chunk, ChunkLightQueues& queues) const
+{
+	Block* blocks = chunk->GetBlocks();
+	int steps = 0;
+
+	for (int channelIdx = 0; channelIdx < LIGHT_CHANNEL_COUNT; channelIdx++)
+	{
+		LightChannel channel = (LightChannel)channelIdx;
+		for (const LightNode& node : queues.m_borderDecrease[channel])
+			ApplyDecrease(blocks, queues, node.m_blockIndex, channel, node.m_level);
+		queues.m_borderDecrease[channel].clear();
+	}
+
+	// an edited block drops to its own emission, whatever it lit before is taken back by a decrease
+	for (int blockIndex : queues.m_dirty)
+	{
+		Block& block = blocks[blockIndex];
+		block.SetLightDirty(false);
+		for (int channelIdx = 0; channelIdx < LIGHT_CHANNEL_COUNT; channelIdx++)
+		{
+			LightChannel channel = (LightChannel)channelIdx;
+			LightLevel level = GetLight(block, channel);
+			LightLevel source = GetSource(block, channel);
+			if (level > source)
+			{
+				SetLight(blocks, queues, blockIndex, channel, source);
+				queues.m_decrease[channel].push_back({ blockIndex, level });
+			}
+			else if (level < source)
+			{
+				SetLight(blocks, queues, blockIndex, channel, source);
+			}
+			if (source > 0)
+				queues.m_increase[channel].push_back(blockIndex);
+		}
+	}
+	queues.m_dirty.clear();
+
+	for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+		steps += RunDecreases(blocks, queues, (LightChannel)channel, m_stepsPerWave - steps);
+
+	// spreading before every removal is through would carry stale light into the hole,
+	// light offered by the neighbors waits for the same reason
+	if (!queues.m_decrease[LIGHT_CHANNEL_INDOOR].empty() || !queues.m_decrease[LIGHT_CHANNEL_OUTDOOR].empty())
+		return;
+
+	for (int channelIdx = 0; channelIdx < LIGHT_CHANNEL_COUNT; channelIdx++)
+	{
+		LightChannel channel = (LightChannel)channelIdx;
+		for (const LightNode& node : queues.m_borderIncrease[channel])
+			ApplyIncrease(blocks, queues, node.m_blockIndex, channel, node.m_level);
+		queues.m_borderIncrease[channel].clear();
+	}
+
+	for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; channel++)
+		steps += RunIncreases(blocks, queues, (LightChannel)channel, m_stepsPerWave - steps);
+}
+
+void LightEngine::ExchangeBorders(Chunk* chunk, ChunkLightQueues& queues)
+{
+	for (const LightBorderUpdate& update : queues.m_outgoing)
+	{
+		Chunk* neighbor = chunk->m_neighbors[update.m_face];
+		if (!neighbor)
+			continue; // picked up again by the neighbor's own sky and glow pass when it loads
+
+		ChunkLightQueues& nbrQueues = m_queues[neighbor];
+		if (update.m_decrease)
+			nbrQueues.m_borderDecrease[update.m_channel].push_back(update.m_node);
+		else
+			nbrQueues.m_borderIncrease[update.m_channel].push_back(update.m_node);
+	}
+	queues.m_outgoing.clear();
+
+	if (queues.m_changed)
+		chunk->m_meshDirty = true;
+	for (BlockFace face : CHUNK_NEIGHBORS)
+		if ((queues.m_changedBorders & (1 << face)) && chunk->m_neighbors[face])
+			chunk->m_neighbors[face]->m_meshDirty = true;
+	queues.m_changed = false;
+	queues.m_changedBorders = 0;
+}
+
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+#include "Engine/Core/JobSystem.hpp"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+constexpr int JOB_TYPE_LIGHT_CHUNK = 990;
+
+enum LightChannel
+{
+	LIGHT_CHANNEL_INDOOR,  // glow from blocks
+	LIGHT_CHANNEL_OUTDOOR, // sky
+	LIGHT_CHANNEL_COUNT,
+};
+
+class LightEngine;
+
+struct LightNode
+{
+	int        m_blockIndex = 0;
+	LightLevel m_level = 0; // level removed for decreases, level offered for increases from a neighbor chunk
+};
+
+// light leaving a chunk during a wave, handed to the neighbor's queues once every job is done
+struct LightBorderUpdate
+{
+	BlockFace    m_face = BLOCK_FACE_NORTH;
+	LightChannel m_channel = LIGHT_CHANNEL_INDOOR;
+	bool         m_decrease = false;
+	LightNode    m_node;
+};
+
+// pending light work of one chunk, only that chunk's job touches it during a wave
+struct ChunkLightQueues
+{
+	std::deque<int>                m_dirty; // edited blocks to re-evaluate
+	std::deque<LightNode>          m_decrease[LIGHT_CHANNEL_COUNT];
+	std::deque<int>                m_increase[LIGHT_CHANNEL_COUNT];
+	std::deque<LightNode>          m_borderDecrease[LIGHT_CHANNEL_COUNT];
+	std::deque<LightNode>          m_borderIncrease[LIGHT_CHANNEL_COUNT];
+	std::vector<LightBorderUpdate> m_outgoing;
+	bool                           m_changed = false;
+	int                            m_changedBorders = 0; // bit per chunk neighbor face whose mesh samples a changed block
+
+	size_t GetWorkSize() const;
+	bool   HasWork() const { return GetWorkSize() > 0; }
+};
+
+class LightChunkJob : public Job
+{
+public:
+	LightChunkJob(LightEngine* engine, Chunk* chunk, ChunkLightQueues* queues);
+
+private:
+	virtual void Execute() override;
+	virtual void OnFinished() override;
+
+private:
+	LightEngine* const      m_engine;
+	Chunk* const            m_chunk;
+	ChunkLightQueues* const m_queues;
+};
+
+// flood fill lighting in waves, every chunk with work runs as its own job and light crossing
+// a chunk border is exchanged between waves, removals run as decreases instead of re-flooding
+class LightEngine
+{
+	friend class LightChunkJob;
+
+public:
+	LightEngine();
+
+	void MarkDirty(Chunk* chunk, int blockIndex);
+	void MarkBorderDirty(Chunk* chunk, BlockFace face);
+	void RemoveChunk(Chunk* chunk);
+	void Clear();
+	void Update();
+	void RunWave();
+
+	bool HasWork() const { return !m_queues.empty(); }
+
+	static void PopulateChunk(Chunk& chunk);
+
+private:
+	void ProcessChunk(Chunk* chunk, ChunkLightQueues& queues) const;
+	void ExchangeBorders(Chunk* chunk, ChunkLightQueues& queues);
+
+private:
+	std::unordered_map<Chunk*, ChunkLightQueues>   m_queues;
+	int                                            m_runningJobs = 0;
+	float                                          m_budgetMs = 2.0f;
+	int                                            m_stepsPerWave = 8192; // per chunk, keeps one wave from outrunning the budget
+	int                                            m_minJobSteps = 256;   // smaller waves run inline
+};
+
@@ -0,0 +1,373 @@
+#include "Game/World/NavCrowd.hpp"
+
+#include "Game/Framework/GameCommon.hpp"
+#include "Game/Entity/Actor.hpp"
+#include "Game/Entity/ActorDefinition.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+constexpr float CROWD_EPSILON = 0.00001f;
+
+static inline float Dot(const Vec2& a, const Vec2& b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+static inline float Det(const Vec2& a, const Vec2& b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+static inline int GetCell(float coord, float cellSize)
+{
+    return (int)floorf(coord / cellSize);
+}
+
+// linear programs below follow van den Berg et al., "Reciprocal n-Body Collision Avoidance"
+static bool SolveOnLine(const std::vector<CrowdConstraint>& lines, size_t lineNo, float radius, const Vec2& optVelocity, bool directionOpt, Vec2& result)
+{
+    const CrowdConstraint& line = lines[lineNo];
+    float dotProduct = Dot(line.m_point, line.m_direction);
+    float discriminant = dotProduct * dotProduct + radius * radius - line.m_point.GetLengthSquared();
+    if (discriminant < 0.0f)
+        return false; // max speed circle misses the line
+
+    float sqrtDiscriminant = sqrtf(discriminant);
+    float tLeft = -dotProduct - sqrtDiscriminant;
+    float tRight = -dotProduct + sqrtDiscriminant;
+
+    for (size_t i = 0; i < lineNo; i++)
+    {
+        float denominator = Det(line.m_direction, lines[i].m_direction);
+        float numerator = Det(lines[i].m_direction, line.m_point - lines[i].m_point);
+
+        if (fabsf(denominator) <= CROWD_EPSILON)
+        {
+            // parallel lines
+            if (numerator < 0.0f)
+                return false;
+            continue;
+        }
+
+        float t = numerator / denominator;
+        if (denominator >= 0.0f)
+            tRight = std::min(tRight, t);
+        else
+            tLeft = std::max(tLeft, t);
+
+        if (tLeft > tRight)
+            return false;
+    }
+
+    if (directionOpt)
+    {
+        result = line.m_point + line.m_direction * (Dot(optVelocity, line.m_direction) > 0.0f ? tRight : tLeft);
+    }
+    else
+    {
+        float t = Dot(line.m_direction, optVelocity - line.m_point);
+        t = t < tLeft ? tLeft : t > tRight ? tRight : t;
+        result = line.m_point + line.m_direction * t;
+    }
+    return true;
+}
+
+static size_t SolvePlane(const std::vector<CrowdConstraint>& lines, float radius, const Vec2& optVelocity, bool directionOpt, Vec2& result)
+{
+    if (directionOpt)
+        result = optVelocity * radius;
+    else if (optVelocity.GetLengthSquared() > radius * radius)
+        result = optVelocity.GetNormalized() * radius;
+    else
+        result = optVelocity;
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        if (Det(lines[i].m_direction, lines[i].m_point - result) > 0.0f)
+        {
+            Vec2 tempResult = result;
+            if (!SolveOnLine(lines, i, radius, optVelocity, directionOpt, result))
+            {
+                result = tempResult;
+                return i;
+            }
+        }
+    }
+    return lines.size();
+}
+
+static void SolveInfeasible(const std::vector<CrowdConstraint>& lines, size_t beginLine, float radius, Vec2& result)
+{
+    // no velocity satisfies every constraint, minimize the largest penetration instead
+    float distance = 0.0f;
+    std::vector<CrowdConstraint> projLines;
+
+    for (size_t i = beginLine; i < lines.size(); i++)
+    {
+        if (Det(lines[i].m_direction, lines[i].m_point - result) <= distance)
+            continue;
+
+        projLines.clear();
+        for (size_t j = 0; j < i; j++)
+        {
+            CrowdConstraint line;
+            float determinant = Det(lines[i].m_direction, lines[j].m_direction);
+            if (fabsf(determinant) <= CROWD_EPSILON)
+            {
+                if (Dot(lines[i].m_direction, lines[j].m_direction) > 0.0f)
+                    continue; // same direction
+                line.m_point = (lines[i].m_point + lines[j].m_point) * 0.5f;
+            }
+            else
+            {
+                line.m_point = lines[i].m_point + lines[i].m_direction * (Det(lines[j].m_direction, lines[i].m_point - lines[j].m_point) / determinant);
+            }
+            line.m_direction = (lines[j].m_direction - lines[i].m_direction).GetNormalized();
+            projLines.push_back(line);
+        }
+
+        Vec2 tempResult = result;
+        if (SolvePlane(projLines, radius, Vec2(-lines[i].m_direction.y, lines[i].m_direction.x), true, result) < projLines.size())
+            result = tempResult; // rounding error, keep the last result
+
+        distance = Det(lines[i].m_direction, lines[i].m_point - result);
+    }
+}
+
+CrowdAvoidanceJob::CrowdAvoidanceJob(NavCrowd* crowd, int begin, int end) : Job(JOB_TYPE_CROWD)
+    , m_crowd(crowd)
+    , m_begin(begin)
+    , m_end(end)
+{
+}
+
+void CrowdAvoidanceJob::Execute()
+{
+    m_crowd->ComputeVelocities(m_begin, m_end);
+}
+
+void CrowdAvoidanceJob::OnFinished()
+{
+    m_crowd->m_runningJobs--;
+}
+
+NavCrowd::NavCrowd()
+{
+    m_neighborDist = g_gameConfigBlackboard.GetValue("crowdNeighborDist", m_neighborDist);
+    m_maxNeighbors = g_gameConfigBlackboard.GetValue("crowdMaxNeighbors", m_maxNeighbors);
+    m_timeHorizon = g_gameConfigBlackboard.GetValue("crowdTimeHorizon", m_timeHorizon);
+    m_agentsPerJob = g_gameConfigBlackboard.GetValue("crowdAgentsPerJob", m_agentsPerJob);
+}
+
+void NavCrowd::AddAgent(Actor* actor, const Vec2& preferredVelocity, float maxSpeed)
+{
+    m_agents.emplace_back();
+    CrowdAgent& agent = m_agents.back();
+    agent.m_actor = actor;
+    agent.m_position = Vec2(actor->GetPosition().x, actor->GetPosition().y);
+    agent.m_preferredVelocity = preferredVelocity;
+    agent.m_maxSpeed = maxSpeed;
+    agent.m_radius = actor->m_physics ? actor->m_physics->m_physicsRadius : actor->m_definition->m_physicsRadius;
+    if (agent.m_radius <= 0.0f)
+        agent.m_radius = 0.5f;
+
+    auto ite = m_lastVelocities.find(actor);
+    if (ite != m_lastVelocities.end())
+        agent.m_velocity = ite->second;
+}
+
+void NavCrowd::AddObstacle(Actor* actor)
+{
+    AddAgent(actor, Vec2::ZERO, 0.0f);
+    m_agents.back().m_obstacle = true;
+}
+
+void NavCrowd::Update(float deltaSeconds)
+{
+    if (m_agents.empty() || deltaSeconds <= 0.0f)
+    {
+        m_agents.clear();
+        return;
+    }
+
+    m_deltaSeconds = deltaSeconds;
+    BuildSpatialHash();
+
+    int count = (int)m_agents.size();
+    if (count <= m_agentsPerJob)
+    {
+        ComputeVelocities(0, count);
+    }
+    else
+    {
+        for (int begin = 0; begin < count; begin += m_agentsPerJob)
+        {
+            m_runningJobs++;
+            g_theJobSystem->QueueJob(new CrowdAvoidanceJob(this, begin, std::min(begin + m_agentsPerJob, count)));
+        }
+
+        // movement this frame depends on the result
+        while (m_runningJobs > 0)
+        {
+            g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_CROWD);
+            std::this_thread::yield();
+        }
+    }
+
+    m_lastVelocities.clear();
+    for (CrowdAgent& agent : m_agents)
+    {
+        if (agent.m_obstacle)
+            continue;
+
+        agent.m_actor->m_transform.m_position += Vec3(agent.m_newVelocity.x, agent.m_newVelocity.y, 0.0f) * deltaSeconds;
+        m_lastVelocities[agent.m_actor] = agent.m_newVelocity;
+    }
+    m_agents.clear();
+}
+
+void NavCrowd::BuildSpatialHash()
+{
+    // power of two bucket count, at least twice the agent count to keep chains short
+    int bucketCount = 16;
+    while (bucketCount < (int)m_agents.size() * 2)
+        bucketCount <<= 1;
+    m_bucketMask = bucketCount - 1;
+
+    m_bucketStart.assign((size_t)bucketCount + 1, 0);
+    m_bucketAgents.resize(m_agents.size());
+
+    for (const CrowdAgent& agent : m_agents)
+        m_bucketStart[GetBucket(GetCell(agent.m_position.x, m_neighborDist), GetCell(agent.m_position.y, m_neighborDist)) + 1]++;
+    for (int i = 0; i < bucketCount; i++)
+        m_bucketStart[i + 1] += m_bucketStart[i];
+
+    std::vector<int> fill(m_bucketStart.begin(), m_bucketStart.end() - 1);
+    for (int i = 0; i < (int)m_agents.size(); i++)
+    {
+        const CrowdAgent& agent = m_agents[i];
+        int bucket = GetBucket(GetCell(agent.m_position.x, m_neighborDist), GetCell(agent.m_position.y, m_neighborDist));
+        m_bucketAgents[fill[bucket]++] = i;
+    }
+}
+
+int NavCrowd::GetBucket(int cellX, int cellY) const
+{
+    unsigned int hash = (unsigned int)cellX * 73856093u ^ (unsigned int)cellY * 19349663u;
+    return (int)(hash & (unsigned int)m_bucketMask);
+}
+
+void NavCrowd::ComputeVelocities(int begin, int end)
+{
+    std::vector<CrowdNeighbor> neighbors;
+    std::vector<CrowdConstraint> constraints;
+    for (int i = begin; i < end; i++)
+    {
+        if (!m_agents[i].m_obstacle)
+            ComputeVelocity(i, neighbors, constraints);
+    }
+}
+
+void NavCrowd::ComputeVelocity(int index, std::vector<CrowdNeighbor>& neighbors, std::vector<CrowdConstraint>& constraints)
+{
+    const CrowdAgent& agent = m_agents[index];
+
+    // 3x3 cells cover the neighbor distance, buckets may hold other cells on hash collisions
+    neighbors.clear();
+    int cellX = GetCell(agent.m_position.x, m_neighborDist);
+    int cellY = GetCell(agent.m_position.y, m_neighborDist);
+    float rangeSq = m_neighborDist * m_neighborDist;
+    for (int y = cellY - 1; y <= cellY + 1; y++)
+    {
+        for (int x = cellX - 1; x <= cellX + 1; x++)
+        {
+            int bucket = GetBucket(x, y);
+            for (int i = m_bucketStart[bucket]; i < m_bucketStart[bucket + 1]; i++)
+            {
+                int other = m_bucketAgents[i];
+                const Vec2& position = m_agents[other].m_position;
+                if (other == index || GetCell(position.x, m_neighborDist) != x || GetCell(position.y, m_neighborDist) != y)
+                    continue;
+
+                float distSq = (position - agent.m_position).GetLengthSquared();
+                if (distSq < rangeSq)
+                    neighbors.push_back(CrowdNeighbor(distSq, other));
+            }
+        }
+    }
+    if ((int)neighbors.size() > m_maxNeighbors)
+    {
+        std::partial_sort(neighbors.begin(), neighbors.begin() + m_maxNeighbors, neighbors.end());
+        neighbors.resize(m_maxNeighbors);
+    }
+
+    // one half plane of permitted velocities per neighbor
+    constraints.clear();
+    float invTimeHorizon = 1.0f / m_timeHorizon;
+    for (const CrowdNeighbor& neighbor : neighbors)
+    {
+        const CrowdAgent& other = m_agents[neighbor.second];
+        Vec2 relativePosition = other.m_position - agent.m_position;
+        Vec2 relativeVelocity = agent.m_velocity - other.m_velocity;
+        float distSq = neighbor.first;
+        float combinedRadius = agent.m_radius + other.m_radius;
+        float combinedRadiusSq = combinedRadius * combinedRadius;
+
+        CrowdConstraint line;
+        Vec2 u;
+
+        if (distSq > combinedRadiusSq)
+        {
+            Vec2 w = relativeVelocity - relativePosition * invTimeHorizon;
+            float wLengthSq = w.GetLengthSquared();
+            float dotProduct = Dot(w, relativePosition);
+
+            if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq)
+            {
+                // project on the cut-off circle
+                float wLength = sqrtf(wLengthSq);
+                Vec2 unitW = w / wLength;
+                line.m_direction = Vec2(unitW.y, -unitW.x);
+                u = unitW * (combinedRadius * invTimeHorizon - wLength);
+            }
+            else
+            {
+                // project on the legs
+                float leg = sqrtf(distSq - combinedRadiusSq);
+                if (Det(relativePosition, w) > 0.0f)
+                    line.m_direction = Vec2(relativePosition.x * leg - relativePosition.y * combinedRadius, relativePosition.x * combinedRadius + relativePosition.y * leg) / distSq;
+                else
+                    line.m_direction = -Vec2(relativePosition.x * leg + relativePosition.y * combinedRadius, -relativePosition.x * combinedRadius + relativePosition.y * leg) / distSq;
+
+                u = line.m_direction * Dot(relativeVelocity, line.m_direction) - relativeVelocity;
+            }
+        }
+        else
+        {
+            // already overlapping, get apart within this frame
+            float invTimeStep = 1.0f / m_deltaSeconds;
+            Vec2 w = relativeVelocity - relativePosition * invTimeStep;
+            float wLength = w.GetLength();
+            Vec2 unitW = wLength > CROWD_EPSILON ? w / wLength : Vec2(index < neighbor.second ? 1.0f : -1.0f, 0.0f);
+            line.m_direction = Vec2(unitW.y, -unitW.x);
+            u = unitW * (combinedRadius * invTimeStep - wLength);
+        }
+
+        // reciprocal agents take half the avoidance, obstacles do not move
+        line.m_point = agent.m_velocity + u * (other.m_obstacle ? 1.0f : 0.5f);
+        constraints.push_back(line);
+    }
+
+    Vec2 result;
+    size_t lineFail = SolvePlane(constraints, agent.m_maxSpeed, agent.m_preferredVelocity, false, result);
+    if (lineFail < constraints.size())
+        SolveInfeasible(constraints, lineFail, agent.m_maxSpeed, result);
+
+    m_agents[index].m_newVelocity = result;
+}
+
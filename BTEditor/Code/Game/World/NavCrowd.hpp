@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Math/Vec2.hpp"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr int JOB_TYPE_CROWD = 996;
+
+class Actor;
+class NavCrowd;
+
+struct CrowdAgent
+{
+    Actor*  m_actor = nullptr;
+    Vec2    m_position;
+    Vec2    m_velocity;          // last frame, other agents assume it stays
+    Vec2    m_preferredVelocity;
+    Vec2    m_newVelocity;
+    float   m_radius = 0.5f;
+    float   m_maxSpeed = 0.0f;
+    bool    m_obstacle = false;  // does not move out of the way, others take full responsibility
+};
+
+struct CrowdConstraint
+{
+    Vec2    m_point;
+    Vec2    m_direction;         // permitted velocities lie on the left
+};
+
+typedef std::pair<float, int> CrowdNeighbor; // (distance squared, agent index)
+
+class CrowdAvoidanceJob : public Job
+{
+public:
+    CrowdAvoidanceJob(NavCrowd* crowd, int begin, int end);
+
+private:
+    virtual void Execute() override;
+    virtual void OnFinished() override;
+
+private:
+    NavCrowd* const m_crowd;
+    const int       m_begin;
+    const int       m_end;
+};
+
+// ORCA local avoidance for AI agents, neighbors come from a spatial hash rebuilt every frame
+class NavCrowd
+{
+    friend class CrowdAvoidanceJob;
+
+public:
+    NavCrowd();
+
+    void AddAgent(Actor* actor, const Vec2& preferredVelocity, float maxSpeed);
+    void AddObstacle(Actor* actor);
+
+    // picks collision free velocities for every agent added this frame and moves them
+    void Update(float deltaSeconds);
+
+private:
+    void BuildSpatialHash();
+    int  GetBucket(int cellX, int cellY) const;
+    void ComputeVelocities(int begin, int end);
+    void ComputeVelocity(int index, std::vector<CrowdNeighbor>& neighbors, std::vector<CrowdConstraint>& constraints);
+
+private:
+    std::vector<CrowdAgent>                m_agents;
+    std::unordered_map<const Actor*, Vec2> m_lastVelocities;
+
+    // spatial hash, agents of a bucket are packed between two bucket starts
+    std::vector<int>                       m_bucketStart;
+    std::vector<int>                       m_bucketAgents;
+    int                                    m_bucketMask = 0;
+
+    int                                    m_runningJobs = 0;
+    float                                  m_deltaSeconds = 0.0f;
+
+    float                                  m_neighborDist = 3.0f;
+    int                                    m_maxNeighbors = 10;
+    float                                  m_timeHorizon = 1.5f;
+    int                                    m_agentsPerJob = 64;
+};
+
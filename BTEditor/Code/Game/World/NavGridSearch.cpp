@@ -0,0 +1,312 @@
+#include "Game/World/NavGridSearch.hpp"
+
+#include "Game/World/NavMesh.hpp"
+
+#include <algorithm>
+#include <functional>
+
+constexpr int NAV_COST_STRAIGHT = 10;
+constexpr int NAV_COST_DIAGONAL = 14;
+
+NavGridSearch::NavGridSearch()
+{
+    m_open.reserve(256);
+}
+
+bool NavGridSearch::FindPath(const NavSnapshot& snapshot, const IntVec2& from, const IntVec2& goal, bool flying, bool diagonal, std::vector<IntVec2>& path)
+{
+    m_snapshot = &snapshot;
+    if (m_nodes.size() < m_snapshot->m_navmap.size())
+    {
+        m_nodes.clear();
+        m_nodes.resize(m_snapshot->m_navmap.size());
+        m_searchId = 0;
+    }
+
+    IntVec2 start = m_snapshot->m_start;
+    IntVec2 localFrom = from - start;
+
+    m_goal = goal - start;
+    m_flying = flying;
+    m_diagonal = diagonal;
+
+    if (!IsWalkable(localFrom.x, localFrom.y) || !IsWalkable(m_goal.x, m_goal.y))
+        return false;
+
+    // bump the search id instead of clearing the node pool
+    if (++m_searchId == 0)
+    {
+        for (NavSearchNode& node : m_nodes)
+            node.m_searchId = 0;
+        m_searchId = 1;
+    }
+    m_open.clear();
+
+    int startIdx = GetIndex(localFrom.x, localFrom.y);
+    int goalIdx = GetIndex(m_goal.x, m_goal.y);
+
+    NavSearchNode& startNode = GetNode(startIdx);
+    startNode.m_estimate = GetDistance(localFrom.x, localFrom.y, m_goal.x, m_goal.y);
+    PushOpen(startIdx, startNode.m_estimate);
+
+    bool found = false;
+    while (!m_open.empty())
+    {
+        int index = PopOpen();
+        if (index < 0)
+            break;
+
+        if (index == goalIdx)
+        {
+            found = true;
+            break;
+        }
+
+        IdentifySuccessors(index);
+    }
+
+    if (!found)
+        return false;
+
+    std::vector<int> jumpPoints;
+    for (int index = goalIdx; index != -1; index = m_nodes[index].m_parent)
+        jumpPoints.push_back(index);
+
+    // expand the jump points into single steps, segments are always straight or diagonal
+    path.push_back(from);
+    for (size_t i = jumpPoints.size() - 1; i > 0; i--)
+    {
+        IntVec2 current = IntVec2(jumpPoints[i] % m_snapshot->m_dimension.x, jumpPoints[i] / m_snapshot->m_dimension.x);
+        IntVec2 next = IntVec2(jumpPoints[i - 1] % m_snapshot->m_dimension.x, jumpPoints[i - 1] / m_snapshot->m_dimension.x);
+        IntVec2 step = IntVec2((next.x > current.x) - (next.x < current.x), (next.y > current.y) - (next.y < current.y));
+        while (current != next)
+        {
+            current += step;
+            path.push_back(current + start);
+        }
+    }
+    return true;
+}
+
+bool NavGridSearch::IsWalkable(int x, int y) const
+{
+    // same bounds as NavMesh2D::IsOutOfBounds, the outer ring is never walkable
+    if (x <= 0 || y <= 0 || x >= m_snapshot->m_dimension.x - 1 || y >= m_snapshot->m_dimension.y - 1)
+        return false;
+
+    char value = m_snapshot->m_navmap[x + y * m_snapshot->m_dimension.x];
+    return value == 0x00 || (m_flying && value == 0x02);
+}
+
+int NavGridSearch::GetIndex(int x, int y) const
+{
+    return x + y * m_snapshot->m_dimension.x;
+}
+
+int NavGridSearch::GetDistance(int x0, int y0, int x1, int y1) const
+{
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y1 - y0 : y0 - y1;
+
+    if (!m_diagonal)
+        return (dx + dy) * NAV_COST_STRAIGHT;
+
+    // octile distance
+    return dx > dy
+        ? dy * NAV_COST_DIAGONAL + (dx - dy) * NAV_COST_STRAIGHT
+        : dx * NAV_COST_DIAGONAL + (dy - dx) * NAV_COST_STRAIGHT;
+}
+
+NavSearchNode& NavGridSearch::GetNode(int index)
+{
+    NavSearchNode& node = m_nodes[index];
+    if (node.m_searchId != m_searchId)
+    {
+        node.m_cost = 0;
+        node.m_estimate = 0;
+        node.m_parent = -1;
+        node.m_closed = false;
+        node.m_searchId = m_searchId;
+    }
+    return node;
+}
+
+void NavGridSearch::PushOpen(int index, int estimate)
+{
+    m_open.push_back(OpenEntry(estimate, index));
+    std::push_heap(m_open.begin(), m_open.end(), std::greater<OpenEntry>());
+}
+
+int NavGridSearch::PopOpen()
+{
+    // entries are never decreased in place, skip the outdated duplicates
+    while (!m_open.empty())
+    {
+        std::pop_heap(m_open.begin(), m_open.end(), std::greater<OpenEntry>());
+        OpenEntry entry = m_open.back();
+        m_open.pop_back();
+
+        NavSearchNode& node = GetNode(entry.second);
+        if (node.m_closed || node.m_estimate != entry.first)
+            continue;
+
+        node.m_closed = true;
+        return entry.second;
+    }
+    return -1;
+}
+
+void NavGridSearch::IdentifySuccessors(int index)
+{
+    int x = index % m_snapshot->m_dimension.x;
+    int y = index / m_snapshot->m_dimension.x;
+    int parent = m_nodes[index].m_parent;
+
+    if (parent < 0)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if (dx == 0 && dy == 0)
+                    continue;
+                if (dx != 0 && dy != 0 && (!m_diagonal || !IsWalkable(x + dx, y) || !IsWalkable(x, y + dy)))
+                    continue;
+                AddSuccessor(index, x, y, dx, dy);
+            }
+        }
+        return;
+    }
+
+    int px = parent % m_snapshot->m_dimension.x;
+    int py = parent / m_snapshot->m_dimension.x;
+    int dx = (x > px) - (x < px);
+    int dy = (y > py) - (y < py);
+
+    // pruned neighbours, diagonal moves never cut corners
+    if (!m_diagonal)
+    {
+        if (dx != 0)
+        {
+            AddSuccessor(index, x, y, dx, 0);
+            AddSuccessor(index, x, y, 0, 1);
+            AddSuccessor(index, x, y, 0, -1);
+        }
+        else
+        {
+            AddSuccessor(index, x, y, 0, dy);
+            AddSuccessor(index, x, y, 1, 0);
+            AddSuccessor(index, x, y, -1, 0);
+        }
+    }
+    else if (dx != 0 && dy != 0)
+    {
+        bool walkableX = IsWalkable(x + dx, y);
+        bool walkableY = IsWalkable(x, y + dy);
+        if (walkableY)
+            AddSuccessor(index, x, y, 0, dy);
+        if (walkableX)
+            AddSuccessor(index, x, y, dx, 0);
+        if (walkableX && walkableY)
+            AddSuccessor(index, x, y, dx, dy);
+    }
+    else if (dx != 0)
+    {
+        bool walkableNext = IsWalkable(x + dx, y);
+        bool walkableUp = IsWalkable(x, y + 1);
+        bool walkableDown = IsWalkable(x, y - 1);
+        if (walkableNext)
+        {
+            AddSuccessor(index, x, y, dx, 0);
+            if (walkableUp)
+                AddSuccessor(index, x, y, dx, 1);
+            if (walkableDown)
+                AddSuccessor(index, x, y, dx, -1);
+        }
+        if (walkableUp)
+            AddSuccessor(index, x, y, 0, 1);
+        if (walkableDown)
+            AddSuccessor(index, x, y, 0, -1);
+    }
+    else
+    {
+        bool walkableNext = IsWalkable(x, y + dy);
+        bool walkableRight = IsWalkable(x + 1, y);
+        bool walkableLeft = IsWalkable(x - 1, y);
+        if (walkableNext)
+        {
+            AddSuccessor(index, x, y, 0, dy);
+            if (walkableRight)
+                AddSuccessor(index, x, y, 1, dy);
+            if (walkableLeft)
+                AddSuccessor(index, x, y, -1, dy);
+        }
+        if (walkableRight)
+            AddSuccessor(index, x, y, 1, 0);
+        if (walkableLeft)
+            AddSuccessor(index, x, y, -1, 0);
+    }
+}
+
+void NavGridSearch::AddSuccessor(int index, int x, int y, int dx, int dy)
+{
+    int jumpPoint = Jump(x + dx, y + dy, dx, dy);
+    if (jumpPoint < 0)
+        return;
+
+    NavSearchNode& node = GetNode(jumpPoint);
+    if (node.m_closed)
+        return;
+
+    int jx = jumpPoint % m_snapshot->m_dimension.x;
+    int jy = jumpPoint / m_snapshot->m_dimension.x;
+    int cost = m_nodes[index].m_cost + GetDistance(x, y, jx, jy);
+
+    if (node.m_parent >= 0 && node.m_cost <= cost)
+        return;
+
+    node.m_cost = cost;
+    node.m_estimate = cost + GetDistance(jx, jy, m_goal.x, m_goal.y);
+    node.m_parent = index;
+    PushOpen(jumpPoint, node.m_estimate);
+}
+
+int NavGridSearch::Jump(int x, int y, int dx, int dy) const
+{
+    while (true)
+    {
+        if (!IsWalkable(x, y))
+            return -1;
+
+        if (x == m_goal.x && y == m_goal.y)
+            return GetIndex(x, y);
+
+        if (dx != 0 && dy != 0)
+        {
+            // diagonal jump stops where a straight jump finds something
+            if (Jump(x + dx, y, dx, 0) >= 0 || Jump(x, y + dy, 0, dy) >= 0)
+                return GetIndex(x, y);
+
+            if (!IsWalkable(x + dx, y) || !IsWalkable(x, y + dy))
+                return -1;
+        }
+        else if (dx != 0)
+        {
+            if ((IsWalkable(x, y - 1) && !IsWalkable(x - dx, y - 1)) || (IsWalkable(x, y + 1) && !IsWalkable(x - dx, y + 1)))
+                return GetIndex(x, y);
+        }
+        else
+        {
+            if ((IsWalkable(x - 1, y) && !IsWalkable(x - 1, y - dy)) || (IsWalkable(x + 1, y) && !IsWalkable(x + 1, y - dy)))
+                return GetIndex(x, y);
+
+            // 4-connected search has to look sideways while moving vertically
+            if (!m_diagonal && (Jump(x + 1, y, 1, 0) >= 0 || Jump(x - 1, y, -1, 0) >= 0))
+                return GetIndex(x, y);
+        }
+
+        x += dx;
+        y += dy;
+    }
+}
+
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Engine/Math/IntVec2.hpp"
+
+#include <vector>
+#include <utility>
+
+struct NavSnapshot;
+
+struct NavSearchNode
+{
+    int          m_cost     = 0;  // accumulated cost, 10 per straight step and 14 per diagonal step
+    int          m_estimate = 0;  // cost + heuristic
+    int          m_parent   = -1;
+    unsigned int m_searchId = 0;  // node is stale unless it matches the running search
+    bool         m_closed   = false;
+};
+
+// point to point A* with jump point search over a nav mesh snapshot, nodes and open list are reused between queries
+class NavGridSearch
+{
+public:
+    NavGridSearch();
+
+    bool FindPath(const NavSnapshot& snapshot, const IntVec2& from, const IntVec2& goal, bool flying, bool diagonal, std::vector<IntVec2>& path);
+
+private:
+    bool           IsWalkable(int x, int y) const;
+    int            GetIndex(int x, int y) const;
+    int            GetDistance(int x0, int y0, int x1, int y1) const;
+    NavSearchNode& GetNode(int index);
+
+    void PushOpen(int index, int estimate);
+    int  PopOpen();
+
+    void IdentifySuccessors(int index);
+    void AddSuccessor(int index, int x, int y, int dx, int dy);
+    int  Jump(int x, int y, int dx, int dy) const;
+
+private:
+    typedef std::pair<int, int> OpenEntry; // (estimate, node index)
+
+    const NavSnapshot*         m_snapshot = nullptr;
+    std::vector<NavSearchNode> m_nodes;
+    std::vector<OpenEntry>     m_open;
+    unsigned int               m_searchId = 0;
+
+    IntVec2                    m_goal;
+    bool                       m_flying   = false;
+    bool                       m_diagonal = true;
+};
+
@@ -0,0 +1,199 @@
+#include "Game/World/NavLayeredSearch.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+
+#include <algorithm>
+#include <functional>
+
+constexpr int NAV_COST_STEP   = 10;
+constexpr int NAV_COST_HEIGHT = 2; // extra cost per block climbed or dropped
+
+long long NavLayeredSnapshot::GetChunkKey(const ChunkCoords& coords)
+{
+    return ((long long)coords.x << 32) | (long long)(unsigned int)coords.y;
+}
+
+long long NavLayeredSnapshot::GetFloorKey(const WorldCoords& floor)
+{
+    return ((long long)(floor.x & 0x1FFFFF)) | ((long long)(floor.y & 0x1FFFFF) << 21) | ((long long)floor.z << 42);
+}
+
+const ChunkNav* NavLayeredSnapshot::FindChunkNav(const ChunkCoords& coords) const
+{
+    auto ite = m_chunks.find(GetChunkKey(coords));
+    return ite == m_chunks.end() ? nullptr : ite->second.get();
+}
+
+const NavSpan* NavLayeredSnapshot::FindSpan(const WorldCoords& floor) const
+{
+    const ChunkNav* nav = FindChunkNav(Chunk::GetChunkCoords(floor));
+    if (!nav)
+        return nullptr;
+
+    LocalCoords local = Chunk::GetLocalCoords(floor);
+    int span = nav->FindSpan(local.x, local.y, floor.z);
+    return span < 0 ? nullptr : nav->GetSpans(local.x, local.y) + span;
+}
+
+bool NavLayeredSnapshot::FindFloor(const WorldCoords& coords, WorldCoords& floor) const
+{
+    const ChunkNav* nav = FindChunkNav(Chunk::GetChunkCoords(coords));
+    if (!nav)
+        return false;
+
+    LocalCoords local = Chunk::GetLocalCoords(coords);
+    int span = nav->FindNearestSpan(local.x, local.y, coords.z);
+    if (span < 0)
+        return false;
+
+    floor = WorldCoords(coords.x, coords.y, nav->GetSpans(local.x, local.y)[span].m_floor);
+    return true;
+}
+
+int NavLayeredSnapshot::GetLinkedFloors(const WorldCoords& floor, WorldCoords linked[4]) const
+{
+    const NavSpan* span = FindSpan(floor);
+    if (!span)
+        return 0;
+
+    int count = 0;
+    for (BlockFace face : CHUNK_NEIGHBORS)
+    {
+        unsigned char link = span->m_links[face];
+        if (link == NAV_NO_LINK)
+            continue;
+
+        // links crossing a chunk border are only set while the neighbor is loaded
+        IntVec2 offset = Block::GetOffset2ByFace(face);
+        WorldCoords next = WorldCoords(floor.x + offset.x, floor.y + offset.y, 0);
+        const ChunkNav* nav = FindChunkNav(Chunk::GetChunkCoords(next));
+        if (!nav)
+            continue;
+
+        LocalCoords local = Chunk::GetLocalCoords(next);
+        if (link >= nav->GetSpanCount(local.x, local.y))
+            continue;
+        next.z = nav->GetSpans(local.x, local.y)[link].m_floor;
+        linked[count++] = next;
+    }
+    return count;
+}
+
+NavLayeredSearch::NavLayeredSearch()
+{
+    m_maxNodes = g_gameConfigBlackboard.GetValue("navLayeredSearchNodes", m_maxNodes);
+    m_nodes.reserve(256);
+    m_open.reserve(256);
+}
+
+bool NavLayeredSearch::FindPath(const NavLayeredSnapshot& snapshot, const WorldCoords& from, const WorldCoords& goal, std::vector<IntVec3>& path)
+{
+    m_snapshot = &snapshot;
+
+    WorldCoords start;
+    if (!m_snapshot->FindFloor(from, start) || !m_snapshot->FindFloor(goal, m_goal))
+        return false;
+
+    m_nodes.clear();
+    m_lookup.clear();
+    m_open.clear();
+
+    int startIdx = GetNode(start);
+    m_nodes[startIdx].m_estimate = GetDistance(start, m_goal);
+    PushOpen(startIdx, m_nodes[startIdx].m_estimate);
+
+    int goalIdx = -1;
+    while (!m_open.empty() && (int)m_nodes.size() < m_maxNodes)
+    {
+        int index = PopOpen();
+        if (index < 0)
+            break;
+
+        if (m_nodes[index].m_coords == m_goal)
+        {
+            goalIdx = index;
+            break;
+        }
+
+        AddSuccessors(index);
+    }
+
+    if (goalIdx < 0)
+        return false;
+
+    size_t first = path.size();
+    for (int index = goalIdx; index != -1; index = m_nodes[index].m_parent)
+        path.push_back(m_nodes[index].m_coords);
+    std::reverse(path.begin() + first, path.end());
+    return true;
+}
+
+int NavLayeredSearch::GetNode(const WorldCoords& coords)
+{
+    long long key = NavLayeredSnapshot::GetFloorKey(coords);
+    auto ite = m_lookup.find(key);
+    if (ite != m_lookup.end())
+        return ite->second;
+
+    int index = (int)m_nodes.size();
+    m_nodes.emplace_back();
+    m_nodes.back().m_coords = coords;
+    m_lookup[key] = index;
+    return index;
+}
+
+int NavLayeredSearch::GetDistance(const WorldCoords& a, const WorldCoords& b) const
+{
+    int dx = a.x > b.x ? a.x - b.x : b.x - a.x;
+    int dy = a.y > b.y ? a.y - b.y : b.y - a.y;
+    int dz = a.z > b.z ? a.z - b.z : b.z - a.z;
+    return (dx + dy) * NAV_COST_STEP + dz * NAV_COST_HEIGHT;
+}
+
+void NavLayeredSearch::PushOpen(int index, int estimate)
+{
+    m_open.push_back(OpenEntry(estimate, index));
+    std::push_heap(m_open.begin(), m_open.end(), std::greater<OpenEntry>());
+}
+
+int NavLayeredSearch::PopOpen()
+{
+    // entries are never decreased in place, skip the outdated duplicates
+    while (!m_open.empty())
+    {
+        std::pop_heap(m_open.begin(), m_open.end(), std::greater<OpenEntry>());
+        OpenEntry entry = m_open.back();
+        m_open.pop_back();
+
+        NavLayeredNode& node = m_nodes[entry.second];
+        if (node.m_closed || node.m_estimate != entry.first)
+            continue;
+
+        node.m_closed = true;
+        return entry.second;
+    }
+    return -1;
+}
+
+void NavLayeredSearch::AddSuccessors(int index)
+{
+    WorldCoords coords = m_nodes[index].m_coords;
+    WorldCoords linked[4];
+    int count = m_snapshot->GetLinkedFloors(coords, linked);
+
+    for (int i = 0; i < count; i++)
+    {
+        const WorldCoords& next = linked[i];
+        int cost = m_nodes[index].m_cost + GetDistance(coords, next);
+        int nextIdx = GetNode(next);
+        NavLayeredNode& node = m_nodes[nextIdx];
+        if (node.m_closed || (node.m_parent >= 0 && node.m_cost <= cost))
+            continue;
+
+        node.m_cost = cost;
+        node.m_estimate = cost + GetDistance(next, m_goal);
+        node.m_parent = index;
+        PushOpen(nextIdx, node.m_estimate);
+    }
+}
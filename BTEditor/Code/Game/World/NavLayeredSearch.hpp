@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+
+#include "Engine/Math/IntVec3.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+struct NavLayeredNode
+{
+    WorldCoords  m_coords;         // floor block of the span
+    int          m_cost     = 0;
+    int          m_estimate = 0;
+    int          m_parent   = -1;
+    bool         m_closed   = false;
+};
+
+// copies of the chunk spans under the nav mesh, path jobs and flow fields read these while the chunks change or unload
+// a copy is shared by every snapshot published while its chunk's spans stay the same
+struct NavLayeredSnapshot
+{
+    static long long GetChunkKey(const ChunkCoords& coords);
+    static long long GetFloorKey(const WorldCoords& floor);
+
+    const ChunkNav* FindChunkNav(const ChunkCoords& coords) const;
+    const NavSpan*  FindSpan(const WorldCoords& floor) const;
+    bool            FindFloor(const WorldCoords& coords, WorldCoords& floor) const; // span floor in the column of coords closest to its height
+    int             GetLinkedFloors(const WorldCoords& floor, WorldCoords linked[4]) const; // floors reachable in one step
+
+    std::unordered_map<long long, std::shared_ptr<const ChunkNav>> m_chunks; // by chunk key
+};
+
+// A* over the walkable spans of a layered snapshot, follows step links between floors
+class NavLayeredSearch
+{
+public:
+    NavLayeredSearch();
+
+    bool FindPath(const NavLayeredSnapshot& snapshot, const WorldCoords& from, const WorldCoords& goal, std::vector<IntVec3>& path);
+
+private:
+    int  GetNode(const WorldCoords& coords);
+    int  GetDistance(const WorldCoords& a, const WorldCoords& b) const;
+
+    void PushOpen(int index, int estimate);
+    int  PopOpen();
+
+    void AddSuccessors(int index);
+
+private:
+    typedef std::pair<int, int> OpenEntry; // (estimate, node index)
+
+    const NavLayeredSnapshot*          m_snapshot = nullptr;
+    std::vector<NavLayeredNode>        m_nodes;
+    std::unordered_map<long long, int> m_lookup;
+    std::vector<OpenEntry>             m_open;
+
+    WorldCoords                        m_goal;
+    int                                m_maxNodes = 8192;
+};
@@ -1,14 +1,46 @@
 #include "Game/World/NavMesh.hpp"
 
 #include "Game/World/ChunkProvider.hpp"
+#include "Game/World/NavLayeredSearch.hpp"
+#include "Game/World/NavPathRequest.hpp"
 
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
 
 #include "Game/Block/BlockDef.hpp"
 #include "Engine/Renderer/VertexBuffer.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 const IntVec2 DIRECTIONS_EWNS[4] = { IntVec2(1, 0), IntVec2(-1, 0), IntVec2(0, 1), IntVec2(0, -1) };
 
+constexpr int NAV_FLOW_FIELD_MIN_REQUESTS = 3;  // requests to the same goal within one nav rebuild before a flow field pays off
+constexpr unsigned char NAV_FLOW_FIELD_RANGE = 127;
+
+static inline int CountTrailingZeros(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#elif defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
 NavMesh2D::NavMesh2D(World* world, const IntVec3& origin, const IntVec2& dimension)
     : m_world(world)
     , m_origin(origin)
@@ -19,24 +51,37 @@ NavMesh2D::NavMesh2D(World* world, const IntVec3& origin, const IntVec2& dimensi
     m_navmap.resize(m_size);
     memset(&m_navmap[0], 0xFF, m_size);
 
+    m_bitwiseFlowField = g_gameConfigBlackboard.GetValue("navBitwiseFlowField", m_bitwiseFlowField);
+    m_rowWords = (m_dimension.x + 63) / 64;
+    m_walkBits.resize((size_t)m_rowWords * (size_t)m_dimension.y);
+    m_flyBits.resize((size_t)m_rowWords * (size_t)m_dimension.y);
+
     m_debugBuffer = new Vertex_PCU[m_size * 6];
     m_vbo = g_theRenderer->CreateVertexBuffer(m_size * 6 * sizeof(Vertex_PCU), &g_theRenderer->GetDefaultVF_PCU());
+
+    m_pathQueue = new NavPathQueue(this);
+
+    PublishSnapshot();
+    PublishLayeredSnapshot();
 }
 
 NavMesh2D::~NavMesh2D()
 {
+    delete m_pathQueue;
+    ClearSharedFlowFields(true, true);
     delete[] m_debugBuffer;
     delete m_vbo;
 }
 
 void NavMesh2D::BuildNav()
 {
-    memset(&m_navmap[0], 0xFF, m_size);
+    bool navChanged = false;
 
     int _i = 0;
     int z = m_origin.z;
     ChunkCoords coords = Chunk::GetChunkCoords(IntVec3(m_origin.x, m_origin.y, 0));
-    Chunk* chunk = m_world->FindChunk(coords);
+    // read only, a packed chunk answers from its palette and stays packed
+    const Chunk* chunk = m_world->FindChunk(coords);
     for (int j = m_origin.y - m_halfDimension.y; j <= m_origin.y + m_halfDimension.y; j++)
     {
         for (int i = m_origin.x - m_halfDimension.x; i <= m_origin.x + m_halfDimension.x; i++)
@@ -51,9 +96,10 @@ void NavMesh2D::BuildNav()
                 chunk = m_world->FindChunk(coords);
             }
 
-            const Block& block  = chunk ? chunk->GetBlock(Chunk::GetLocalCoords(IntVec3(i, j, z    ))) : Block::INVALID; 
-            const Block& head   = chunk ? chunk->GetBlock(Chunk::GetLocalCoords(IntVec3(i, j, z + 1))) : Block::INVALID; 
-            const Block& ground = chunk ? chunk->GetBlock(Chunk::GetLocalCoords(IntVec3(i, j, z - 1))) : Block::INVALID; 
+            LocalCoords local = Chunk::GetLocalCoords(IntVec3(i, j, z));
+            const Block& block  = chunk ? chunk->GetBlock(local                      ) : Block::INVALID;
+            const Block& head   = chunk ? chunk->GetBlock(local + LocalCoords(0, 0, 1)) : Block::INVALID;
+            const Block& ground = chunk ? chunk->GetBlock(local - LocalCoords(0, 0, 1)) : Block::INVALID;
 
             char& value = m_navmap[cnt];
 
@@ -61,7 +107,12 @@ void NavMesh2D::BuildNav()
             bool passable = valid && !block.IsSolid() && (!head.IsValid() || !head.IsSolid());
             bool solid = ground.IsValid() && ground.IsSolid();
 
-            value = valid ? passable ? solid ? 0x00 : 0x02 : 0x01 : 0xFF;
+            char newValue = valid ? passable ? solid ? 0x00 : 0x02 : 0x01 : (char)0xFF;
+            if (newValue != value)
+            {
+                value = newValue;
+                navChanged = true;
+            }
 
             Rgba8 color = valid ? passable ? solid ? Rgba8::GREEN : Rgba8::YELLOW : Rgba8::RED : Rgba8(255, 0, 255);
 
@@ -75,6 +126,38 @@ void NavMesh2D::BuildNav()
     }
 
     g_theRenderer->CopyCPUToGPU(&m_debugBuffer[0], m_size * 6 * sizeof(Vertex_PCU), m_vbo);
+
+    bool layeredChanged = PublishLayeredSnapshot();
+    ClearSharedFlowFields(navChanged, layeredChanged);
+
+    if (navChanged)
+    {
+        // cells on the outer ring count as out of bounds, same as IsOutOfBounds
+        std::fill(m_walkBits.begin(), m_walkBits.end(), 0);
+        std::fill(m_flyBits.begin(), m_flyBits.end(), 0);
+        for (int y = 1; y < m_dimension.y - 1; y++)
+        {
+            for (int x = 1; x < m_dimension.x - 1; x++)
+            {
+                char value = m_navmap[x + y * m_dimension.x];
+                uint64_t bit = 1ull << (x & 63);
+                size_t word = (size_t)(x >> 6) + (size_t)y * m_rowWords;
+                if (value == 0x00)
+                    m_walkBits[word] |= bit;
+                if (value == 0x00 || value == 0x02)
+                    m_flyBits[word] |= bit;
+            }
+        }
+    }
+
+    // path jobs in flight keep the old snapshot alive
+    if (navChanged)
+        PublishSnapshot();
+}
+
+void NavMesh2D::Update()
+{
+    m_pathQueue->Update();
 }
 
 void NavMesh2D::Render() const
@@ -110,6 +193,168 @@ bool NavMesh2D::QueryAccessible(const IntVec2& goal, bool flying)
     return (value == 0x00 || (flying && value == 0x02));
 }
 
+PathRequestHandle NavMesh2D::RequestPath(const WorldCoords& from, const WorldCoords& goal, bool flying, float priority, std::vector<IntVec3>& path)
+{
+    // hills, caves and upper floors are off the plane
+    bool layered = !IsOnNavPlane(from, flying) || !IsOnNavPlane(goal, flying);
+
+    NavSharedFlowField* shared = TrackSharedFlowField(goal, flying, layered);
+    if (shared)
+    {
+        if (shared->GetPath(from, path))
+            return INVALID_PATH_REQUEST;
+        path.clear();
+    }
+
+    return m_pathQueue->Submit(from, goal, flying, layered, priority);
+}
+
+bool NavMesh2D::QueryFloor(const WorldCoords& coords, WorldCoords& floor) const
+{
+    Chunk* chunk = m_world->FindChunk(Chunk::GetChunkCoords(coords));
+    if (!chunk)
+        return false;
+
+    LocalCoords local = Chunk::GetLocalCoords(coords);
+    int span = chunk->m_nav.FindNearestSpan(local.x, local.y, coords.z);
+    if (span < 0)
+        return false;
+
+    floor = WorldCoords(coords.x, coords.y, chunk->m_nav.GetSpans(local.x, local.y)[span].m_floor);
+    return true;
+}
+
+bool NavMesh2D::IsOnNavPlane(const WorldCoords& coords, bool flying)
+{
+    return coords.z == m_origin.z && QueryAccessible(IntVec2(coords.x, coords.y), flying);
+}
+
+NavPathQueue* NavMesh2D::GetPathQueue() const
+{
+    return m_pathQueue;
+}
+
+std::shared_ptr<const NavSnapshot> NavMesh2D::GetSnapshot() const
+{
+    return m_snapshot;
+}
+
+std::shared_ptr<const NavLayeredSnapshot> NavMesh2D::GetLayeredSnapshot() const
+{
+    return m_layeredSnapshot;
+}
+
+void NavMesh2D::PublishSnapshot()
+{
+    std::shared_ptr<NavSnapshot> snapshot = std::make_shared<NavSnapshot>();
+    snapshot->m_start = IntVec2(m_origin.x, m_origin.y) - m_halfDimension;
+    snapshot->m_dimension = m_dimension;
+    snapshot->m_navmap = m_navmap;
+    m_snapshot = snapshot;
+}
+
+bool NavMesh2D::PublishLayeredSnapshot()
+{
+    // spans change without the plane changing, so every rebuild checks the chunks under the mesh
+    // only chunks whose spans changed since the last snapshot are copied again
+    std::shared_ptr<NavLayeredSnapshot> snapshot = std::make_shared<NavLayeredSnapshot>();
+    bool changed = !m_layeredSnapshot;
+    ChunkCoords minCoords = Chunk::GetChunkCoords(IntVec3(m_origin.x - m_halfDimension.x, m_origin.y - m_halfDimension.y, 0));
+    ChunkCoords maxCoords = Chunk::GetChunkCoords(IntVec3(m_origin.x + m_halfDimension.x, m_origin.y + m_halfDimension.y, 0));
+    for (int y = minCoords.y; y <= maxCoords.y; y++)
+    {
+        for (int x = minCoords.x; x <= maxCoords.x; x++)
+        {
+            Chunk* chunk = m_world->FindChunk(ChunkCoords(x, y));
+            if (!chunk || !chunk->m_nav.IsBuilt())
+                continue;
+
+            long long key = NavLayeredSnapshot::GetChunkKey(ChunkCoords(x, y));
+            const ChunkNav* previous = m_layeredSnapshot ? m_layeredSnapshot->FindChunkNav(ChunkCoords(x, y)) : nullptr;
+            if (previous && previous->GetVersion() == chunk->m_nav.GetVersion())
+            {
+                snapshot->m_chunks[key] = m_layeredSnapshot->m_chunks.at(key);
+            }
+            else
+            {
+                snapshot->m_chunks[key] = std::make_shared<const ChunkNav>(chunk->m_nav);
+                changed = true;
+            }
+        }
+    }
+
+    // chunks that unloaded under the mesh
+    if (!changed && snapshot->m_chunks.size() != m_layeredSnapshot->m_chunks.size())
+        changed = true;
+
+    if (changed)
+        m_layeredSnapshot = snapshot;
+    return changed;
+}
+
+NavSharedFlowField* NavMesh2D::TrackSharedFlowField(const WorldCoords& goal, bool flying, bool layered)
+{
+    NavSharedFlowField* shared = nullptr;
+    for (NavSharedFlowField& entry : m_sharedFlowFields)
+    {
+        if (entry.m_goal == goal && entry.m_flying == flying && entry.m_layered == layered)
+        {
+            shared = &entry;
+            break;
+        }
+    }
+    if (!shared)
+    {
+        m_sharedFlowFields.emplace_back();
+        shared = &m_sharedFlowFields.back();
+        shared->m_goal = goal;
+        shared->m_flying = flying;
+        shared->m_layered = layered;
+    }
+    shared->m_requests++;
+
+    bool built = shared->m_flowfield || shared->m_layeredFlowField;
+    if (!built && shared->m_requests < NAV_FLOW_FIELD_MIN_REQUESTS)
+        return nullptr;
+
+    if (built)
+        return shared;
+
+    if (layered)
+        shared->m_layeredFlowField = new NavLayeredFlowField(m_layeredSnapshot, goal);
+    else
+        shared->m_flowfield = CreatePathfind(IntVec2(goal.x, goal.y), flying);
+    return shared;
+}
+
+void NavMesh2D::ClearSharedFlowFields(bool navChanged, bool layeredChanged)
+{
+    // forget goals nobody asked for since the last rebuild, and stale flow fields if their nav changed
+    for (size_t i = 0; i < m_sharedFlowFields.size();)
+    {
+        NavSharedFlowField& entry = m_sharedFlowFields[i];
+        bool stale = entry.m_layered ? layeredChanged : navChanged;
+        if (stale || entry.m_requests == 0)
+        {
+            delete entry.m_flowfield;
+            delete entry.m_layeredFlowField;
+            entry.m_flowfield = nullptr;
+            entry.m_layeredFlowField = nullptr;
+        }
+
+        if (entry.m_requests == 0)
+        {
+            m_sharedFlowFields[i] = m_sharedFlowFields.back();
+            m_sharedFlowFields.pop_back();
+        }
+        else
+        {
+            entry.m_requests = 0;
+            i++;
+        }
+    }
+}
+
 bool NavMesh2D::IsOutOfBounds(const IntVec2& coords) const
 {
     return coords.x >= m_origin.x + m_halfDimension.x
@@ -121,6 +366,14 @@ bool NavMesh2D::IsOutOfBounds(const IntVec2& coords) const
 NavMeshInst::NavMeshInst(NavMesh2D* mesh, const IntVec2& goal, bool flying)
     : m_navmesh(mesh)
     , m_flowmap(mesh->m_dimension)
+{
+    if (m_navmesh->m_bitwiseFlowField)
+        BuildFlowFieldBitwise(goal, flying);
+    else
+        BuildFlowFieldScalar(goal, flying);
+}
+
+void NavMeshInst::BuildFlowFieldScalar(const IntVec2& goal, bool flying)
 {
     IntVec2 origin = IntVec2{ m_navmesh->m_origin.x - m_navmesh->m_halfDimension.x, m_navmesh->m_origin.y - m_navmesh->m_halfDimension.y };
 
@@ -138,7 +391,7 @@ NavMeshInst::NavMeshInst(NavMesh2D* mesh, const IntVec2& goal, bool flying)
     IntVec2 start = IntVec2(m_navmesh->m_origin.x, m_navmesh->m_origin.y) - m_navmesh->m_halfDimension;
 
     // iterate step, limit to 127 blocks
-    for (unsigned char heat = 1; heat < 127; heat += 1)
+    for (unsigned char heat = 1; heat < NAV_FLOW_FIELD_RANGE; heat += 1)
     {
         modifiedCoords1.swap(modifiedCoords2);
         for (const IntVec2& coord : modifiedCoords2)
@@ -170,6 +423,75 @@ NavMeshInst::NavMeshInst(NavMesh2D* mesh, const IntVec2& goal, bool flying)
     }
 }
 
+void NavMeshInst::BuildFlowFieldBitwise(const IntVec2& goal, bool flying)
+{
+    IntVec2 origin = IntVec2{ m_navmesh->m_origin.x - m_navmesh->m_halfDimension.x, m_navmesh->m_origin.y - m_navmesh->m_halfDimension.y };
+    IntVec2 local = goal - origin;
+
+    const int words = m_navmesh->m_rowWords;
+    const int rows = m_navmesh->m_dimension.y;
+    const std::vector<uint64_t>& walkable = flying ? m_navmesh->m_flyBits : m_navmesh->m_walkBits;
+
+    std::vector<uint64_t> visited((size_t)words * (size_t)rows, 0);
+    std::vector<uint64_t> frontier((size_t)words * (size_t)rows, 0);
+    std::vector<uint64_t> next((size_t)words * (size_t)rows, 0);
+
+    m_flowmap.SetAllValues(0xFF);
+    m_flowmap.SetValue(local, 0);
+
+    if (local.x < 0 || local.y < 0 || local.x >= m_navmesh->m_dimension.x || local.y >= rows)
+        return;
+
+    size_t goalWord = (size_t)(local.x >> 6) + (size_t)local.y * words;
+    visited[goalWord] = frontier[goalWord] = 1ull << (local.x & 63);
+
+    // every wave expands the whole frontier with shifts and masks, then writes the new cells' distance
+    for (unsigned char heat = 1; heat < NAV_FLOW_FIELD_RANGE; heat += 1)
+    {
+        uint64_t any = 0;
+        for (int y = 0; y < rows; y++)
+        {
+            const uint64_t* row = &frontier[(size_t)y * words];
+            const uint64_t* rowSouth = y > 0 ? row - words : nullptr;
+            const uint64_t* rowNorth = y + 1 < rows ? row + words : nullptr;
+
+            for (int w = 0; w < words; w++)
+            {
+                // carry the edge bits across word boundaries
+                uint64_t fromWest = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+                uint64_t fromEast = (row[w] >> 1) | (w + 1 < words ? row[w + 1] << 63 : 0);
+                uint64_t fromSouth = rowSouth ? rowSouth[w] : 0;
+                uint64_t fromNorth = rowNorth ? rowNorth[w] : 0;
+
+                size_t index = (size_t)w + (size_t)y * words;
+                uint64_t reached = (fromWest | fromEast | fromSouth | fromNorth) & walkable[index] & ~visited[index];
+                next[index] = reached;
+                any |= reached;
+            }
+        }
+
+        if (!any)
+            return;
+
+        for (int y = 0; y < rows; y++)
+        {
+            for (int w = 0; w < words; w++)
+            {
+                size_t index = (size_t)w + (size_t)y * words;
+                uint64_t reached = next[index];
+                visited[index] |= reached;
+                while (reached)
+                {
+                    m_flowmap.SetValue(IntVec2((w << 6) + CountTrailingZeros(reached), y), heat);
+                    reached &= reached - 1;
+                }
+            }
+        }
+
+        frontier.swap(next);
+    }
+}
+
 bool NavMeshInst::GetPath(const IntVec2& from, std::vector<IntVec2>& path)
 {
     if (m_navmesh->IsOutOfBounds(from))
@@ -206,3 +528,88 @@ bool NavMeshInst::GetPath(const IntVec2& from, std::vector<IntVec2>& path)
     return true;
 }
 
+NavLayeredFlowField::NavLayeredFlowField(std::shared_ptr<const NavLayeredSnapshot> snapshot, const WorldCoords& goal)
+    : m_snapshot(snapshot)
+{
+    WorldCoords goalFloor;
+    if (!m_snapshot->FindFloor(goal, goalFloor))
+        return;
+
+    std::vector<WorldCoords> frontier;
+    std::vector<WorldCoords> next;
+    frontier.push_back(goalFloor);
+    m_heat[NavLayeredSnapshot::GetFloorKey(goalFloor)] = 0;
+
+    // breadth first over the step links, same range as the planar flow fields
+    for (unsigned char heat = 1; heat < NAV_FLOW_FIELD_RANGE && !frontier.empty(); heat += 1)
+    {
+        for (const WorldCoords& floor : frontier)
+        {
+            WorldCoords linked[4];
+            int count = m_snapshot->GetLinkedFloors(floor, linked);
+            for (int i = 0; i < count; i++)
+            {
+                if (m_heat.emplace(NavLayeredSnapshot::GetFloorKey(linked[i]), heat).second)
+                    next.push_back(linked[i]);
+            }
+        }
+        frontier.swap(next);
+        next.clear();
+    }
+}
+
+bool NavLayeredFlowField::GetPath(const WorldCoords& from, std::vector<IntVec3>& path) const
+{
+    WorldCoords floor;
+    if (!m_snapshot->FindFloor(from, floor))
+        return false;
+
+    unsigned char heat = GetHeat(floor);
+    if (heat == 0xFF)
+        return false;
+
+    path.push_back(floor);
+    while (heat != 0)
+    {
+        WorldCoords linked[4];
+        int count = m_snapshot->GetLinkedFloors(path.back(), linked);
+
+        WorldCoords step = path.back();
+        for (int i = 0; i < count; i++)
+        {
+            unsigned char newheat = GetHeat(linked[i]);
+            if (newheat < heat)
+            {
+                heat = newheat;
+                step = linked[i];
+            }
+        }
+
+        if (step == path.back())
+            return false;
+        else
+            path.push_back(step);
+    }
+    return true;
+}
+
+unsigned char NavLayeredFlowField::GetHeat(const WorldCoords& floor) const
+{
+    auto ite = m_heat.find(NavLayeredSnapshot::GetFloorKey(floor));
+    return ite == m_heat.end() ? 0xFF : ite->second;
+}
+
+bool NavSharedFlowField::GetPath(const WorldCoords& from, std::vector<IntVec3>& path) const
+{
+    if (m_layered)
+        return m_layeredFlowField->GetPath(from, path);
+
+    std::vector<IntVec2> planarPath;
+    if (!m_flowfield->GetPath(IntVec2(from.x, from.y), planarPath))
+        return false;
+
+    // planar goals sit on the mesh plane
+    for (const IntVec2& coords : planarPath)
+        path.push_back(IntVec3(coords.x, coords.y, m_goal.z));
+    return true;
+}
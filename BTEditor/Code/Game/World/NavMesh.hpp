@@ -8,9 +8,24 @@
 #include "Engine/Core/HeatMaps.hpp"
 
 #include <vector>
+#include <memory>
+#include <unordered_map>
 
 struct Vertex_PCU;
 class VertexBuffer;
+class NavPathQueue;
+struct NavLayeredSnapshot;
+
+typedef unsigned int PathRequestHandle;
+constexpr PathRequestHandle INVALID_PATH_REQUEST = 0;
+
+// immutable copy of the navmap handed to path jobs
+struct NavSnapshot
+{
+    IntVec2              m_start;     // world coords of the first cell
+    IntVec2              m_dimension;
+    std::vector<char>    m_navmap;
+};
 
 struct NavMeshInst
 {
@@ -19,12 +34,45 @@ public:
 
     bool GetPath(const IntVec2& from, std::vector<IntVec2>& path);
 
+private:
+    void BuildFlowFieldScalar(const IntVec2& goal, bool flying);
+    void BuildFlowFieldBitwise(const IntVec2& goal, bool flying);
+
 public:
     NavMesh2D * const    m_navmesh;
     CompressedHeatMap    m_flowmap;
     bool                 m_goalReachable = false;
 };
 
+// walking distances over the span floors of a layered snapshot, for goals or agents off the mesh plane
+struct NavLayeredFlowField
+{
+public:
+    NavLayeredFlowField(std::shared_ptr<const NavLayeredSnapshot> snapshot, const WorldCoords& goal);
+
+    bool GetPath(const WorldCoords& from, std::vector<IntVec3>& path) const;
+
+private:
+    unsigned char GetHeat(const WorldCoords& floor) const;
+
+public:
+    std::shared_ptr<const NavLayeredSnapshot>    m_snapshot;
+    std::unordered_map<long long, unsigned char> m_heat; // by floor key, unreached floors are missing
+};
+
+// flow field shared by every agent heading to the same goal
+struct NavSharedFlowField
+{
+    WorldCoords          m_goal;
+    bool                 m_flying = false;
+    bool                 m_layered = false;
+    int                  m_requests = 0;
+    NavMeshInst*         m_flowfield = nullptr;
+    NavLayeredFlowField* m_layeredFlowField = nullptr;
+
+    bool GetPath(const WorldCoords& from, std::vector<IntVec3>& path) const;
+};
+
 class NavMesh2D
 {
     friend struct NavMeshInst;
@@ -34,14 +82,30 @@ public:
     ~NavMesh2D();
 
     void BuildNav();
+    void Update();
     void Render() const;
 
     NavMeshInst* CreatePathfind(const IntVec2& goal, bool flying);
 
     bool QueryAccessible(const IntVec2& goal, bool flying);
 
+    // answers right away from a shared flow field when there is one, otherwise queues an async request
+    // agents and goals off the plane this mesh is built at are served over the chunk spans instead
+    PathRequestHandle RequestPath(const WorldCoords& from, const WorldCoords& goal, bool flying, float priority, std::vector<IntVec3>& path);
+
+    bool QueryFloor(const WorldCoords& coords, WorldCoords& floor) const;
+    bool IsOnNavPlane(const WorldCoords& coords, bool flying);
+
+    NavPathQueue* GetPathQueue() const;
+    std::shared_ptr<const NavSnapshot> GetSnapshot() const;
+    std::shared_ptr<const NavLayeredSnapshot> GetLayeredSnapshot() const;
+
 private:
     bool IsOutOfBounds(const IntVec2& coords) const;
+    void ClearSharedFlowFields(bool navChanged, bool layeredChanged);
+    NavSharedFlowField* TrackSharedFlowField(const WorldCoords& goal, bool flying, bool layered);
+    void PublishSnapshot();
+    bool PublishLayeredSnapshot();
 
 private:
     World * const        m_world;
@@ -53,5 +117,18 @@ private:
     size_t               m_size;
 
     std::vector<char>    m_navmap;
+
+    // walkability as row bitboards, 64 cells per word, for the wavefront kernel
+    bool                  m_bitwiseFlowField = true;
+    int                   m_rowWords = 0;
+    std::vector<uint64_t> m_walkBits;
+    std::vector<uint64_t> m_flyBits;
+
+    NavPathQueue*        m_pathQueue = nullptr;
+
+    std::shared_ptr<const NavSnapshot> m_snapshot;
+    std::shared_ptr<const NavLayeredSnapshot> m_layeredSnapshot;
+
+    std::vector<NavSharedFlowField> m_sharedFlowFields;
 };
 
@@ -0,0 +1,195 @@
+#include "Game/World/NavPathRequest.hpp"
+
+#include "Game/World/NavGridSearch.hpp"
+#include "Game/World/NavLayeredSearch.hpp"
+
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/NamedStrings.hpp"
+
+#include <algorithm>
+
+PathRequestJob::PathRequestJob(NavPathQueue* queue, PathRequest* request) : Job(JOB_TYPE_PATHFIND)
+    , m_queue(queue)
+    , m_request(request)
+{
+}
+
+void PathRequestJob::Execute()
+{
+    // one node pool per worker, reused by every request that lands on it
+    thread_local NavGridSearch search;
+    thread_local NavLayeredSearch layeredSearch;
+    thread_local std::vector<IntVec2> planarPath;
+
+    if (m_request->m_layered)
+    {
+        m_request->m_success = layeredSearch.FindPath(*m_request->m_layeredSnapshot, m_request->m_from, m_request->m_goal, m_request->m_path);
+        return;
+    }
+
+    // the whole snapshot is searched here, range limits only matter on the main thread
+    planarPath.clear();
+    m_request->m_success = search.FindPath(*m_request->m_snapshot, IntVec2(m_request->m_from.x, m_request->m_from.y), IntVec2(m_request->m_goal.x, m_request->m_goal.y), m_request->m_flying, m_queue->m_diagonalPaths, planarPath);
+
+    // planar requests start and end on the mesh plane
+    for (const IntVec2& coords : planarPath)
+        m_request->m_path.push_back(IntVec3(coords.x, coords.y, m_request->m_goal.z));
+}
+
+void PathRequestJob::OnFinished()
+{
+    m_queue->OnRequestFinished(m_request);
+}
+
+NavPathQueue::NavPathQueue(NavMesh2D* mesh)
+    : m_navmesh(mesh)
+{
+    m_maxJobs = g_gameConfigBlackboard.GetValue("navPathJobs", m_maxJobs);
+    m_diagonalPaths = g_gameConfigBlackboard.GetValue("navDiagonalPaths", m_diagonalPaths);
+}
+
+NavPathQueue::~NavPathQueue()
+{
+    while (!m_running.empty())
+    {
+        g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_PATHFIND);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (PathRequest* request : m_waiting)
+        delete request;
+}
+
+PathRequestHandle NavPathQueue::Submit(const WorldCoords& from, const WorldCoords& goal, bool flying, bool layered, float priority)
+{
+    PathRequestHandle handle = m_nextHandle++;
+    if (m_nextHandle == INVALID_PATH_REQUEST)
+        m_nextHandle++;
+
+    // same query already queued or running, share its result
+    for (std::vector<PathRequest*>* list : { &m_waiting, &m_running })
+    {
+        for (PathRequest* request : *list)
+        {
+            if (request->m_from == from && request->m_goal == goal && request->m_flying == flying && request->m_layered == layered)
+            {
+                request->m_handles.push_back(handle);
+                request->m_priority = request->m_priority > priority ? request->m_priority : priority;
+                return handle;
+            }
+        }
+    }
+
+    PathRequest* request = new PathRequest();
+    request->m_from = from;
+    request->m_goal = goal;
+    request->m_flying = flying;
+    request->m_layered = layered;
+    request->m_priority = priority;
+    request->m_handles.push_back(handle);
+    m_waiting.push_back(request);
+    return handle;
+}
+
+void NavPathQueue::Cancel(PathRequestHandle handle)
+{
+    if (handle == INVALID_PATH_REQUEST)
+        return;
+
+    m_completed.erase(handle);
+
+    for (std::vector<PathRequest*>* list : { &m_waiting, &m_running })
+    {
+        for (PathRequest* request : *list)
+        {
+            auto ite = std::find(request->m_handles.begin(), request->m_handles.end(), handle);
+            if (ite != request->m_handles.end())
+            {
+                request->m_handles.erase(ite);
+                return;
+            }
+        }
+    }
+}
+
+bool NavPathQueue::IsPending(PathRequestHandle handle) const
+{
+    for (const std::vector<PathRequest*>* list : { &m_waiting, &m_running })
+        for (const PathRequest* request : *list)
+            if (std::find(request->m_handles.begin(), request->m_handles.end(), handle) != request->m_handles.end())
+                return true;
+    return false;
+}
+
+bool NavPathQueue::Poll(PathRequestHandle handle, std::vector<IntVec3>& path, bool& success)
+{
+    auto ite = m_completed.find(handle);
+    if (ite == m_completed.end())
+        return false;
+
+    success = ite->second.m_success;
+    path.swap(ite->second.m_path);
+    m_completed.erase(ite);
+    return true;
+}
+
+void NavPathQueue::Update()
+{
+    // completion queue, OnFinished runs here on the main thread
+    g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_PATHFIND);
+
+    // drop requests everyone gave up on before they cost a job
+    for (size_t i = 0; i < m_waiting.size();)
+    {
+        if (m_waiting[i]->m_handles.empty())
+        {
+            delete m_waiting[i];
+            m_waiting[i] = m_waiting.back();
+            m_waiting.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (m_waiting.empty() || (int)m_running.size() >= m_maxJobs)
+        return;
+
+    std::stable_sort(m_waiting.begin(), m_waiting.end(), [](const PathRequest* a, const PathRequest* b)
+        {
+            return a->m_priority > b->m_priority;
+        });
+
+    size_t dispatched = 0;
+    std::shared_ptr<const NavSnapshot> snapshot = m_navmesh->GetSnapshot();
+    std::shared_ptr<const NavLayeredSnapshot> layeredSnapshot = m_navmesh->GetLayeredSnapshot();
+    while (dispatched < m_waiting.size() && (int)m_running.size() < m_maxJobs)
+    {
+        PathRequest* request = m_waiting[dispatched++];
+        if (request->m_layered)
+            request->m_layeredSnapshot = layeredSnapshot;
+        else
+            request->m_snapshot = snapshot;
+        m_running.push_back(request);
+        g_theJobSystem->QueueJob(new PathRequestJob(this, request));
+    }
+    m_waiting.erase(m_waiting.begin(), m_waiting.begin() + dispatched);
+}
+
+void NavPathQueue::OnRequestFinished(PathRequest* request)
+{
+    auto ite = std::find(m_running.begin(), m_running.end(), request);
+    if (ite != m_running.end())
+        m_running.erase(ite);
+
+    for (PathRequestHandle handle : request->m_handles)
+    {
+        PathResult& result = m_completed[handle];
+        result.m_success = request->m_success;
+        result.m_path = request->m_path;
+    }
+
+    delete request;
+}
+
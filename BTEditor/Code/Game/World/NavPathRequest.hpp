@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Game/World/NavMesh.hpp"
+
+#include "Engine/Core/JobSystem.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+constexpr int JOB_TYPE_PATHFIND = 997;
+
+class NavPathQueue;
+
+struct PathRequest
+{
+    WorldCoords                               m_from;
+    WorldCoords                               m_goal;
+    bool                                      m_flying = false;
+    bool                                      m_layered = false; // searched over the chunk spans instead of the plane
+    float                                     m_priority = 0.0f;
+    std::vector<PathRequestHandle>            m_handles; // every submitter sharing this request
+    std::shared_ptr<const NavSnapshot>        m_snapshot;
+    std::shared_ptr<const NavLayeredSnapshot> m_layeredSnapshot;
+
+    bool                                      m_success = false;
+    std::vector<IntVec3>                      m_path;
+};
+
+struct PathResult
+{
+    bool                 m_success = false;
+    std::vector<IntVec3> m_path;
+};
+
+class PathRequestJob : public Job
+{
+public:
+    PathRequestJob(NavPathQueue* queue, PathRequest* request);
+
+private:
+    virtual void Execute() override;
+    virtual void OnFinished() override;
+
+private:
+    NavPathQueue* const  m_queue;
+    PathRequest* const   m_request;
+};
+
+// deduplicated, prioritized path requests solved on job workers
+class NavPathQueue
+{
+    friend class PathRequestJob;
+
+public:
+    NavPathQueue(NavMesh2D* mesh);
+    ~NavPathQueue();
+
+    PathRequestHandle Submit(const WorldCoords& from, const WorldCoords& goal, bool flying, bool layered, float priority);
+    void              Cancel(PathRequestHandle handle);
+    bool              IsPending(PathRequestHandle handle) const;
+    bool              Poll(PathRequestHandle handle, std::vector<IntVec3>& path, bool& success);
+
+    void Update();
+
+private:
+    void OnRequestFinished(PathRequest* request);
+
+private:
+    NavMesh2D * const                        m_navmesh;
+    std::vector<PathRequest*>                m_waiting;
+    std::vector<PathRequest*>                m_running;
+    std::map<PathRequestHandle, PathResult>  m_completed;
+    PathRequestHandle                        m_nextHandle = INVALID_PATH_REQUEST + 1;
+    int                                      m_maxJobs = 8;
+    bool                                     m_diagonalPaths = true; // 8-connected grid search, 4-connected follows flow field moves
+};
+
@@ -0,0 +1,75 @@
+#include "Game/World/PalettedBlocks.hpp"
+
+#include <cstring>
+#include <unordered_map>
+
+static_assert(sizeof(Block) == sizeof(uint32_t), "block state is hashed as one word");
+
+static inline uint32_t GetBlockBits(const Block& block)
+{
+	uint32_t bits;
+	memcpy(&bits, &block, sizeof(bits));
+	return bits;
+}
+
+void PalettedBlocks::Pack(const Block* blocks, int count)
+{
+	Clear();
+	m_count = count;
+
+	// the palette holds whole states (id, light, flags) so reads can hand out a reference
+	std::vector<uint16_t> indices((size_t)count);
+	std::unordered_map<uint32_t, int> lookup;
+	for (int i = 0; i < count; i++)
+	{
+		auto result = lookup.emplace(GetBlockBits(blocks[i]), (int)m_palette.size());
+		if (result.second)
+			m_palette.push_back(blocks[i]);
+		indices[i] = (uint16_t)result.first->second;
+	}
+
+	m_bits = 0;
+	while ((1 << m_bits) < (int)m_palette.size())
+		m_bits = m_bits == 0 ? 1 : m_bits * 2;
+	if (m_bits == 0)
+		return;
+
+	m_shift = 0;
+	while ((32 >> m_shift) > m_bits)
+		m_shift++;
+
+	int perWord = 1 << m_shift;
+	m_words.assign((size_t)((count + perWord - 1) / perWord), 0u);
+	for (int i = 0; i < count; i++)
+		m_words[i >> m_shift] |= (uint32_t)indices[i] << ((i & (perWord - 1)) * m_bits);
+}
+
+void PalettedBlocks::Unpack(Block* blocks) const
+{
+	if (m_bits == 0)
+	{
+		for (int i = 0; i < m_count; i++)
+			blocks[i] = m_palette[0];
+		return;
+	}
+
+	for (int i = 0; i < m_count; i++)
+		blocks[i] = m_palette[GetPaletteIndex(i)];
+}
+
+void PalettedBlocks::Clear()
+{
+	m_palette.clear();
+	m_palette.shrink_to_fit();
+	m_words.clear();
+	m_words.shrink_to_fit();
+	m_bits = 0;
+	m_shift = 0;
+	m_count = 0;
+}
+
+size_t PalettedBlocks::GetMemoryUsage() const
+{
+	return m_palette.capacity() * sizeof(Block) + m_words.capacity() * sizeof(uint32_t);
+}
+
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Game/Block/Block.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// blocks as indices into a palette of distinct block states, packed at 0/1/2/4/8/16 bits per block
+class PalettedBlocks
+{
+public:
+	void Pack(const Block* blocks, int count);
+	void Unpack(Block* blocks) const;
+	void Clear();
+
+	inline const Block& Get(int index) const;
+	bool   IsEmpty() const { return m_palette.empty(); }
+	int    GetBitsPerBlock() const { return m_bits; }
+	size_t GetMemoryUsage() const;
+
+private:
+	inline int GetPaletteIndex(int index) const;
+
+private:
+	std::vector<Block>    m_palette;
+	std::vector<uint32_t> m_words;        // entries never straddle two words
+	int                   m_bits = 0;     // 0 when every block shares one state
+	int                   m_shift = 0;    // log2 of entries per word
+	int                   m_count = 0;
+};
+
+
+//------------------------------------------------------------------------------------------------
+const Block& PalettedBlocks::Get(int index) const
+{
+	return m_palette[GetPaletteIndex(index)];
+}
+
+int PalettedBlocks::GetPaletteIndex(int index) const
+{
+	if (m_bits == 0)
+		return 0;
+
+	uint32_t word = m_words[index >> m_shift];
+	int offset = (index & ((1 << m_shift) - 1)) * m_bits;
+	return (int)((word >> offset) & ((1u << m_bits) - 1));
+}
+
@@ -0,0 +1,327 @@
+#include "Game/World/RaycastBatch.hpp"
+
+#include "Game/World/ChunkProvider.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// DDA state of one packet, every array holds one entry per lane
+struct RaycastPacket
+{
+	int    m_ray[RAYCAST_PACKET_LANES];
+	Chunk* m_chunk[RAYCAST_PACKET_LANES];
+	bool   m_active[RAYCAST_PACKET_LANES];
+	int    m_cell[3][RAYCAST_PACKET_LANES]; // local x and y, z
+	int    m_step[3][RAYCAST_PACKET_LANES];
+	float  m_distPer[3][RAYCAST_PACKET_LANES];
+	float  m_distNext[3][RAYCAST_PACKET_LANES];
+	float  m_maxDist[RAYCAST_PACKET_LANES];
+	int    m_axis[RAYCAST_PACKET_LANES];
+	float  m_dist[RAYCAST_PACKET_LANES];
+};
+
+// neighboring packets mostly start in the same chunk, remember the last lookup
+struct RaycastChunkCache
+{
+	const ChunkProvider* m_chunkProvider = nullptr;
+	ChunkCoords          m_coords;
+	Chunk*               m_chunk = nullptr;
+	bool                 m_valid = false;
+
+	Chunk* Find(const ChunkCoords& coords)
+	{
+		if (!m_valid || coords != m_coords)
+		{
+			m_coords = coords;
+			m_chunk = m_chunkProvider->FindLoadedChunk(coords);
+			m_valid = true;
+		}
+		return m_chunk;
+	}
+};
+
+static int GetPacketBlockIndex(const RaycastPacket& packet, int lane)
+{
+	return Chunk::GetIndex(LocalCoords(packet.m_cell[0][lane], packet.m_cell[1][lane], packet.m_cell[2][lane]));
+}
+
+static bool IsPacketCellInChunk(const RaycastPacket& packet, int lane)
+{
+	return packet.m_cell[2][lane] >= 0 && packet.m_cell[2][lane] <= (int)CHUNK_MAX_Z;
+}
+
+// air sections cannot stop the ray, take every crossing that stays inside at once
+// returns false when the ray ends inside the section
+static bool SkipEmptySection(RaycastPacket& packet, int lane)
+{
+	if (!IsPacketCellInChunk(packet, lane))
+		return true;
+	if (!packet.m_chunk[lane]->GetSection(Chunk::GetSectionIndex(GetPacketBlockIndex(packet, lane))).IsEmpty())
+		return true;
+
+	int z = packet.m_cell[2][lane];
+	int sectionMinZ = z & ~(int)(CHUNK_SECTION_SIZE_Z - 1);
+	int cells[3];
+	cells[0] = packet.m_step[0][lane] > 0 ? (int)CHUNK_MAX_X - packet.m_cell[0][lane] : packet.m_cell[0][lane];
+	cells[1] = packet.m_step[1][lane] > 0 ? (int)CHUNK_MAX_Y - packet.m_cell[1][lane] : packet.m_cell[1][lane];
+	cells[2] = packet.m_step[2][lane] > 0 ? sectionMinZ + (int)CHUNK_SECTION_SIZE_Z - 1 - z : z - sectionMinZ;
+
+	float exitDist = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float distOfNext = packet.m_distNext[axis][lane];
+		float exit = cells[axis] > 0 ? distOfNext + (float)cells[axis] * packet.m_distPer[axis][lane] : distOfNext;
+		exitDist = (axis == 0 || exit < exitDist) ? exit : exitDist;
+	}
+	if (exitDist >= packet.m_maxDist[lane])
+		return false;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// axes the ray does not move along keep their infinite crossing distance
+		float distOfNext = packet.m_distNext[axis][lane];
+		if (distOfNext >= exitDist)
+			continue;
+		int steps = (int)ceilf((exitDist - distOfNext) / packet.m_distPer[axis][lane]);
+		steps = steps < cells[axis] ? steps : cells[axis];
+		packet.m_cell[axis][lane] += steps * packet.m_step[axis][lane];
+		packet.m_distNext[axis][lane] += (float)steps * packet.m_distPer[axis][lane];
+	}
+	return true;
+}
+
+// moves the lane one cell along its picked axis, hopping to the neighbor chunk at the border
+static void StepPacketLane(RaycastPacket& packet, int lane)
+{
+	int axis = packet.m_axis[lane];
+	int& cell = packet.m_cell[axis][lane];
+	cell += packet.m_step[axis][lane];
+	packet.m_distNext[axis][lane] += packet.m_distPer[axis][lane];
+
+	if (axis == 0 && cell > (int)CHUNK_MAX_X)
+	{
+		cell = 0;
+		packet.m_chunk[lane] = packet.m_chunk[lane]->m_neighbors[BLOCK_FACE_NORTH];
+	}
+	else if (axis == 0 && cell < 0)
+	{
+		cell = (int)CHUNK_MAX_X;
+		packet.m_chunk[lane] = packet.m_chunk[lane]->m_neighbors[BLOCK_FACE_SOUTH];
+	}
+	else if (axis == 1 && cell > (int)CHUNK_MAX_Y)
+	{
+		cell = 0;
+		packet.m_chunk[lane] = packet.m_chunk[lane]->m_neighbors[BLOCK_FACE_WEST];
+	}
+	else if (axis == 1 && cell < 0)
+	{
+		cell = (int)CHUNK_MAX_Y;
+		packet.m_chunk[lane] = packet.m_chunk[lane]->m_neighbors[BLOCK_FACE_EAST];
+	}
+}
+
+RaycastBatchJob::RaycastBatchJob(RaycastBatch* batch, const ChunkProvider* chunkProvider, int begin, int end) : Job(JOB_TYPE_RAYCAST)
+	, m_batch(batch)
+	, m_chunkProvider(chunkProvider)
+	, m_begin(begin)
+	, m_end(end)
+{
+}
+
+void RaycastBatchJob::Execute()
+{
+	m_batch->Trace(m_chunkProvider, m_begin, m_end);
+}
+
+void RaycastBatchJob::OnFinished()
+{
+	m_batch->m_runningJobs--;
+}
+
+void RaycastBatch::Clear()
+{
+	m_from.clear();
+	m_to.clear();
+	m_hitDistance.clear();
+	m_hitNormal.clear();
+	m_hitBlock.clear();
+	m_order.clear();
+	m_sortKeys.clear();
+}
+
+void RaycastBatch::Reserve(int rayCount)
+{
+	m_from.reserve(rayCount);
+	m_to.reserve(rayCount);
+	m_hitDistance.reserve(rayCount);
+	m_hitNormal.reserve(rayCount);
+	m_hitBlock.reserve(rayCount);
+	m_order.reserve(rayCount);
+	m_sortKeys.reserve(rayCount);
+}
+
+int RaycastBatch::AddRay(const Vec3& fromPosition, const Vec3& toPosition)
+{
+	m_from.push_back(fromPosition);
+	m_to.push_back(toPosition);
+	m_hitDistance.push_back(-1.0f);
+	m_hitNormal.push_back(Vec3());
+	m_hitBlock.push_back(BlockIterator());
+	return (int)m_from.size() - 1;
+}
+
+RaycastResult3D RaycastBatch::GetResult(int ray) const
+{
+	if (!DidHit(ray))
+		return RaycastResult3D();
+
+	Vec3 forwardNormal = (m_to[ray] - m_from[ray]).GetNormalized();
+	return RaycastResult3D(m_hitDistance[ray], m_from[ray] + forwardNormal * m_hitDistance[ray], m_hitNormal[ray]);
+}
+
+void RaycastBatch::SortRays()
+{
+	// start chunk first, then the direction octant, so a packet walks the same chunks the same way
+	int rayCount = GetRayCount();
+	m_order.resize(rayCount);
+	m_sortKeys.resize(rayCount);
+	for (int ray = 0; ray < rayCount; ray++)
+	{
+		ChunkCoords coords = Chunk::GetChunkCoords(m_from[ray]);
+		Vec3 direction = m_to[ray] - m_from[ray];
+		unsigned long long octant = (direction.x < 0.0f ? 1 : 0) | (direction.y < 0.0f ? 2 : 0) | (direction.z < 0.0f ? 4 : 0);
+		m_sortKeys[ray] = ((unsigned long long)(unsigned short)coords.x << 32) | ((unsigned long long)(unsigned short)coords.y << 16) | octant;
+		m_order[ray] = ray;
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](int a, int b)
+	{
+		return m_sortKeys[a] < m_sortKeys[b];
+	});
+}
+
+void RaycastBatch::Trace(const ChunkProvider* chunkProvider, int begin, int end)
+{
+	RaycastChunkCache cache;
+	cache.m_chunkProvider = chunkProvider;
+
+	for (int packetBegin = begin; packetBegin < end; packetBegin += RAYCAST_PACKET_LANES)
+	{
+		RaycastPacket packet = {};
+		int laneCount = std::min(end - packetBegin, RAYCAST_PACKET_LANES);
+		int activeCount = 0;
+
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			int ray = m_order[packetBegin + lane];
+			packet.m_ray[lane] = ray;
+			m_hitDistance[ray] = -1.0f;
+			m_hitBlock[ray] = BlockIterator();
+
+			const Vec3& startPosition = m_from[ray];
+			Vec3 forwardNormal = m_to[ray] - startPosition;
+			packet.m_maxDist[lane] = forwardNormal.NormalizeAndGetPreviousLength();
+
+			// rays starting in an unloaded chunk never hit, like the scalar raycast
+			WorldCoords tile = Chunk::GetWorldCoords(startPosition);
+			packet.m_chunk[lane] = cache.Find(Chunk::GetChunkCoords(tile));
+			if (!packet.m_chunk[lane])
+				continue;
+
+			LocalCoords local = Chunk::GetLocalCoords(tile);
+			const float start[3] = { startPosition.x, startPosition.y, startPosition.z };
+			const float forward[3] = { forwardNormal.x, forwardNormal.y, forwardNormal.z };
+			const int tileCoords[3] = { tile.x, tile.y, tile.z };
+			const int localCoords[3] = { local.x, local.y, local.z };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int step = forward[axis] < 0 ? -1 : 1;
+				float distPer = 1.0f / fabsf(forward[axis]);
+				float firstCrossing = tileCoords[axis] + ((float)step + 1.0f) / 2.0f;
+				packet.m_cell[axis][lane] = localCoords[axis];
+				packet.m_step[axis][lane] = step;
+				packet.m_distPer[axis][lane] = distPer;
+				packet.m_distNext[axis][lane] = fabsf(firstCrossing - start[axis]) * distPer;
+			}
+
+			// a ray starting inside a block keeps going, a later hit replaces this one
+			if (IsPacketCellInChunk(packet, lane))
+			{
+				int blockIndex = GetPacketBlockIndex(packet, lane);
+				const Block& block = packet.m_chunk[lane]->GetBlockAtIndex(blockIndex);
+				if (block.IsValid() && block.IsSolid())
+				{
+					m_hitDistance[ray] = 0.0f;
+					m_hitNormal[ray] = -forwardNormal;
+					m_hitBlock[ray] = BlockIterator(packet.m_chunk[lane], blockIndex);
+				}
+			}
+
+			packet.m_active[lane] = SkipEmptySection(packet, lane);
+			activeCount += packet.m_active[lane] ? 1 : 0;
+		}
+
+		while (activeCount > 0)
+		{
+			// nearest crossing of every lane, plain arithmetic over the lane arrays so it vectorizes
+			for (int lane = 0; lane < RAYCAST_PACKET_LANES; lane++)
+			{
+				float distX = packet.m_distNext[0][lane];
+				float distY = packet.m_distNext[1][lane];
+				float distZ = packet.m_distNext[2][lane];
+				bool pickX = distX <= distY && distX <= distZ;
+				bool pickY = !pickX && distY <= distZ;
+				packet.m_axis[lane] = pickX ? 0 : (pickY ? 1 : 2);
+				packet.m_dist[lane] = pickX ? distX : (pickY ? distY : distZ);
+			}
+
+			// block fetches stay per lane
+			for (int lane = 0; lane < laneCount; lane++)
+			{
+				if (!packet.m_active[lane])
+					continue;
+
+				float dist = packet.m_dist[lane];
+				if (dist >= packet.m_maxDist[lane])
+				{
+					packet.m_active[lane] = false;
+					activeCount--;
+					continue;
+				}
+
+				StepPacketLane(packet, lane);
+				if (!packet.m_chunk[lane])
+				{
+					packet.m_active[lane] = false;
+					activeCount--;
+					continue;
+				}
+
+				if (IsPacketCellInChunk(packet, lane))
+				{
+					int blockIndex = GetPacketBlockIndex(packet, lane);
+					const Block& block = packet.m_chunk[lane]->GetBlockAtIndex(blockIndex);
+					if (block.IsValid() && block.IsSolid())
+					{
+						int ray = packet.m_ray[lane];
+						int axis = packet.m_axis[lane];
+						float normal = (float)-packet.m_step[axis][lane];
+						Vec3 impactNormal = axis == 0 ? Vec3(normal, 0.0f, 0.0f) : (axis == 1 ? Vec3(0.0f, normal, 0.0f) : Vec3(0.0f, 0.0f, normal));
+						m_hitDistance[ray] = dist;
+						m_hitNormal[ray] = impactNormal;
+						m_hitBlock[ray] = BlockIterator(packet.m_chunk[lane], blockIndex);
+						packet.m_active[lane] = false;
+						activeCount--;
+						continue;
+					}
+				}
+
+				if (!SkipEmptySection(packet, lane))
+				{
+					packet.m_active[lane] = false;
+					activeCount--;
+				}
+			}
+		}
+	}
+}
+
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Game/World/BlockIterator.hpp"
+
+#include "Engine/Core/JobSystem.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <vector>
+
+constexpr int JOB_TYPE_RAYCAST = 989;
+constexpr int RAYCAST_PACKET_LANES = 8;
+
+class ChunkProvider;
+class RaycastBatch;
+
+class RaycastBatchJob : public Job
+{
+public:
+	RaycastBatchJob(RaycastBatch* batch, const ChunkProvider* chunkProvider, int begin, int end);
+
+private:
+	virtual void Execute() override;
+	virtual void OnFinished() override;
+
+private:
+	RaycastBatch* const        m_batch;
+	const ChunkProvider* const m_chunkProvider;
+	const int                  m_begin;
+	const int                  m_end;
+};
+
+// rays traced together against the blocks by World::RaycastVsTiles, results are read back by the index AddRay returned
+// rays leaving the same chunk in the same direction are stepped side by side in packets and share chunk lookups
+class RaycastBatch
+{
+	friend class RaycastBatchJob;
+	friend class World;
+
+public:
+	void Clear();
+	void Reserve(int rayCount);
+	int  AddRay(const Vec3& fromPosition, const Vec3& toPosition);
+
+	int                  GetRayCount() const { return (int)m_from.size(); }
+	bool                 DidHit(int ray) const { return m_hitDistance[ray] >= 0.0f; }
+	RaycastResult3D      GetResult(int ray) const;
+	const BlockIterator& GetHitBlock(int ray) const { return m_hitBlock[ray]; }
+
+private:
+	void SortRays();
+	void Trace(const ChunkProvider* chunkProvider, int begin, int end);
+
+private:
+	std::vector<Vec3>               m_from;
+	std::vector<Vec3>               m_to;
+	std::vector<float>              m_hitDistance; // negative for rays that reached their end
+	std::vector<Vec3>               m_hitNormal;
+	std::vector<BlockIterator>      m_hitBlock;
+	std::vector<int>                m_order;       // rays sorted by start chunk and direction, jobs take ranges of it
+	std::vector<unsigned long long> m_sortKeys;
+	int                             m_runningJobs = 0;
+};
+
@@ -0,0 +1,458 @@
+#include "Game/World/RegionFile.hpp"
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
+#include <windows.h>			// only for mapping region files into memory
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr const char*   REGION_FILE_HEADER = "GRGN";
+constexpr size_t        REGION_FILE_HEADER_SIZE = 4;
+constexpr uint32_t      REGION_FILE_VERSION = 1;
+constexpr size_t        REGION_TABLE_OFFSET = REGION_FILE_HEADER_SIZE + sizeof(uint32_t);
+constexpr size_t        REGION_PAYLOAD_PREFIX = sizeof(uint32_t) + 1; // raw size, codec
+constexpr unsigned char REGION_CODEC_RAW = 0;
+constexpr unsigned char REGION_CODEC_LZ4 = 1;
+constexpr uint32_t      REGION_MAX_CHUNK_BYTES = CHUNK_SIZE_BLOCKS * sizeof(Block); // no saved chunk comes near a full block array
+
+static_assert(REGION_TABLE_OFFSET + REGION_CHUNKS * 8 <= REGION_HEADER_SECTORS * REGION_SECTOR_SIZE, "region table does not fit the header sectors");
+
+// ============ LZ4 block format ================ //
+
+constexpr int    LZ4_MIN_MATCH = 4;
+constexpr int    LZ4_HASH_BITS = 12;
+constexpr size_t LZ4_LAST_LITERALS = 5;  // the block always ends with this many literals
+constexpr size_t LZ4_MATCH_LIMIT = 12;   // no match may start closer than this to the end
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+
+static inline uint32_t ReadU32(const unsigned char* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline int HashLZ4(uint32_t sequence)
+{
+	return (int)((sequence * 2654435761u) >> (32 - LZ4_HASH_BITS));
+}
+
+static void WriteLengthLZ4(std::vector<unsigned char>& out, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		out.push_back(255);
+	out.push_back((unsigned char)length);
+}
+
+static bool ReadLengthLZ4(const unsigned char* src, size_t size, size_t& pos, size_t& length)
+{
+	unsigned char byte = 255;
+	while (byte == 255)
+	{
+		if (pos >= size)
+			return false;
+		byte = src[pos++];
+		length += byte;
+	}
+	return true;
+}
+
+static void WriteSequenceLZ4(std::vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength - LZ4_MIN_MATCH;
+	unsigned char token = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+	if (matchLength > 0)
+		token |= (unsigned char)(matchCode < 15 ? matchCode : 15);
+
+	out.push_back(token);
+	if (literalCount >= 15)
+		WriteLengthLZ4(out, literalCount - 15);
+	out.insert(out.end(), literals, literals + literalCount);
+
+	if (matchLength == 0)
+		return; // last sequence, literals only
+
+	out.push_back((unsigned char)(offset & 0xFF));
+	out.push_back((unsigned char)(offset >> 8));
+	if (matchCode >= 15)
+		WriteLengthLZ4(out, matchCode - 15);
+}
+
+// greedy single-probe compressor, the output is a plain LZ4 block
+static void CompressLZ4(const unsigned char* src, size_t size, std::vector<unsigned char>& out)
+{
+	size_t anchor = 0;
+	if (size > LZ4_MATCH_LIMIT)
+	{
+		std::vector<int> table((size_t)1 << LZ4_HASH_BITS, -1);
+		size_t matchEnd = size - LZ4_LAST_LITERALS;
+		size_t pos = 0;
+		while (pos + LZ4_MATCH_LIMIT <= size)
+		{
+			uint32_t sequence = ReadU32(src + pos);
+			int& slot = table[HashLZ4(sequence)];
+			int candidate = slot;
+			slot = (int)pos;
+			if (candidate < 0 || pos - (size_t)candidate > LZ4_MAX_OFFSET || ReadU32(src + candidate) != sequence)
+			{
+				pos++;
+				continue;
+			}
+
+			size_t length = LZ4_MIN_MATCH;
+			while (pos + length < matchEnd && src[candidate + length] == src[pos + length])
+				length++;
+
+			WriteSequenceLZ4(out, src + anchor, pos - anchor, pos - (size_t)candidate, length);
+			pos += length;
+			anchor = pos;
+		}
+	}
+	WriteSequenceLZ4(out, src + anchor, size - anchor, 0, 0);
+}
+
+static bool DecompressLZ4(const unsigned char* src, size_t size, unsigned char* dst, size_t dstSize)
+{
+	size_t in = 0;
+	size_t out = 0;
+	while (in < size)
+	{
+		unsigned char token = src[in++];
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLengthLZ4(src, size, in, literalCount))
+			return false;
+		if (in + literalCount > size || out + literalCount > dstSize)
+			return false;
+		memcpy(dst + out, src + in, literalCount);
+		in += literalCount;
+		out += literalCount;
+
+		if (in == size)
+			break; // last sequence has no match
+
+		if (in + 2 > size)
+			return false;
+		size_t offset = (size_t)src[in] | ((size_t)src[in + 1] << 8);
+		in += 2;
+		if (offset == 0 || offset > out)
+			return false;
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLengthLZ4(src, size, in, length))
+			return false;
+		length += LZ4_MIN_MATCH;
+		if (out + length > dstSize)
+			return false;
+
+		// matches may overlap their own output, copy forward byte by byte
+		for (size_t i = 0; i < length; i++, out++)
+			dst[out] = dst[out - offset];
+	}
+	return out == dstSize;
+}
+
+// ============ Region ================ //
+
+static inline uint32_t GetSectorCount(size_t size)
+{
+	return (uint32_t)((size + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE);
+}
+
+RegionFile::RegionFile(const std::string& path)
+	: m_path(path)
+{
+	m_file.open(m_path, std::ios::in | std::ios::out | std::ios::binary);
+	if (m_file.is_open() && ReadHeader())
+	{
+		m_valid = true;
+		return;
+	}
+
+	// a failed read may have filled part of the table
+	for (Entry& entry : m_entries)
+		entry = Entry();
+
+	// an unreadable region may still hold up to REGION_CHUNKS chunks, set it aside before starting over
+	// if it can't be moved the region stays closed, its chunks are generated fresh and never saved over it
+	if (m_file.is_open())
+	{
+		m_file.close();
+		std::error_code error;
+		std::string backupPath = m_path + ".bak";
+		std::filesystem::rename(m_path, backupPath, error);
+		if (error)
+		{
+			DebuggerPrintf("Region %s is unreadable and could not be backed up, leaving it untouched\n", m_path.c_str());
+			m_valid = false;
+			return;
+		}
+		DebuggerPrintf("Region %s is unreadable or from another version, moved to %s\n", m_path.c_str(), backupPath.c_str());
+	}
+
+	m_file.open(m_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	m_valid = m_file.is_open() && WriteHeader();
+}
+
+RegionFile::~RegionFile()
+{
+	UnmapView();
+}
+
+bool RegionFile::HasChunk(const ChunkCoords& coords) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries[GetEntryIndex(coords)].m_sector != 0;
+}
+
+bool RegionFile::ReadChunk(const ChunkCoords& coords, std::vector<unsigned char>& data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Entry& entry = m_entries[GetEntryIndex(coords)];
+	if (!m_valid || entry.m_sector == 0)
+		return false;
+	if (!m_view && !MapView())
+		return false;
+
+	size_t begin = (size_t)entry.m_sector * REGION_SECTOR_SIZE;
+	if (entry.m_size < REGION_PAYLOAD_PREFIX || begin + entry.m_size > m_viewSize)
+		return false; // Corrupt region entry.
+
+	const unsigned char* payload = m_view + begin;
+	uint32_t rawSize = ReadU32(payload);
+	unsigned char codec = payload[sizeof(uint32_t)];
+	payload += REGION_PAYLOAD_PREFIX;
+	size_t payloadSize = entry.m_size - REGION_PAYLOAD_PREFIX;
+	if (rawSize > REGION_MAX_CHUNK_BYTES)
+		return false; // Corrupt region entry.
+
+	data.resize(rawSize);
+	if (codec == REGION_CODEC_LZ4)
+		return DecompressLZ4(payload, payloadSize, data.data(), rawSize);
+
+	if (codec != REGION_CODEC_RAW || payloadSize != rawSize)
+		return false; // Unknown codec.
+	if (rawSize > 0)
+		memcpy(data.data(), payload, rawSize);
+	return true;
+}
+
+bool RegionFile::WriteChunk(const ChunkCoords& coords, const unsigned char* data, size_t size)
+{
+	if (!m_valid)
+		return false;
+
+	// compress outside the lock, only the file itself is shared
+	std::vector<unsigned char> payload(REGION_PAYLOAD_PREFIX);
+	payload.reserve(REGION_PAYLOAD_PREFIX + size);
+	CompressLZ4(data, size, payload);
+
+	unsigned char codec = REGION_CODEC_LZ4;
+	if (payload.size() >= REGION_PAYLOAD_PREFIX + size)
+	{
+		payload.resize(REGION_PAYLOAD_PREFIX);
+		payload.insert(payload.end(), data, data + size);
+		codec = REGION_CODEC_RAW;
+	}
+	uint32_t rawSize = (uint32_t)size;
+	memcpy(payload.data(), &rawSize, sizeof(rawSize));
+	payload[sizeof(uint32_t)] = codec;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int index = GetEntryIndex(coords);
+	uint32_t payloadSize = (uint32_t)payload.size();
+	uint32_t count = GetSectorCount(payloadSize);
+	uint32_t sector = AllocateSectors(m_entries[index], count);
+	payload.resize((size_t)count * REGION_SECTOR_SIZE, 0);
+
+	m_file.seekp((std::streamoff)sector * REGION_SECTOR_SIZE);
+	m_file.write((const char*)payload.data(), (std::streamsize)payload.size());
+	m_entries[index].m_sector = sector;
+	m_entries[index].m_size = payloadSize;
+	if (!WriteEntry(index))
+		return false;
+
+	// the view sees in-place writes, only a grown file needs mapping again
+	if ((size_t)(sector + count) * REGION_SECTOR_SIZE > m_viewSize)
+		UnmapView();
+	return true;
+}
+
+IntVec2 RegionFile::GetRegionCoords(const ChunkCoords& chunkCoords)
+{
+	return IntVec2(chunkCoords.x >> REGION_SIZE_BITWIDTH, chunkCoords.y >> REGION_SIZE_BITWIDTH);
+}
+
+int RegionFile::GetEntryIndex(const ChunkCoords& coords) const
+{
+	return ((coords.y & (REGION_SIZE - 1)) << REGION_SIZE_BITWIDTH) | (coords.x & (REGION_SIZE - 1));
+}
+
+bool RegionFile::ReadHeader()
+{
+	m_file.seekg(0, std::ios::end);
+	size_t fileSize = (size_t)m_file.tellg();
+	if (!m_file || fileSize < (size_t)REGION_HEADER_SECTORS * REGION_SECTOR_SIZE)
+		return false;
+
+	char header[REGION_FILE_HEADER_SIZE];
+	uint32_t version = 0;
+	m_file.seekg(0);
+	m_file.read(header, REGION_FILE_HEADER_SIZE);
+	m_file.read((char*)&version, sizeof(version));
+	m_file.read((char*)&m_entries[0], sizeof(m_entries));
+	if (!m_file)
+		return false;
+
+	if (memcmp(header, REGION_FILE_HEADER, REGION_FILE_HEADER_SIZE) != 0)
+		return false; // Corrupt region file.
+	if (version != REGION_FILE_VERSION)
+		return false; // Incompatible region file version.
+
+	uint32_t sectorCount = (uint32_t)(fileSize / REGION_SECTOR_SIZE);
+	m_usedSectors.assign(sectorCount, false);
+	SetSectorsUsed(0, REGION_HEADER_SECTORS, true);
+	for (Entry& entry : m_entries)
+	{
+		if (entry.m_sector == 0)
+			continue;
+
+		// drop entries pointing outside the file, the chunk is generated again
+		uint32_t count = GetSectorCount(entry.m_size);
+		if (entry.m_size == 0 || entry.m_sector < REGION_HEADER_SECTORS || entry.m_sector + count > sectorCount)
+		{
+			entry = Entry();
+			continue;
+		}
+		SetSectorsUsed(entry.m_sector, count, true);
+	}
+	return true;
+}
+
+bool RegionFile::WriteHeader()
+{
+	std::vector<char> header((size_t)REGION_HEADER_SECTORS * REGION_SECTOR_SIZE, 0);
+	memcpy(header.data(), REGION_FILE_HEADER, REGION_FILE_HEADER_SIZE);
+	memcpy(header.data() + REGION_FILE_HEADER_SIZE, &REGION_FILE_VERSION, sizeof(REGION_FILE_VERSION));
+	memcpy(header.data() + REGION_TABLE_OFFSET, &m_entries[0], sizeof(m_entries));
+
+	m_file.seekp(0);
+	m_file.write(header.data(), (std::streamsize)header.size());
+	m_file.flush();
+
+	m_usedSectors.assign(REGION_HEADER_SECTORS, true);
+	return (bool)m_file;
+}
+
+bool RegionFile::WriteEntry(int index)
+{
+	m_file.seekp((std::streamoff)(REGION_TABLE_OFFSET + index * sizeof(Entry)));
+	m_file.write((const char*)&m_entries[index], sizeof(Entry));
+	m_file.flush();
+	if (m_file)
+		return true;
+
+	m_file.clear();
+	return false;
+}
+
+uint32_t RegionFile::AllocateSectors(const Entry& entry, uint32_t count)
+{
+	// shrinking or same-sized payloads are rewritten in place
+	if (entry.m_sector != 0)
+	{
+		uint32_t oldCount = GetSectorCount(entry.m_size);
+		if (count <= oldCount)
+		{
+			SetSectorsUsed(entry.m_sector + count, oldCount - count, false);
+			return entry.m_sector;
+		}
+		SetSectorsUsed(entry.m_sector, oldCount, false);
+	}
+
+	uint32_t run = 0;
+	for (uint32_t sector = REGION_HEADER_SECTORS; sector < (uint32_t)m_usedSectors.size(); sector++)
+	{
+		run = m_usedSectors[sector] ? 0 : run + 1;
+		if (run == count)
+		{
+			SetSectorsUsed(sector + 1 - count, count, true);
+			return sector + 1 - count;
+		}
+	}
+
+	// no gap is large enough, grow the file from the free sectors at its end
+	uint32_t sector = (uint32_t)m_usedSectors.size() - run;
+	SetSectorsUsed(sector, count, true);
+	return sector;
+}
+
+void RegionFile::SetSectorsUsed(uint32_t sector, uint32_t count, bool used)
+{
+	if (sector + count > m_usedSectors.size())
+		m_usedSectors.resize(sector + count, false);
+	for (uint32_t i = 0; i < count; i++)
+		m_usedSectors[sector + i] = used;
+}
+
+bool RegionFile::MapView()
+{
+	m_file.flush();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	// the view keeps the mapping alive on its own
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+	if (!view)
+		return false;
+
+	m_view = (const unsigned char*)view;
+	m_viewSize = (size_t)size.QuadPart;
+#else
+	int file = open(m_path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info = {};
+	void* view = fstat(file, &info) == 0 && info.st_size > 0 ? mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+
+	m_view = (const unsigned char*)view;
+	m_viewSize = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void RegionFile::UnmapView()
+{
+	if (!m_view)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_view);
+#else
+	munmap((void*)m_view, m_viewSize);
+#endif
+	m_view = nullptr;
+	m_viewSize = 0;
+}
+
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Game/World/Chunk.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr int REGION_SIZE_BITWIDTH  = 5;
+constexpr int REGION_SIZE           = 1 << REGION_SIZE_BITWIDTH;
+constexpr int REGION_CHUNKS         = REGION_SIZE * REGION_SIZE;
+constexpr int REGION_SECTOR_SIZE    = 4096;
+constexpr int REGION_HEADER_SECTORS = 3; // magic, version and the offset/size table
+
+// 32x32 chunks in one file, each chunk payload is compressed and stored in whole sectors
+// reads and writes may come from several IO jobs at once and are serialized per region
+class RegionFile
+{
+public:
+	RegionFile(const std::string& path);
+	~RegionFile();
+
+	bool IsValid() const { return m_valid; }
+	bool HasChunk(const ChunkCoords& coords) const;
+	bool ReadChunk(const ChunkCoords& coords, std::vector<unsigned char>& data);
+	bool WriteChunk(const ChunkCoords& coords, const unsigned char* data, size_t size);
+
+	static IntVec2 GetRegionCoords(const ChunkCoords& chunkCoords);
+
+private:
+	struct Entry
+	{
+		uint32_t m_sector = 0; // 0 when the chunk was never saved, the header owns sector 0
+		uint32_t m_size = 0;
+	};
+
+	int  GetEntryIndex(const ChunkCoords& coords) const;
+	bool ReadHeader();
+	bool WriteHeader();
+	bool WriteEntry(int index);
+
+	uint32_t AllocateSectors(const Entry& entry, uint32_t count);
+	void     SetSectorsUsed(uint32_t sector, uint32_t count, bool used);
+
+	bool MapView();
+	void UnmapView();
+
+private:
+	mutable std::mutex   m_mutex;
+	std::string          m_path;
+	std::fstream         m_file;
+	bool                 m_valid = false;
+	Entry                m_entries[REGION_CHUNKS];
+	std::vector<bool>    m_usedSectors;
+	const unsigned char* m_view = nullptr;
+	size_t               m_viewSize = 0;
+};
+
@@ -15,6 +15,10 @@
 #include "Game/World/ChunkProvider.hpp"
 #include "Game/World/WorldGenerator.hpp"
 #include "Game/World/NavMesh.hpp"
+#include "Game/World/NavCrowd.hpp"
+#include "Game/World/EnvQuery.hpp"
+#include "Game/World/AIPerception.hpp"
+#include "Game/World/RaycastBatch.hpp"
 
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/StringUtils.hpp"
@@ -36,6 +40,9 @@
 
 #include "ThirdParty/squirrel/SmoothNoise.hpp"
 
+#include <algorithm>
+#include <thread>
+
 extern bool g_useSkyBlock;
 
 constexpr bool SHOW_COLLISION_VOLUME = false;
@@ -113,11 +120,20 @@ int InitializeShaderConsts()
 
 World::World()
 	: m_navMesh(new NavMesh2D(this, IntVec3(0, 0, 5), IntVec2(127, 127)))
+	, m_crowd(new NavCrowd())
+	, m_envQuery(new EnvQuerySystem(this))
+	, m_perception(new AIPerception(this))
 {
+	m_raycastJobMinRays = g_gameConfigBlackboard.GetValue("raycastJobMinRays", m_raycastJobMinRays);
+	m_raycastRaysPerJob = g_gameConfigBlackboard.GetValue("raycastRaysPerJob", m_raycastRaysPerJob);
+	m_actorGrid.SetCellSize(g_gameConfigBlackboard.GetValue("actorGridCellSize", 4.0f));
 }
 
 World::~World()
 {
+	delete m_perception;
+	delete m_envQuery;
+	delete m_crowd;
 	delete m_navMesh;
 }
 
@@ -182,6 +198,7 @@ void World::Shutdown()
 	m_player[0] = nullptr;
 	m_player[1] = nullptr;
 	RemoveEntities();
+	m_actorGrid.Clear();
 
 	m_chunkManager->UnloadAllChunks();
 	delete m_chunkManager;
@@ -210,6 +227,8 @@ void World::Update(float deltaSeconds)
 // 	}
 // 
 
+	m_envQuery->BeginFrame();
+
 	static Stopwatch watch;
 
 	if (watch.IsStopped() || watch.HasDurationElapsed())
@@ -219,6 +238,8 @@ void World::Update(float deltaSeconds)
 		m_navMesh->BuildNav();
 	}
 
+	m_navMesh->Update();
+
 	GetClock()->SetTimeDilation((g_theInput->IsKeyDown(KEYCODE_Y) ? 50.0 : 1.0) * (1.0 / 400.0));
 
 	m_chunkManager->Update();
@@ -231,6 +252,19 @@ void World::Update(float deltaSeconds)
 	}
 
 	UpdateEntities(deltaSeconds);
+
+	// AI registered their preferred velocities while updating, players only need to be avoided
+	for (Player* player : m_player)
+		if (player && player->GetActor())
+			m_crowd->AddObstacle(player->GetActor());
+	m_crowd->Update(deltaSeconds);
+	for (Actor* actor : m_entityList)
+		if (actor)
+			m_actorGrid.UpdateActor(actor); // crowd agents were moved after their own update
+
+	// sight and noise for the next behavior tree update, actors are at their final positions
+	m_perception->Update();
+
 	DoCollisionForActors();
 	DoGarbageCollection();
 }
@@ -324,6 +358,8 @@ void World::UpdateEnvVariables() const
 	envConsts.FOG_DIST_FAR = (float)GetChunkManager()->GetChunkActiveRange() * (isInWater ? 0.25f : 1.0f) - 16.0f;
 	envConsts.FOG_DIST_NEAR = envConsts.FOG_DIST_FAR * (isInWater ? 0.05f : 0.5f);
 
+	envConsts.ATLAS_ROWS = (float)BlockSetDefinition::GetDefinition()->GetBlockMaterialAtlas()->m_gridLayout.y;
+
 	g_theRenderer->SetCustomConstantBuffer(ENV_CONSTANT_BUFFER_SLOT, &envConsts);
 
 	DebugAddMessage(Stringf("SkyValue: %.2f, Flicker: %.2f, Lightning: %.2f", skyValue, envConsts.FLICKER_VALUE, envConsts.LIGHTNING_VALUE), 0.0f, Rgba8::WHITE, Rgba8::WHITE);
@@ -395,6 +431,7 @@ void World::DoGarbageCollection()
 		if (!entry->IsGarbage())
 			continue;
 
+		m_actorGrid.RemoveActor(entry);
 		delete entry;
 		entry = nullptr;
 	}
@@ -415,12 +452,14 @@ Actor* World::AddEntity(const SpawnInfo& spawnInfo)
 		{
 			ActorUID uid = ActorUID(idx, GetSaltForEntity());
 			actorRef = new Actor(this, &spawnInfo, uid);
+			m_actorGrid.UpdateActor(actorRef);
 			return *uid;
 		}
 	}
 
 	ActorUID uid = ActorUID((int)m_entityList.size(), GetSaltForEntity());
 	m_entityList.push_back(new Actor(this, &spawnInfo, uid));
+	m_actorGrid.UpdateActor(m_entityList.back());
 	return *uid;
 }
 
@@ -435,6 +474,7 @@ void World::RemoveEntities(bool isGarbageCollect, int entityTypeMask /*= 0xFFFFF
 		if (isGarbageCollect && !entry->IsGarbage())
 			continue;
 
+		m_actorGrid.RemoveActor(entry);
 		delete entry;
 		entry = nullptr;
 	}
@@ -452,6 +492,7 @@ void World::RemoveEntity(const ActorUID& uid, bool isGarbageCollect, int entityT
 		return;
 
 	int index = entity->m_uid.GetIndex();
+	m_actorGrid.RemoveActor(entity);
 	delete entity;
 	m_entityList[index] = nullptr;
 }
@@ -462,6 +503,23 @@ void World::UpdateEntities(float deltaSeconds, int entityTypeMask /*= 0xFFFFFFFF
 	{
 		UpdateEntity(m_entityList[i], deltaSeconds, entityTypeMask);
 	}
+
+	// component systems, each walks the live slots of its pool slab by slab in slot order after every controller ran
+	ComponentPool<Physics>::GetInstance().ForEach([&](Physics& physics)
+	{
+		Actor* actor = &physics.m_actor;
+		if (IsEntityNotGarbage(actor) && actor->IsOfTypeMask(entityTypeMask))
+		{
+			physics.Update(deltaSeconds);
+			m_actorGrid.UpdateActor(actor);
+		}
+	});
+
+	ComponentPool<SkeletalMeshComp>::GetInstance().ForEach([&](SkeletalMeshComp& mesh)
+	{
+		if (IsEntityNotGarbage(&mesh.m_actor) && mesh.m_actor.IsOfTypeMask(entityTypeMask))
+			mesh.Update(deltaSeconds);
+	});
 }
 
 void World::UpdateEntity(Actor* entity, float deltaSeconds, int entityTypeMask /*= 0xFFFFFFFF*/)
@@ -536,6 +594,11 @@ EntityList World::GetEntities(bool noDead, const ActorDefinition* definition) co
 	return list;
 }
 
+void World::GetEntitiesInRange(EntityList& entityList_out, const Vec3& center, float radius) const
+{
+	m_actorGrid.QueryRange(center, radius, entityList_out);
+}
+
 WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec3& toPosition) const
 {
 	WorldRaycastResult result;
@@ -548,7 +611,7 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 	const int tileY = Floor(startPosition.y);
 	const int tileZ = Floor(startPosition.z);
 	BlockIterator ite = BlockIterator(m_chunkManager, IntVec3(tileX, tileY, tileZ));
-	Block* blk = ite.GetBlock();
+	const Block* blk = ite.PeekBlock();
 	if (blk->IsValid() && blk->IsSolid())
 	{
 		result.m_result = RaycastResult3D(0.0f, startPosition, -forwardNormal);
@@ -578,6 +641,42 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 
 	while (true)
 	{
+		// air sections cannot stop the ray, take every crossing that stays inside at once
+		if (ite.IsInEmptySection())
+		{
+			LocalCoords local = ite.GetLocalCoords();
+			int sectionMinZ = local.z & ~(int)(CHUNK_SECTION_SIZE_Z - 1);
+			int cellsX = stepDirectionX > 0 ? (int)CHUNK_MAX_X - local.x : local.x;
+			int cellsY = stepDirectionY > 0 ? (int)CHUNK_MAX_Y - local.y : local.y;
+			int cellsZ = stepDirectionZ > 0 ? sectionMinZ + (int)CHUNK_SECTION_SIZE_Z - 1 - local.z : local.z - sectionMinZ;
+
+			float exitX = cellsX > 0 ? distOfNextXCrossing + (float)cellsX * distPerXCrossing : distOfNextXCrossing;
+			float exitY = cellsY > 0 ? distOfNextYCrossing + (float)cellsY * distPerYCrossing : distOfNextYCrossing;
+			float exitZ = cellsZ > 0 ? distOfNextZCrossing + (float)cellsZ * distPerZCrossing : distOfNextZCrossing;
+			float exitDist = exitX < exitY ? (exitX < exitZ ? exitX : exitZ) : (exitY < exitZ ? exitY : exitZ);
+			if (exitDist >= maxDistance)
+				return result;
+
+			auto countCrossings = [exitDist](float distOfNext, float distPer, int cells)
+			{
+				if (distOfNext >= exitDist)
+					return 0;
+				int count = (int)ceilf((exitDist - distOfNext) / distPer);
+				return count < cells ? count : cells;
+			};
+			int stepsX = countCrossings(distOfNextXCrossing, distPerXCrossing, cellsX);
+			int stepsY = countCrossings(distOfNextYCrossing, distPerYCrossing, cellsY);
+			int stepsZ = countCrossings(distOfNextZCrossing, distPerZCrossing, cellsZ);
+			// axes the ray does not move along keep their infinite crossing distance
+			ite += IntVec3(stepsX * stepDirectionX, stepsY * stepDirectionY, stepsZ * stepDirectionZ);
+			if (stepsX > 0)
+				distOfNextXCrossing += (float)stepsX * distPerXCrossing;
+			if (stepsY > 0)
+				distOfNextYCrossing += (float)stepsY * distPerYCrossing;
+			if (stepsZ > 0)
+				distOfNextZCrossing += (float)stepsZ * distPerZCrossing;
+		}
+
 		if (distOfNextXCrossing <= distOfNextYCrossing && distOfNextXCrossing <= distOfNextZCrossing)
 		{
 			// go for x step
@@ -585,7 +684,7 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 				return result;
 
 			ite += IntVec3(stepDirectionX, 0, 0);
-			blk = ite.GetBlock();
+			blk = ite.PeekBlock();
 			if (blk->IsValid() && blk->IsSolid())
 			{
 				Vec3 hitPos = startPosition + forwardNormal * distOfNextXCrossing;
@@ -605,7 +704,7 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 				return result;
 
 			ite += IntVec3(0, stepDirectionY, 0);
-			blk = ite.GetBlock();
+			blk = ite.PeekBlock();
 			if (blk->IsValid() && blk->IsSolid())
 			{
 				Vec3 hitPos = startPosition + forwardNormal * distOfNextYCrossing;
@@ -625,7 +724,7 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 				return result;
 
 			ite += IntVec3(0, 0, stepDirectionZ);
-			blk = ite.GetBlock();
+			blk = ite.PeekBlock();
 			if (blk->IsValid() && blk->IsSolid())
 			{
 				Vec3 hitPos = startPosition + forwardNormal * distOfNextZCrossing;
@@ -641,6 +740,199 @@ WorldRaycastResult World::FastRaycastVsTiles(const Vec3& fromPosition, const Vec
 	}
 }
 
+void World::RaycastVsTiles(RaycastBatch& batch, bool allowJobs) const
+{
+	int rayCount = batch.GetRayCount();
+	batch.SortRays();
+	if (!allowJobs || rayCount < m_raycastJobMinRays)
+	{
+		batch.Trace(m_chunkManager, 0, rayCount);
+		return;
+	}
+
+	for (int begin = 0; begin < rayCount; begin += m_raycastRaysPerJob)
+	{
+		batch.m_runningJobs++;
+		g_theJobSystem->QueueJob(new RaycastBatchJob(&batch, m_chunkManager, begin, std::min(begin + m_raycastRaysPerJob, rayCount)));
+	}
+
+	while (batch.m_runningJobs > 0)
+	{
+		g_theJobSystem->FinishUpJobsOfType(JOB_TYPE_RAYCAST);
+		std::this_thread::yield();
+	}
+}
+
+constexpr float SWEEP_EPSILON = 0.0001f;
+
+static float& GetAxis(Vec3& vector, int axis)
+{
+	return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+}
+
+static float GetAxis(const Vec3& vector, int axis)
+{
+	return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+}
+
+static bool IsOverlappingOnAxis(const AABB3& boxA, const AABB3& boxB, int axis)
+{
+	return GetAxis(boxA.m_mins, axis) < GetAxis(boxB.m_maxs, axis) - SWEEP_EPSILON && GetAxis(boxA.m_maxs, axis) > GetAxis(boxB.m_mins, axis) + SWEEP_EPSILON;
+}
+
+static void DebugDrawCollisionBlock(const AABB3& box)
+{
+	if (!SHOW_COLLISION_VOLUME)
+		return;
+
+	Rgba8 color = Rgba8::RED;
+	color.a = 80;
+	DebugAddWorldBox(box, 0.0f, color, color, DebugRenderMode::XRAY);
+}
+
+WorldSweepResult World::SweepBoxVsTiles(const Vec3& position, float halfSizeXY, float sizeZ, const Vec3& movement, bool pushOut) const
+{
+	WorldSweepResult result;
+	AABB3 box(Vec3(position.x - halfSizeXY, position.y - halfSizeXY, position.z), Vec3(position.x + halfSizeXY, position.y + halfSizeXY, position.z + sizeZ));
+	Vec3 offset;
+
+	// one gather covers the whole move, the extra block around it leaves room for the push out
+	AABB3 bounds = box;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float move = GetAxis(movement, axis);
+		GetAxis(bounds.m_mins, axis) += (move < 0.0f ? move : 0.0f) - 1.0f;
+		GetAxis(bounds.m_maxs, axis) += (move > 0.0f ? move : 0.0f) + 1.0f;
+	}
+	GatherSolidBlocks(bounds, m_sweepBlocks);
+
+	// leave every block the box starts in along its shallowest axis
+	if (pushOut)
+	{
+		for (const AABB3& block : m_sweepBlocks)
+		{
+			if (!IsOverlappingOnAxis(box, block, 0) || !IsOverlappingOnAxis(box, block, 1) || !IsOverlappingOnAxis(box, block, 2))
+				continue;
+
+			int pushAxis = 0;
+			float push = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float pushPositive = GetAxis(block.m_maxs, axis) - GetAxis(box.m_mins, axis);
+				float pushNegative = GetAxis(block.m_mins, axis) - GetAxis(box.m_maxs, axis);
+				float axisPush = pushPositive < -pushNegative ? pushPositive : pushNegative;
+				if (axis == 0 || fabsf(axisPush) < fabsf(push))
+				{
+					pushAxis = axis;
+					push = axisPush;
+				}
+			}
+
+			GetAxis(box.m_mins, pushAxis) += push;
+			GetAxis(box.m_maxs, pushAxis) += push;
+			GetAxis(offset, pushAxis) += push;
+			result.m_blocked[pushAxis] = true;
+			result.m_pushedOut = true;
+		}
+	}
+
+	// axis by axis like the old per axis moves, blocks the box overlaps on the other two axes clip the move
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float move = GetAxis(movement, axis);
+		if (move == 0.0f)
+			continue;
+
+		int otherAxisA = (axis + 1) % 3;
+		int otherAxisB = (axis + 2) % 3;
+		for (const AABB3& block : m_sweepBlocks)
+		{
+			if (!IsOverlappingOnAxis(box, block, otherAxisA) || !IsOverlappingOnAxis(box, block, otherAxisB))
+				continue;
+
+			if (move > 0.0f && GetAxis(box.m_maxs, axis) <= GetAxis(block.m_mins, axis) + SWEEP_EPSILON)
+			{
+				float limit = std::max(GetAxis(block.m_mins, axis) - GetAxis(box.m_maxs, axis), 0.0f);
+				if (limit < move)
+				{
+					move = limit;
+					result.m_blocked[axis] = true;
+					DebugDrawCollisionBlock(block);
+				}
+			}
+			else if (move < 0.0f && GetAxis(box.m_mins, axis) >= GetAxis(block.m_maxs, axis) - SWEEP_EPSILON)
+			{
+				float limit = std::min(GetAxis(block.m_maxs, axis) - GetAxis(box.m_mins, axis), 0.0f);
+				if (limit > move)
+				{
+					move = limit;
+					result.m_blocked[axis] = true;
+					DebugDrawCollisionBlock(block);
+				}
+			}
+		}
+
+		GetAxis(box.m_mins, axis) += move;
+		GetAxis(box.m_maxs, axis) += move;
+		GetAxis(offset, axis) += move;
+	}
+
+	result.m_position = position + offset;
+	return result;
+}
+
+void World::GatherSolidBlocks(const AABB3& bounds, std::vector<AABB3>& blocks) const
+{
+	blocks.clear();
+
+	WorldCoords mins = Chunk::GetWorldCoords(bounds.m_mins);
+	WorldCoords maxs = Chunk::GetWorldCoords(bounds.m_maxs);
+	int minZ = std::max(mins.z, 0);
+	int maxZ = std::min(maxs.z, (int)CHUNK_MAX_Z);
+	if (minZ > maxZ)
+		return;
+
+	ChunkCoords minChunk = Chunk::GetChunkCoords(mins);
+	ChunkCoords maxChunk = Chunk::GetChunkCoords(maxs);
+	for (int chunkY = minChunk.y; chunkY <= maxChunk.y; chunkY++)
+	{
+		for (int chunkX = minChunk.x; chunkX <= maxChunk.x; chunkX++)
+		{
+			// unloaded chunks do not collide, like the raycasts
+			Chunk* chunk = m_chunkManager->FindLoadedChunk(ChunkCoords(chunkX, chunkY));
+			if (!chunk)
+				continue;
+
+			WorldCoords origin = Chunk::GetOriginInWorld(chunk->m_chunkCoords);
+			int minX = std::max(mins.x - origin.x, 0);
+			int maxX = std::min(maxs.x - origin.x, (int)CHUNK_MAX_X);
+			int minY = std::max(mins.y - origin.y, 0);
+			int maxY = std::min(maxs.y - origin.y, (int)CHUNK_MAX_Y);
+			for (int z = minZ; z <= maxZ; z++)
+			{
+				// air sections hold nothing to collide with
+				if (chunk->GetSection(Chunk::GetSectionIndex(Chunk::GetIndex(LocalCoords(0, 0, z)))).IsEmpty())
+				{
+					z |= (int)CHUNK_SECTION_SIZE_Z - 1;
+					continue;
+				}
+
+				for (int y = minY; y <= maxY; y++)
+				{
+					for (int x = minX; x <= maxX; x++)
+					{
+						if (!chunk->GetBlockAtIndex(Chunk::GetIndex(LocalCoords(x, y, z))).IsSolid())
+							continue;
+
+						Vec3 blockMins = Vec3((float)(origin.x + x), (float)(origin.y + y), (float)z);
+						blocks.emplace_back(blockMins, blockMins + Vec3(1.0f, 1.0f, 1.0f));
+					}
+				}
+			}
+		}
+	}
+}
+
 WorldRaycastResult World::DoRaycast(const Vec3& startPos, const Vec3& fwdNormal, float maxDist, Actor* actorToIgnore) const
 {
 	UNUSED(actorToIgnore);
@@ -666,9 +958,12 @@ void World::AddRaycast(const Vec3& startPos, const Vec3& fwdNormal, float maxDis
 WorldRaycastResult World::RaycastVsActors(const Vec3& startPos, const Vec3& fwdNormal, float maxDist, Actor* actorToIgnore) const
 {
 	WorldRaycastResult result;
-	for (const auto& actor : m_entityList)
+
+	// only actors in the cells the ray crosses are tested
+	m_actorGrid.QueryRay(startPos, fwdNormal, maxDist, m_raycastCandidates);
+	for (const auto& actor : m_raycastCandidates)
 	{
-		if (!actor || actor == actorToIgnore)
+		if (actor == actorToIgnore)
 			continue;
 
 		if (!actor->m_physics || actor->m_physics->m_physicsHeight <= 0 || actor->m_physics->m_physicsRadius <= 0)
@@ -726,371 +1021,61 @@ ChunkProvider* World::GetChunkManager() const
 	return m_chunkManager;
 }
 
-void DebugDrawBlock(const BlockIterator& ite)
-{
-	if (!SHOW_COLLISION_VOLUME)
-		return;
-
-	if (!ite.IsValid())
-		return;
-	Vec3 position = Vec3((float)ite.GetWorldCoords().x, (float)ite.GetWorldCoords().y, (float)ite.GetWorldCoords().z);
-	AABB3 box(position, position + Vec3(1.0f, 1.0f, 1.0f));
-	Rgba8 color = ite.GetBlock()->IsSolid() ? Rgba8::RED : Rgba8::WHITE;
-	color.a = 80;
-	DebugAddWorldBox(box, 0.0f, color, color, DebugRenderMode::XRAY);
-}
-
 void World::DoCollisionForActors()
 {
-	for (int i = 0; i < m_entityList.size(); i++)
+	// actors pushing each other, each pair once from the actor with the lower index
+	// indexed loops, collision handlers may spawn actors and grow the list
+	for (int index = 0; index < (int)m_entityList.size(); index++)
 	{
-		auto* actor = m_entityList[i];
-		if (!actor || !actor->m_physics || actor->m_physics->IsNoclip())
+		Actor* actor = m_entityList[index];
+		if (!actor || actor->IsDead() || !actor->m_physics || actor->m_physics->IsNoclip() || !actor->m_definition->m_collidesWithActors)
 			continue;
 
-// 		// collide with actor
-// 		if (actor->m_definition->m_collidesWithActors)
-// 		{
-// 			for (int j = i + 1; j < m_entityList.size(); j++)
-// 			{
-// 				auto* actorInner = m_entityList[j];
-// 				if (!actorInner)
-// 					continue;
-// 
-// 				if (actorInner->m_definition->m_collidesWithActors)
-// 				{
-// 					bool touched = PushDiscsOutOfEachOther2D(actor->m_transform.GetPosition2D(), actor->m_collision->m_physicsRadius, actorInner->m_transform.GetPosition2D(), actorInner->m_collision->m_physicsRadius);
-// 					if (touched)
-// 					{
-// 						actor->OnCollideWithEntity(actorInner);
-// 						actorInner->OnCollideWithEntity(actor);
-// 					}
-// 				}
-// 			}
-// 		}
-
-		// collide with world
-		if (actor->m_definition->m_collidesWithWorld)
+		float radius = actor->m_physics->m_physicsRadius;
+		GetEntitiesInRange(m_collisionNeighbors, actor->m_transform.m_position, radius);
+		for (Actor* other : m_collisionNeighbors)
 		{
-			Vec3 positionOriginal = actor->m_transform.m_position;
-			Vec3& position = actor->m_transform.m_position;
-			float sizeHalfXY = actor->m_physics->m_physicsRadius;
-			float sizeZ = actor->m_physics->m_physicsHeight;
-			float sizeHalfZ = sizeZ * 0.5f;
-			Vec3 center = position;
-			center.z += sizeHalfZ;
-
-			BlockIterator ite = BlockIterator(GetChunkManager(), IntVec3(center));
-			BlockIterator neighbor;
-
-			if (!ite.IsValid()) // actor chunk not loaded
-			{
+			if (other->GetUID().GetIndex() <= actor->GetUID().GetIndex())
+				continue;
+			if (other->IsDead() || !other->m_physics || other->m_physics->IsNoclip() || !other->m_definition->m_collidesWithActors)
 				continue;
-			}
-
-			if (ite.GetBlock()->IsSolid())
-			{
-				// player is in block, there's nothing we can do with collision
-				// continue;
-			}
-
-			float centerBlkMinX = (float)ite.GetWorldCoords().x;
-			float centerBlkMaxX = centerBlkMinX + 1.0f;
-			float centerBlkMinY = (float)ite.GetWorldCoords().y;
-			float centerBlkMaxY = centerBlkMinY + 1.0f;
-			float centerBlkMinZ = (float)ite.GetWorldCoords().z;
-			float centerBlkMaxZ = centerBlkMinZ + 1.0f;
-
-
-#define entityMinX (position.x - sizeHalfXY)
-#define entityMaxX (position.x + sizeHalfXY)
-#define entityMinY (position.y - sizeHalfXY)
-#define entityMaxY (position.y + sizeHalfXY)
-#define entityMinZ (position.z)
-#define entityMaxZ (position.z + sizeZ)
-
-			// check UP DOWN
-			if (entityMaxZ > centerBlkMaxZ)
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_UP);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.z -= entityMaxZ - centerBlkMaxZ;
-			}
-			if (entityMinZ < centerBlkMinZ)
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_DOWN);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.z -= entityMinZ - centerBlkMinZ;
-			}
-
-			// check NSWE
-			if (entityMaxX > centerBlkMaxX) // north
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.x -= entityMaxX - centerBlkMaxX;
-			}
-			if (entityMinX < centerBlkMinX) // south
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.x -= entityMinX - centerBlkMinX;
-			}
-			if (entityMaxY > centerBlkMaxY) // west
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.y -= entityMaxY - centerBlkMaxY;
-			}
-			if (entityMinY < centerBlkMinY) // east
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-					position.y -= entityMinY - centerBlkMinY;
-			}
-
-			// check UP NSWE
-			if (entityMaxZ > centerBlkMaxZ)
-			{
-				BlockIterator original = ite;
-				ite = ite.GetBlockNeighbor(BLOCK_FACE_UP);
-				if (entityMaxX > centerBlkMaxX) // north
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.x -= entityMaxX - centerBlkMaxX;
-				}
-				if (entityMinX < centerBlkMinX) // south
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.x -= entityMinX - centerBlkMinX;
-				}
-				if (entityMaxY > centerBlkMaxY) // west
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.y -= entityMaxY - centerBlkMaxY;
-				}
-				if (entityMinY < centerBlkMinY) // east
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.y -= entityMinY - centerBlkMinY;
-				}
-				ite = original;
-			}
-
-			// check DOWN NSWE
-			if (entityMinZ < centerBlkMinZ)
-			{
-				BlockIterator original = ite;
-				ite = ite.GetBlockNeighbor(BLOCK_FACE_DOWN);
-				if (entityMaxX > centerBlkMaxX) // north
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.x -= entityMaxX - centerBlkMaxX;
-				}
-				if (entityMinX < centerBlkMinX) // south
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.x -= entityMinX - centerBlkMinX;
-				}
-				if (entityMaxY > centerBlkMaxY) // west
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.y -= entityMaxY - centerBlkMaxY;
-				}
-				if (entityMinY < centerBlkMinY) // east
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-						position.y -= entityMinY - centerBlkMinY;
-				}
-				ite = original;
-			}
-
-			// check corner
-			if (entityMaxX > centerBlkMaxX && entityMaxY > centerBlkMaxY) // north west ++
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH).GetBlockNeighbor(BLOCK_FACE_WEST);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-				{
-					position.x -= entityMaxX - centerBlkMaxX;
-					position.y -= entityMaxY - centerBlkMaxY;
-				}
-			}
-			if (entityMinX < centerBlkMinX && entityMinY < centerBlkMinY) // south east --
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH).GetBlockNeighbor(BLOCK_FACE_EAST);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-				{
-					position.x -= entityMinX - centerBlkMinX;
-					position.y -= entityMinY - centerBlkMinY;
-				}
-			}
-			if (entityMaxY > centerBlkMaxY && entityMinX < centerBlkMinX) // west south +-
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST).GetBlockNeighbor(BLOCK_FACE_SOUTH);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-				{
-					position.y -= entityMaxY - centerBlkMaxY;
-					position.x -= entityMinX - centerBlkMinX;
-				}
-			}
-			if (entityMinY < centerBlkMinY && entityMaxX > centerBlkMaxX) // east north -+
-			{
-				neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST).GetBlockNeighbor(BLOCK_FACE_NORTH);
-				DebugDrawBlock(neighbor);
-				if (neighbor.GetBlock()->IsSolid())
-				{
-					position.x -= entityMaxX - centerBlkMaxX;
-					position.y -= entityMinY - centerBlkMinY;
-				}
-			}
 
-			// check UP corner
-			if (entityMaxZ > centerBlkMaxZ)
-			{
-				BlockIterator original = ite;
-				ite = ite.GetBlockNeighbor(BLOCK_FACE_UP);
-				if (entityMaxX > centerBlkMaxX && entityMaxY > centerBlkMaxY) // north west ++
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH).GetBlockNeighbor(BLOCK_FACE_WEST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMaxX - centerBlkMaxX;
-						position.y -= entityMaxY - centerBlkMaxY;
-					}
-				}
-				if (entityMinX < centerBlkMinX && entityMinY < centerBlkMinY) // south east --
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH).GetBlockNeighbor(BLOCK_FACE_EAST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMinX - centerBlkMinX;
-						position.y -= entityMinY - centerBlkMinY;
-					}
-				}
-				if (entityMaxY > centerBlkMaxY && entityMinX < centerBlkMinX) // west south +-
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST).GetBlockNeighbor(BLOCK_FACE_SOUTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.y -= entityMaxY - centerBlkMaxY;
-						position.x -= entityMinX - centerBlkMinX;
-					}
-				}
-				if (entityMinY < centerBlkMinY && entityMaxX > centerBlkMaxX) // east north -+
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST).GetBlockNeighbor(BLOCK_FACE_NORTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMaxX - centerBlkMaxX;
-						position.y -= entityMinY - centerBlkMinY;
-					}
-				}
-				ite = original;
-			}
+			// the grid only looks at XY, actors above each other pass
+			Vec3& position = actor->m_transform.m_position;
+			Vec3& otherPosition = other->m_transform.m_position;
+			if (position.z >= otherPosition.z + other->m_physics->m_physicsHeight || otherPosition.z >= position.z + actor->m_physics->m_physicsHeight)
+				continue;
 
-			// check DOWN corner
-			if (entityMinZ < centerBlkMinZ)
+			// projectiles only report the hit, they do not shove what they hit
+			if (!actor->IsProjectile() && !other->IsProjectile())
 			{
-				BlockIterator original = ite;
-				ite = ite.GetBlockNeighbor(BLOCK_FACE_DOWN);
-				if (entityMaxX > centerBlkMaxX && entityMaxY > centerBlkMaxY) // north west ++
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_NORTH).GetBlockNeighbor(BLOCK_FACE_WEST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMaxX - centerBlkMaxX;
-						position.y -= entityMaxY - centerBlkMaxY;
-					}
-				}
-				if (entityMinX < centerBlkMinX && entityMinY < centerBlkMinY) // south east --
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_SOUTH).GetBlockNeighbor(BLOCK_FACE_EAST);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMinX - centerBlkMinX;
-						position.y -= entityMinY - centerBlkMinY;
-					}
-				}
-				if (entityMaxY > centerBlkMaxY && entityMinX < centerBlkMinX) // west south +-
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_WEST).GetBlockNeighbor(BLOCK_FACE_SOUTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.y -= entityMaxY - centerBlkMaxY;
-						position.x -= entityMinX - centerBlkMinX;
-					}
-				}
-				if (entityMinY < centerBlkMinY && entityMaxX > centerBlkMaxX) // east north -+
-				{
-					neighbor = ite.GetBlockNeighbor(BLOCK_FACE_EAST).GetBlockNeighbor(BLOCK_FACE_NORTH);
-					DebugDrawBlock(neighbor);
-					if (neighbor.GetBlock()->IsSolid())
-					{
-						position.x -= entityMaxX - centerBlkMaxX;
-						position.y -= entityMinY - centerBlkMinY;
-					}
-				}
-				ite = original;
+				Vec2 position2D = Vec2(position.x, position.y);
+				Vec2 otherPosition2D = Vec2(otherPosition.x, otherPosition.y);
+				PushDiscsOutOfEachOther2D(position2D, radius, otherPosition2D, other->m_physics->m_physicsRadius);
+				position.x = position2D.x;
+				position.y = position2D.y;
+				otherPosition.x = otherPosition2D.x;
+				otherPosition.y = otherPosition2D.y;
+				m_actorGrid.UpdateActor(actor);
+				m_actorGrid.UpdateActor(other);
 			}
 
+			DoEntityCollision(actor, other);
+		}
+	}
 
-#undef entityMinX
-#undef entityMaxX
-#undef entityMinY
-#undef entityMaxY
-#undef entityMinZ
-#undef entityMaxZ
-
-
-			if (position != positionOriginal)
-			{
-				Vec3& velocity = actor->m_physics->m_velocity;
-
-				if (positionOriginal.x != position.x)
-					velocity.x = 0;
-				if (positionOriginal.y != position.y)
-					velocity.y = 0;
-				if (positionOriginal.z != position.z)
-					velocity.z = 0;
+	for (int index = 0; index < (int)m_entityList.size(); index++)
+	{
+		Actor* actor = m_entityList[index];
+		if (!actor || !actor->m_physics || actor->m_physics->IsNoclip())
+			continue;
 
-				if (actor->m_definition->m_dieOnCollide)
-				{
-					actor->Die();
-					continue;
-				}
-			}
+		// physics resolves its own moves against the blocks, only actors moved from outside since
+		// then, like crowd agents steering or actors pushed above, still have to be pushed out
+		if (actor->m_definition->m_collidesWithWorld && actor->m_transform.m_position != actor->m_physics->m_resolvedPosition)
+		{
+			actor->m_physics->MoveTo(actor->m_transform.m_position);
+			m_actorGrid.UpdateActor(actor);
 		}
 	}
 }
@@ -1128,9 +1113,9 @@ bool World::IsSolidAtPosition(const Vec3& position)
 	return false;
 }
 
-void World::AISenseMakeNoise(const Vec3& location ,float loudness)
+void World::AISenseMakeNoise(const Vec3& location ,float loudness, const Actor* instigator)
 {
-	;
+	m_perception->AddNoise(location, loudness, instigator);
 }
 
 Actor* World::GetEntityFromUID(const ActorUID& actorUID)
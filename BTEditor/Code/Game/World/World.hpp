@@ -3,6 +3,7 @@
 #include "Game/Block/Block.hpp"
 #include "Game/World/Chunk.hpp"
 #include "Game/World/BlockIterator.hpp"
+#include "Game/World/ActorGrid.hpp"
 #include "Game/Entity/ActorUID.hpp"
 #include "Game/Entity/Faction.hpp"
 #include "Game/Entity/Components.hpp"
@@ -40,6 +41,10 @@ class SpawnInfo;
 struct PlayerJoin;
 class Chunk;
 class NavMesh2D;
+class NavCrowd;
+class EnvQuerySystem;
+class AIPerception;
+class RaycastBatch;
 
 namespace tinyxml2
 {
@@ -82,6 +87,13 @@ struct WorldRaycastResult
 	EntityList      m_actors;
 };
 
+struct WorldSweepResult
+{
+	Vec3 m_position;          // where the box ends up, center of its bottom face
+	bool m_blocked[3] = {};   // axes stopped or pushed by a block
+	bool m_pushedOut = false; // started inside blocks
+};
+
 struct EnvironmentConstants
 {
 	RgbaF SKY_COLOR;
@@ -93,6 +105,8 @@ struct EnvironmentConstants
 	float FLICKER_VALUE = 0.0f;
 	float FOG_DIST_FAR = 0.0f;
 	float FOG_DIST_NEAR = 0.0f;
+	float ATLAS_ROWS = 1.0f; // block atlas grid height, merged faces wrap inside their cell with it
+	float PADDING[3] = {};
 };
 
 enum RenderPass
@@ -136,9 +150,12 @@ public:
 	Actor*                       GetNextEntity(Actor* ref) const;
 	EntityList                   GetEntities(bool noDead, int entityTypeMask = 0xFFFFFFFF) const;
 	EntityList                   GetEntities(bool noDead, const ActorDefinition* definition) const;
+	void                         GetEntitiesInRange(EntityList& entityList_out, const Vec3& center, float radius) const; // actors overlapping the circle in XY
 
 	// utilities
 	WorldRaycastResult            FastRaycastVsTiles(const Vec3& fromPosition, const Vec3& toPosition) const;
+	void                          RaycastVsTiles(RaycastBatch& batch, bool allowJobs = false) const; // main thread only when jobs are allowed
+	WorldSweepResult              SweepBoxVsTiles(const Vec3& position, float halfSizeXY, float sizeZ, const Vec3& movement, bool pushOut) const; // main thread only
 	WorldRaycastResult            DoRaycast(const Vec3& startPos, const Vec3& fwdNormal, float maxDist, Actor* actorToIgnore = nullptr) const;
 	void                          AddRaycast(const Vec3& startPos, const Vec3& fwdNormal, float maxDist, Actor* actorToIgnore = nullptr) const;
 	WorldRaycastResult            RaycastVsActors(const Vec3& startPos, const Vec3& fwdNormal, float maxDist, Actor* actorToIgnore = nullptr) const;
@@ -154,7 +171,7 @@ public:
 					              
 	ChunkProvider*                GetChunkManager() const;
 
-    void                          AISenseMakeNoise(const Vec3& location ,float loudness);
+    void                          AISenseMakeNoise(const Vec3& location ,float loudness, const Actor* instigator = nullptr);
 
 
 public:
@@ -163,16 +180,25 @@ public:
 	bool    m_debugRayVisible = true;
 	EnvironmentConstants m_envConsts;
 	NavMesh2D* m_navMesh;
+	NavCrowd*  m_crowd;
+	EnvQuerySystem* m_envQuery;
+	AIPerception*   m_perception;
 
 protected:
 	Clock m_clock;
 
 	// Map
-	ChunkProvider* m_chunkManager = nullptr;
+	ChunkProvider*             m_chunkManager = nullptr;
+	int                        m_raycastJobMinRays = 256; // smaller batches are traced inline
+	int                        m_raycastRaysPerJob = 64;
+	mutable std::vector<AABB3> m_sweepBlocks; // scratch for SweepBoxVsTiles
 
 	// Entity
-	int        m_entityUIDSalt = 12;
-	EntityList m_entityList = EntityList();
+	int                m_entityUIDSalt = 12;
+	EntityList         m_entityList = EntityList();
+	ActorGrid          m_actorGrid;
+	EntityList         m_collisionNeighbors; // scratch for DoCollisionForActors
+	mutable EntityList m_raycastCandidates;  // scratch for RaycastVsActors
 
 	// Rendering
 	Shader* m_worldShader = nullptr;
@@ -186,6 +212,7 @@ private:
 	void UpdateEnvVariables() const;
 	int  GetSaltForEntity();
 	void DoCollisionForActors();
+	void GatherSolidBlocks(const AABB3& bounds, std::vector<AABB3>& blocks) const;
 	void PushOutOfBlockHorizontal(Vec3& position, float halfSizeXY, const WorldCoords& blockPos);
 	bool IsSolidAtPosition(const Vec3& position);
 };
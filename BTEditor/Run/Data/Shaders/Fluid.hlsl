@@ -47,6 +47,8 @@ cbuffer EnvironmentConstants : register(b5)
 	float  G_Flicker;
 	float  G_FogFar;
 	float  G_FogNear;
+	float  G_AtlasRows;
+	float3 G_Padding;
 }
 
 v2p_t VertexMain(vs_input_t input)
@@ -77,10 +79,26 @@ float3 SoftBlend(float3 a, float3 b)
 	return 1.0f - (1.0f - a) * (1.0f - b);
 }
 
+// merged chunk faces carry the atlas cell in the integer part of the uv and the tile position / 32 in the fraction,
+// their vertex alpha holds the atlas column count and the row count comes from the environment, everything else has alpha 1
+float4 SampleBlockAtlas(float2 uv, float alpha)
+{
+	float2 cell   = floor(uv);
+	float2 tile   = (uv - cell) * 32.0f;
+	float2 tileDx = ddx(tile);
+	float2 tileDy = ddy(tile);
+
+	if (alpha > 0.999f)
+		return diffuseTexture.Sample(diffuseSampler, uv);
+
+	float2 grid = float2(round(alpha * 255.0f), G_AtlasRows);
+	return diffuseTexture.SampleGrad(diffuseSampler, (cell + frac(tile)) / grid, tileDx / grid, tileDy / grid);
+}
+
 ps_output_t PixelMain(v2p_t input)
 {
 	// diffuse
-	float4 diffuse = diffuseTexture.Sample(diffuseSampler, input.uv);
+	float4 diffuse = SampleBlockAtlas(input.uv, input.color.a);
 
 	// Compute lit pixel color
 	float  iLightLevel = input.color.r; // indoor (block light)